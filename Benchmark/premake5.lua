@@ -0,0 +1,94 @@
+project "Benchmark"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    staticruntime "On"
+
+    targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+    objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+    defines { "_CRT_SECURE_NO_WARNINGS" }
+
+    -- the app sources under test, the histogram benchmark opens a hidden window for the gl ones
+    files
+    {
+        "src/**.h",
+        "src/**.cpp",
+        "../Color-Picker/src/ImageDecoder.h",
+        "../Color-Picker/src/ImageDecoder.cpp",
+        "../Color-Picker/src/JpegDecoder.cpp",
+        "../Color-Picker/src/PngDecoder.cpp",
+        "../Color-Picker/src/MappedFile.h",
+        "../Color-Picker/src/MappedFile.cpp",
+        "../Color-Picker/src/PixelKernels.h",
+        "../Color-Picker/src/PixelKernels.cpp",
+        "../Color-Picker/src/PixelStore.h",
+        "../Color-Picker/src/PixelStore.cpp",
+        "../Color-Picker/src/Histogram.h",
+        "../Color-Picker/src/Histogram.cpp",
+        "../Color-Picker/src/ColorDifference.h",
+        "../Color-Picker/src/ColorDifference.cpp",
+        "../Color-Picker/src/ColorDifferenceSimd.h",
+        "../Color-Picker/src/ColorDifferenceAvx2.cpp",
+        "../Color-Picker/src/Shader.cpp",
+        "../Color-Picker/src/ThreadPool.h",
+        "../Color-Picker/src/ThreadPool.cpp",
+        "../Dependency/stb_image/**.h",
+        "../Dependency/stb_image/**.cpp"
+    }
+
+    includedirs
+    {
+        "src",
+        "../Color-Picker/src",
+        "../Dependency/stb_image",
+        "../Dependency/GLFW/include",
+        "../Dependency/Glad/include",
+        "../Dependency/glm"
+    }
+
+    links
+    {
+        "GLFW",
+        "Glad"
+    }
+
+    filter "system:windows"
+        systemversion "latest"
+        links { "opengl32.lib" }
+        defines { "GLFW_INCLUDE_NONE", "PLATFORM_WINDOWS" }
+
+    filter "system:linux"
+        links { "GL", "pthread", "dl" }
+        defines { "GLFW_INCLUDE_NONE", "PLATFORM_LINUX" }
+
+    filter "options:with-jpeg-turbo"
+        links { "jpeg" }
+        defines { "USE_JPEG_TURBO" }
+
+    filter "options:with-libpng"
+        links { "png" }
+        defines { "USE_LIBPNG" }
+
+    -- same as in the app, only the avx2 kernel is built for avx2
+    filter { "files:../Color-Picker/src/ColorDifferenceAvx2.cpp", "toolset:msc*" }
+        buildoptions { "/arch:AVX2" }
+
+    filter { "files:../Color-Picker/src/ColorDifferenceAvx2.cpp", "toolset:not msc*" }
+        buildoptions { "-mavx2", "-mfma" }
+
+    -- numbers only mean something in an optimized build
+    filter "configurations:Debug"
+        runtime "Debug"
+        symbols "On"
+        optimize "On"
+
+    filter "configurations:Release"
+        runtime "Release"
+        symbols "On"
+        optimize "Speed"
+
+    filter "configurations:Dist"
+        runtime "Release"
+        symbols "Off"
+        optimize "Full"
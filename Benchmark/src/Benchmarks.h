@@ -0,0 +1,16 @@
+
+
+#pragma once
+
+// each benchmark reads its own arguments (everything after its name) and returns the exit code
+
+// decode throughput of every compiled in decoder, on image files or directories and on generated camera sized jpegs
+int RunDecoderBenchmark(int argc, char** argv);
+
+// cpu (thread pool) against compute shader histograms of generated images, and the incremental update of a panned view
+// [width height], the gpu backend needs a gl 4.5 context and runs from the repository root or the benchmark project
+int RunHistogramBenchmark(int argc, char** argv);
+
+// ciede2000 of the scalar reference and every simd path the cpu has, checked against sharma's published pairs,
+// one color against [count] generated ones and a palette against a library over the thread pool
+int RunColorDifferenceBenchmark(int argc, char** argv);
@@ -0,0 +1,194 @@
+
+
+#include "Benchmarks.h"
+
+#include "ColorDifference.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+// every path runs at least this many times and until this much time has passed, the best run counts
+static constexpr int	MinRuns	   = 3;
+static constexpr int	MaxRuns	   = 50;
+static constexpr double MinSeconds = 0.5;
+
+// published values are rounded to 4 decimals, the float kernels may add a little on top
+static constexpr double SharmaTolerance = 1e-4;
+
+// colors of the many against many run, a palette against a named color library
+static constexpr size_t PaletteColors = 256;
+static constexpr size_t LibraryColors = 4096;
+
+// the 34 pairs of sharma, wu and dalal, "the ciede2000 color-difference formula: implementation notes,
+// supplementary test data, and mathematical observations" (2005), lab 1, lab 2 and delta e 2000
+static const float sharmaPairs[][7] = {
+	{ 50.0000f,   2.6772f, -79.7751f, 50.0000f,   0.0000f, -82.7485f,  2.0425f },
+	{ 50.0000f,   3.1571f, -77.2803f, 50.0000f,   0.0000f, -82.7485f,  2.8615f },
+	{ 50.0000f,   2.8361f, -74.0200f, 50.0000f,   0.0000f, -82.7485f,  3.4412f },
+	{ 50.0000f,  -1.3802f, -84.2814f, 50.0000f,   0.0000f, -82.7485f,  1.0000f },
+	{ 50.0000f,  -1.1848f, -84.8006f, 50.0000f,   0.0000f, -82.7485f,  1.0000f },
+	{ 50.0000f,  -0.9009f, -85.5211f, 50.0000f,   0.0000f, -82.7485f,  1.0000f },
+	{ 50.0000f,   0.0000f,   0.0000f, 50.0000f,  -1.0000f,   2.0000f,  2.3669f },
+	{ 50.0000f,  -1.0000f,   2.0000f, 50.0000f,   0.0000f,   0.0000f,  2.3669f },
+	{ 50.0000f,   2.4900f,  -0.0010f, 50.0000f,  -2.4900f,   0.0009f,  7.1792f },
+	{ 50.0000f,   2.4900f,  -0.0010f, 50.0000f,  -2.4900f,   0.0010f,  7.1792f },
+	{ 50.0000f,   2.4900f,  -0.0010f, 50.0000f,  -2.4900f,   0.0011f,  7.2195f },
+	{ 50.0000f,   2.4900f,  -0.0010f, 50.0000f,  -2.4900f,   0.0012f,  7.2195f },
+	{ 50.0000f,  -0.0010f,   2.4900f, 50.0000f,   0.0009f,  -2.4900f,  4.8045f },
+	{ 50.0000f,  -0.0010f,   2.4900f, 50.0000f,   0.0010f,  -2.4900f,  4.8045f },
+	{ 50.0000f,  -0.0010f,   2.4900f, 50.0000f,   0.0011f,  -2.4900f,  4.7461f },
+	{ 50.0000f,   2.5000f,   0.0000f, 50.0000f,   0.0000f,  -2.5000f,  4.3065f },
+	{ 50.0000f,   2.5000f,   0.0000f, 73.0000f,  25.0000f, -18.0000f, 27.1492f },
+	{ 50.0000f,   2.5000f,   0.0000f, 61.0000f,  -5.0000f,  29.0000f, 22.8977f },
+	{ 50.0000f,   2.5000f,   0.0000f, 56.0000f, -27.0000f,  -3.0000f, 31.9030f },
+	{ 50.0000f,   2.5000f,   0.0000f, 58.0000f,  24.0000f,  15.0000f, 19.4535f },
+	{ 50.0000f,   2.5000f,   0.0000f, 50.0000f,   3.1736f,   0.5854f,  1.0000f },
+	{ 50.0000f,   2.5000f,   0.0000f, 50.0000f,   3.2972f,   0.0000f,  1.0000f },
+	{ 50.0000f,   2.5000f,   0.0000f, 50.0000f,   1.8634f,   0.5757f,  1.0000f },
+	{ 50.0000f,   2.5000f,   0.0000f, 50.0000f,   3.2592f,   0.3350f,  1.0000f },
+	{ 60.2574f, -34.0099f,  36.2677f, 60.4626f, -34.1751f,  39.4387f,  1.2644f },
+	{ 63.0109f, -31.0961f,  -5.8663f, 62.8187f, -29.7946f,  -4.0864f,  1.2630f },
+	{ 61.2901f,   3.7196f,  -5.3901f, 61.4292f,   2.2480f,  -4.9620f,  1.8731f },
+	{ 35.0831f, -44.1164f,   3.7933f, 35.0232f, -40.0716f,   1.5901f,  1.8645f },
+	{ 22.7233f,  20.0904f, -46.6940f, 23.0331f,  14.9730f, -42.5619f,  2.0373f },
+	{ 36.4612f,  47.8580f,  18.3852f, 36.2715f,  50.5065f,  21.2231f,  1.4146f },
+	{ 90.8027f,  -2.0831f,   1.4410f, 91.1528f,  -1.6435f,   0.0447f,  1.4441f },
+	{ 90.9257f,  -0.5406f,  -0.9208f, 88.6381f,  -0.8985f,  -0.7239f,  1.5381f },
+	{  6.7747f,  -0.2908f,  -2.4247f,  5.8714f,  -0.0985f,  -2.2286f,  0.6377f },
+	{  2.0776f,   0.0795f,  -1.1350f,  0.9033f,  -0.0636f,  -0.5514f,  0.9082f }
+};
+
+static constexpr size_t SharmaCount = sizeof(sharmaPairs) / sizeof(sharmaPairs[0]);
+
+// planar lab colors
+struct LabColors {
+	std::vector<float> L, A, B;
+
+	size_t Size() const { return L.size(); }
+};
+
+// best time of repeated runs in seconds
+static double TimeRuns(const std::function<void()>& run) {
+	using Clock = std::chrono::steady_clock;
+
+	double best = -1.0, total = 0.0;
+	for (int i = 0; i < MaxRuns && (i < MinRuns || total < MinSeconds); ++i) {
+		Clock::time_point start = Clock::now();
+		run();
+
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		best   = best < 0.0 ? seconds : std::min(best, seconds);
+		total += seconds;
+	}
+
+	return best;
+}
+
+// spread over the srgb part of lab, every 97th one grey so the achromatic branches are hit too
+static LabColors MakeColors(size_t count, uint32_t seed) {
+	LabColors colors;
+	colors.L.resize(count);
+	colors.A.resize(count);
+	colors.B.resize(count);
+
+	uint32_t noise = seed;
+	auto Next = [&noise](float min, float max) {
+		noise = noise * 1664525u + 1013904223u;
+		return min + (max - min) * (float)(noise >> 8) / (float)(1 << 24);
+	};
+
+	for (size_t i = 0; i < count; ++i) {
+		colors.L[i] = Next(0.0f, 100.0f);
+		colors.A[i] = i % 97 == 0 ? 0.0f : Next(-90.0f, 100.0f);
+		colors.B[i] = i % 97 == 0 ? 0.0f : Next(-110.0f, 95.0f);
+	}
+
+	return colors;
+}
+
+// both orders of every pair through the batch kernel, each as a whole register of copies so the simd paths run it
+static double CheckSharma() {
+	constexpr size_t Lanes = 8;
+	float l[Lanes], a[Lanes], b[Lanes], deltaE[Lanes];
+	double worst = 0.0;
+
+	for (const float (&pair)[7] : sharmaPairs) {
+		for (int order = 0; order < 2; ++order) {
+			const float* first	= order == 0 ? pair : pair + 3;
+			const float* second = order == 0 ? pair + 3 : pair;
+
+			std::fill(l, l + Lanes, second[0]);
+			std::fill(a, a + Lanes, second[1]);
+			std::fill(b, b + Lanes, second[2]);
+
+			ColorDifference::Ciede2000({ first[0], first[1], first[2] }, l, a, b, deltaE, Lanes);
+			for (float value : deltaE)
+				worst = std::max(worst, std::abs((double)value - pair[6]));
+		}
+	}
+
+	return worst;
+}
+
+// returns whether the path reproduces the sharma pairs
+static bool RunPath(ColorDifference::Path path, const LabColors& colors, const glm::vec3& reference, const std::vector<float>& referenceDeltaE) {
+	ColorDifference::SetPath(path);
+	double sharmaError = CheckSharma();
+	std::vector<float> deltaE(colors.Size());
+
+	double seconds = TimeRuns([&]() { ColorDifference::Ciede2000(reference, colors.L.data(), colors.A.data(), colors.B.data(), deltaE.data(), colors.Size()); });
+
+	double worst = 0.0;
+	for (size_t i = 0; i < deltaE.size(); ++i)
+		worst = std::max(worst, std::abs((double)deltaE[i] - referenceDeltaE[i]));
+
+	printf("  %-8s sharma %.6f %-4s  1 x %-8zu %8.2f ms %8.2f ns/pair %8.1f M pairs/s  (%.6f off the reference)\n",
+		ColorDifference::GetPathName(path), sharmaError, sharmaError <= SharmaTolerance ? "ok" : "FAIL",
+		colors.Size(), seconds * 1e3, seconds * 1e9 / colors.Size(), colors.Size() / seconds / 1e6, worst);
+
+	return sharmaError <= SharmaTolerance;
+}
+
+int RunColorDifferenceBenchmark(int argc, char** argv) {
+	ThreadPool::Init();
+
+	size_t count = argc >= 1 ? (size_t)std::max(1, std::atoi(argv[0])) : (size_t)1 << 20;
+	ColorDifference::Path best = ColorDifference::GetBestPath();
+
+	printf("ciede2000 of one color against %zu, best path %s, %zu sharma pairs both ways (tolerance %g)\n", count, ColorDifference::GetPathName(best), SharmaCount, SharmaTolerance);
+
+	LabColors colors = MakeColors(count, 12345);
+	glm::vec3 reference = { 52.0f, 18.0f, -34.0f };
+
+	// the scalar path is the double precision reference the others are measured against
+	std::vector<float> referenceDeltaE(count);
+	ColorDifference::SetPath(ColorDifference::Path::Scalar);
+	ColorDifference::Ciede2000(reference, colors.L.data(), colors.A.data(), colors.B.data(), referenceDeltaE.data(), count);
+
+	int result = 0;
+	for (uint32_t i = 0; i <= (uint32_t)best; ++i) {
+		if (!RunPath((ColorDifference::Path)i, colors, reference, referenceDeltaE))
+			result = 1;
+	}
+
+	// a palette against a library, rows over the thread pool
+	ColorDifference::SetPath(best);
+	LabColors palette = MakeColors(PaletteColors, 777), library = MakeColors(LibraryColors, 999);
+	std::vector<float> matrix(PaletteColors * LibraryColors);
+
+	double seconds = TimeRuns([&]() {
+		ColorDifference::Ciede2000(palette.L.data(), palette.A.data(), palette.B.data(), PaletteColors, library.L.data(), library.A.data(), library.B.data(), LibraryColors, matrix.data());
+	});
+
+	printf("  %-8s %zu x %zu on %u pool threads and the caller %8.2f ms %8.1f M pairs/s\n", ColorDifference::GetPathName(best), PaletteColors, LibraryColors,
+		ThreadPool::GetThreadCount(), seconds * 1e3, PaletteColors * LibraryColors / seconds / 1e6);
+
+	ThreadPool::Shutdown();
+	return result;
+}
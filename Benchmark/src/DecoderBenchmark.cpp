@@ -0,0 +1,250 @@
+
+
+#include "Benchmarks.h"
+
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifdef USE_JPEG_TURBO
+	#include <jpeglib.h>
+#endif
+
+// an encoded image held in memory, decoders always read from memory in the app too
+struct BenchmarkInput {
+	std::string			 Name;
+	std::vector<uint8_t> Data;
+};
+
+// every decoder runs at least this many times and until this much time has passed, the best run counts
+static constexpr int	MinRuns	   = 3;
+static constexpr int	MaxRuns	   = 50;
+static constexpr double MinSeconds = 1.0;
+
+static bool ReadInput(const std::filesystem::path& path, std::vector<BenchmarkInput>& outInputs) {
+	ImageLoader::MappedFile file(path.string());
+	if (!file.IsValid())
+		return false;
+
+	BenchmarkInput input;
+	input.Name = path.filename().string();
+	input.Data.assign(file.GetData(), file.GetData() + file.GetSize());
+	outInputs.push_back(std::move(input));
+	return true;
+}
+
+static void ReadInputs(const std::filesystem::path& path, std::vector<BenchmarkInput>& outInputs) {
+	std::error_code error;
+
+	if (!std::filesystem::is_directory(path, error)) {
+		if (!ReadInput(path, outInputs))
+			printf("could not read %s\n", path.string().c_str());
+
+		return;
+	}
+
+	std::vector<std::filesystem::path> files;
+	for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+		if (entry.is_regular_file())
+			files.push_back(entry.path());
+	}
+
+	std::sort(files.begin(), files.end());
+	for (const std::filesystem::path& file : files)
+		ReadInput(file, outInputs);
+}
+
+#ifdef USE_JPEG_TURBO
+
+// smooth gradients with fine detail and noise on top, roughly what a camera jpeg costs to decode
+static BenchmarkInput EncodeSyntheticJpeg(uint32_t width, uint32_t height, int quality, bool subsampled) {
+	std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+	uint32_t noise = 12345;
+
+	for (uint32_t y = 0; y < height; ++y) {
+		uint8_t* pixel = rgb.data() + static_cast<size_t>(y) * width * 3;
+
+		for (uint32_t x = 0; x < width; ++x, pixel += 3) {
+			noise = noise * 1664525u + 1013904223u;
+			int grain = (int)(noise >> 28) - 8;
+
+			pixel[0] = (uint8_t)std::clamp((int)(x * 255 / width) + grain, 0, 255);
+			pixel[1] = (uint8_t)std::clamp((int)(y * 255 / height) + grain, 0, 255);
+			pixel[2] = (uint8_t)std::clamp((int)(128 + 96 * std::sin((x + 2 * y) * 0.02)) + grain, 0, 255);
+		}
+	}
+
+	jpeg_compress_struct info;
+	jpeg_error_mgr error;
+	info.err = jpeg_std_error(&error);
+	jpeg_create_compress(&info);
+
+	unsigned char* buffer = nullptr;
+	unsigned long  size	  = 0;
+	jpeg_mem_dest(&info, &buffer, &size);
+
+	info.image_width	  = width;
+	info.image_height	  = height;
+	info.input_components = 3;
+	info.in_color_space	  = JCS_RGB;
+	jpeg_set_defaults(&info);
+	jpeg_set_quality(&info, quality, TRUE);
+
+	// the defaults subsample chroma 2x2 (4:2:0), full resolution luma sampling gives 4:4:4
+	if (!subsampled)
+		info.comp_info[0].h_samp_factor = info.comp_info[0].v_samp_factor = 1;
+
+	jpeg_start_compress(&info, TRUE);
+	while (info.next_scanline < info.image_height) {
+		JSAMPROW row = rgb.data() + static_cast<size_t>(info.next_scanline) * width * 3;
+		jpeg_write_scanlines(&info, &row, 1);
+	}
+
+	jpeg_finish_compress(&info);
+
+	BenchmarkInput input;
+	input.Name = "synthetic " + std::to_string(width) + "x" + std::to_string(height) + (subsampled ? " 4:2:0" : " 4:4:4") + " q" + std::to_string(quality);
+	input.Data.assign(buffer, buffer + size);
+
+	free(buffer);
+	jpeg_destroy_compress(&info);
+	return input;
+}
+
+#endif
+
+// best time of repeated decodes in seconds, negative if the decoder failed
+static double TimeDecode(const ImageLoader::Decoder& decoder, const BenchmarkInput& input, const ImageLoader::ImageInfo& info, uint32_t scaleDenom, std::vector<uint8_t>& pixels) {
+	using Clock = std::chrono::steady_clock;
+
+	double best = -1.0, total = 0.0;
+	for (int run = 0; run < MaxRuns && (run < MinRuns || total < MinSeconds); ++run) {
+		Clock::time_point start = Clock::now();
+
+		if (!decoder.Decode(input.Data.data(), input.Data.size(), info, scaleDenom, pixels.data(), nullptr))
+			return -1.0;
+
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		best   = best < 0.0 ? seconds : std::min(best, seconds);
+		total += seconds;
+	}
+
+	return best;
+}
+
+static void RunInput(const BenchmarkInput& input) {
+	const auto decoders = ImageLoader::GetDecoders();
+
+	// the catch all decoder (stb_image) is the reference the others are compared against
+	std::vector<uint8_t> reference;
+
+	for (auto it = decoders.rbegin(); it != decoders.rend(); ++it) {
+		const ImageLoader::Decoder& decoder = **it;
+
+		ImageLoader::ImageInfo info;
+		if (!decoder.Sniff(input.Data.data(), input.Data.size()) || !decoder.ReadInfo(input.Data.data(), input.Data.size(), info))
+			continue;
+
+		uint32_t width = info.Width, height = info.Height;
+		std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * Renderer::GetBytesPerPixel(info.Format));
+		double seconds = TimeDecode(decoder, input, info, 1, pixels);
+
+		if (seconds < 0.0) {
+			printf("  %-36s %-18s failed\n", input.Name.c_str(), decoder.Name);
+			continue;
+		}
+
+		double megabytes  = input.Data.size() / 1e6;
+		double megapixels = static_cast<double>(width) * height / 1e6;
+
+		printf("  %-36s %-18s %5ux%-5u %8.2f MB %8.1f MB/s %8.1f MP/s", input.Name.c_str(), decoder.Name, width, height, megabytes, megabytes / seconds, megapixels / seconds);
+
+		// byte compares only mean something between decoders writing the same format
+		if (reference.empty() || reference.size() != pixels.size()) {
+			reference = std::move(pixels);
+			printf("  (reference)\n");
+			continue;
+		}
+
+		// idct and upsampling differ slightly between decoders, large errors would mean a broken backend
+		uint64_t sum = 0;
+		int maxError = 0;
+		for (size_t i = 0; i < pixels.size(); ++i) {
+			int error = std::abs((int)pixels[i] - (int)reference[i]);
+			sum		+= error;
+			maxError = std::max(maxError, error);
+		}
+
+		printf("  error vs reference: mean %.3f max %d\n", (double)sum / pixels.size(), maxError);
+	}
+
+	// reduced decodes the app shows first when the file is larger than the target, rates count output pixels
+	for (const ImageLoader::Decoder* decoder : decoders) {
+		ImageLoader::ImageInfo info;
+		if (decoder->MaxScaleDenom == 1 || !decoder->Sniff(input.Data.data(), input.Data.size()) || !decoder->ReadInfo(input.Data.data(), input.Data.size(), info))
+			continue;
+
+		for (uint32_t scaleDenom = 2; scaleDenom <= decoder->MaxScaleDenom; scaleDenom *= 2) {
+			uint32_t scaledWidth  = ImageLoader::GetScaledSize(info.Width,	scaleDenom);
+			uint32_t scaledHeight = ImageLoader::GetScaledSize(info.Height, scaleDenom);
+
+			std::vector<uint8_t> pixels(static_cast<size_t>(scaledWidth) * scaledHeight * Renderer::GetBytesPerPixel(info.Format));
+			double seconds = TimeDecode(*decoder, input, info, scaleDenom, pixels);
+			if (seconds < 0.0)
+				continue;
+
+			std::string name = std::string(decoder->Name) + " 1/" + std::to_string(scaleDenom);
+			printf("  %-36s %-18s %5ux%-5u %8.2f MB %8.1f MB/s %8.2f ms\n", input.Name.c_str(), name.c_str(), scaledWidth, scaledHeight,
+				input.Data.size() / 1e6, input.Data.size() / 1e6 / seconds, seconds * 1e3);
+		}
+	}
+}
+
+int RunDecoderBenchmark(int argc, char** argv) {
+	std::vector<BenchmarkInput> inputs;
+
+	if (argc > 0) {
+		for (int i = 0; i < argc; ++i)
+			ReadInputs(argv[i], inputs);
+	}
+	else {
+		// the bundled images, seen from the repository root or from the benchmark project
+		for (const char* directory : { "Color-Picker/assets/Images", "../Color-Picker/assets/Images" }) {
+			std::error_code error;
+			if (std::filesystem::is_directory(directory, error)) {
+				ReadInputs(directory, inputs);
+				break;
+			}
+		}
+	}
+
+#ifdef USE_JPEG_TURBO
+	inputs.push_back(EncodeSyntheticJpeg(6000, 4000, 90, true));
+	inputs.push_back(EncodeSyntheticJpeg(6000, 4000, 95, false));
+#else
+	printf("built without libjpeg-turbo (--with-jpeg-turbo), no synthetic jpegs to encode\n");
+#endif
+
+	if (inputs.empty()) {
+		printf("no inputs\n");
+		return 1;
+	}
+
+	printf("decoders:");
+	for (const ImageLoader::Decoder* decoder : ImageLoader::GetDecoders())
+		printf(" %s", decoder->Name);
+	printf("\n");
+
+	for (const BenchmarkInput& input : inputs)
+		RunInput(input);
+
+	return 0;
+}
@@ -0,0 +1,175 @@
+
+
+#include "glad/glad.h"
+#include "GLFW/glfw3.h"
+
+#include "Benchmarks.h"
+
+#include "Histogram.h"
+#include "PixelStore.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+
+// every backend runs at least this many times and until this much time has passed, the best run counts
+static constexpr int	MinRuns	   = 3;
+static constexpr int	MaxRuns	   = 50;
+static constexpr double MinSeconds = 0.5;
+
+// view size of the panned visible region benchmark
+static constexpr uint32_t ViewWidth	 = 1920;
+static constexpr uint32_t ViewHeight = 1080;
+
+// best time of repeated runs in seconds
+static double TimeRuns(const std::function<void()>& run) {
+	using Clock = std::chrono::steady_clock;
+
+	double best = -1.0, total = 0.0;
+	for (int i = 0; i < MaxRuns && (i < MinRuns || total < MinSeconds); ++i) {
+		Clock::time_point start = Clock::now();
+		run();
+
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		best   = best < 0.0 ? seconds : std::min(best, seconds);
+		total += seconds;
+	}
+
+	return best;
+}
+
+// smooth gradients with noise on top, so every bin of every channel gets hit
+static Renderer::PixelStore MakeImage(uint32_t width, uint32_t height) {
+	Renderer::PixelStore pixels(width, height);
+	uint32_t noise = 12345;
+
+	for (uint32_t y = 0; y < height; ++y) {
+		uint8_t* pixel = pixels.GetData() + static_cast<size_t>(y) * pixels.GetRowStride();
+
+		for (uint32_t x = 0; x < width; ++x, pixel += 4) {
+			noise = noise * 1664525u + 1013904223u;
+			int grain = (int)(noise >> 28) - 8;
+
+			pixel[0] = (uint8_t)std::clamp((int)(x * 255 / width) + grain, 0, 255);
+			pixel[1] = (uint8_t)std::clamp((int)(y * 255 / height) + grain, 0, 255);
+			pixel[2] = (uint8_t)std::clamp((int)(128 + 96 * std::sin((x + 2 * y) * 0.02)) + grain, 0, 255);
+			pixel[3] = 255;
+		}
+	}
+
+	return pixels;
+}
+
+// hidden window for a gl 4.5 context, the shader is read relative to the app's directory like in the app
+static GLFWwindow* InitGpu() {
+	for (const char* directory : { "Color-Picker", "../Color-Picker" }) {
+		std::error_code error;
+		if (std::filesystem::exists(std::filesystem::path(directory) / "assets/Shaders/Histogram.glsl", error)) {
+			std::filesystem::current_path(directory, error);
+			break;
+		}
+	}
+
+	if (glfwInit() == GLFW_FALSE)
+		return nullptr;
+
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	GLFWwindow* window = glfwCreateWindow(64, 64, "Histogram Benchmark", nullptr, nullptr);
+	if (window == nullptr) {
+		glfwTerminate();
+		return nullptr;
+	}
+
+	glfwMakeContextCurrent(window);
+	if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) == 0) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return nullptr;
+	}
+
+	Histogram::InitGpu();
+	return window;
+}
+
+static void RunSize(uint32_t width, uint32_t height, bool gpu) {
+	Renderer::PixelStore pixels = MakeImage(width, height);
+	PixelKernels::PixelRect whole = { 0, 0, width, height };
+	double megapixels = static_cast<double>(width) * height / 1e6;
+
+	Histogram::Counts cpuCounts;
+	double seconds = TimeRuns([&]() { cpuCounts = Histogram::ComputeCpu(pixels, whole); });
+	printf("  %5ux%-5u %-28s %8.2f ms %8.1f MP/s\n", width, height, "cpu", seconds * 1e3, megapixels / seconds);
+
+	// a view panned 16 pixels per frame, the incremental update only counts the columns that scrolled in and out
+	if (width > ViewWidth + 32 && height > ViewHeight) {
+		PixelKernels::PixelRect view = { 0, 0, ViewWidth, ViewHeight };
+		Histogram::Counts viewCounts = Histogram::ComputeCpu(pixels, view);
+		bool forward = true;
+
+		double panSeconds = TimeRuns([&]() {
+			PixelKernels::PixelRect next = view;
+			next.X = forward ? view.X + 16 : view.X - 16;
+			forward = !forward;
+
+			Histogram::MoveCpu(pixels, view, next, viewCounts);
+			view = next;
+		});
+
+		double viewSeconds = TimeRuns([&]() { viewCounts = Histogram::ComputeCpu(pixels, view); });
+		printf("  %5ux%-5u %-28s %8.3f ms (%.3f ms counting the view from scratch)\n", width, height, "cpu 1080p view panned 16px", panSeconds * 1e3, viewSeconds * 1e3);
+	}
+
+	if (!gpu)
+		return;
+
+	uint32_t texture = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, GL_RGBA8, width, height);
+	glTextureSubImage2D(texture, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.GetData());
+
+	// the first dispatch pays for the driver's lazy setup
+	Histogram::Counts gpuCounts;
+	Histogram::ComputeGpu(texture, width, height, whole, gpuCounts);
+
+	seconds = TimeRuns([&]() { Histogram::ComputeGpu(texture, width, height, whole, gpuCounts); });
+	printf("  %5ux%-5u %-28s %8.2f ms %8.1f MP/s  (counts %s the cpu ones)\n", width, height, "gpu compute incl. read back", seconds * 1e3, megapixels / seconds,
+		gpuCounts.Values == cpuCounts.Values ? "match" : "DIFFER from");
+
+	glDeleteTextures(1, &texture);
+}
+
+int RunHistogramBenchmark(int argc, char** argv) {
+	ThreadPool::Init();
+
+	GLFWwindow* window = InitGpu();
+	bool gpu = window != nullptr && Histogram::IsGpuAvailable();
+	printf("cpu backend on %u pool threads and the caller, gpu backend %s\n", ThreadPool::GetThreadCount(), gpu ? "on" : "off (no gl 4.5 context or the shader did not build)");
+
+	if (argc >= 2) {
+		RunSize((uint32_t)std::atoi(argv[0]), (uint32_t)std::atoi(argv[1]), gpu);
+	}
+	else {
+		RunSize(3000, 2000, gpu);
+		RunSize(6000, 4000, gpu);
+		RunSize(12000, 8000, gpu);
+	}
+
+	if (window != nullptr) {
+		Histogram::ShutdownGpu();
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+
+	ThreadPool::Shutdown();
+	return 0;
+}
@@ -0,0 +1,47 @@
+
+
+#include "Benchmarks.h"
+
+#include <cstring>
+#include <iostream>
+
+struct Benchmark {
+	const char* Name;
+	const char* Arguments;
+	int (*Run)(int argc, char** argv);
+};
+
+static const Benchmark benchmarks[] = {
+	{ "decoders",		 "[image files or directories...]", RunDecoderBenchmark },
+	{ "histogram",		 "[width height]",				    RunHistogramBenchmark },
+	{ "colordifference", "[count]",						    RunColorDifferenceBenchmark }
+};
+
+static void PrintUsage(const char* program) {
+	std::cout << "usage: " << program << " [benchmark] [arguments]\n";
+	std::cout << "with no benchmark named every benchmark runs with its defaults\n\n";
+
+	for (const Benchmark& benchmark : benchmarks)
+		std::cout << "  " << benchmark.Name << " " << benchmark.Arguments << "\n";
+}
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		int result = 0;
+		for (const Benchmark& benchmark : benchmarks) {
+			std::cout << "== " << benchmark.Name << " ==\n";
+			result |= benchmark.Run(0, nullptr);
+			std::cout << "\n";
+		}
+
+		return result;
+	}
+
+	for (const Benchmark& benchmark : benchmarks) {
+		if (strcmp(argv[1], benchmark.Name) == 0)
+			return benchmark.Run(argc - 2, argv + 2);
+	}
+
+	PrintUsage(argv[0]);
+	return 1;
+}
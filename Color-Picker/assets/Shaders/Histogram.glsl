@@ -0,0 +1,53 @@
+#type compute
+#version 450 core
+
+// every work group counts a 64x64 tile of the rect into shared bins, then adds the bins it used to the global ones
+layout(local_size_x = 16, local_size_y = 16) in;
+
+const uint Bins		  = 256;
+const uint Channels	  = 4;		// red, green, blue, luma
+const uint TileSteps  = 4;		// pixels per invocation along each side
+
+layout(binding = 0) uniform sampler2D u_Image;
+
+layout(std430, binding = 0) buffer Histogram {
+	uint bins[Bins * Channels];
+};
+
+// x and y of the first texel (top row first like the texture), width and height
+layout(location = 0) uniform ivec4 u_Rect;
+
+shared uint localBins[Bins * Channels];
+
+void main() {
+	for (uint i = gl_LocalInvocationIndex; i < Bins * Channels; i += gl_WorkGroupSize.x * gl_WorkGroupSize.y)
+		localBins[i] = 0u;
+
+	barrier();
+
+	ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy * gl_WorkGroupSize.xy * TileSteps);
+
+	for (uint y = 0u; y < TileSteps; ++y) {
+		for (uint x = 0u; x < TileSteps; ++x) {
+			ivec2 texel = tileOrigin + ivec2(gl_LocalInvocationID.xy + uvec2(x, y) * gl_WorkGroupSize.xy);
+			if (any(greaterThanEqual(texel, u_Rect.zw)))
+				continue;
+
+			// rounded to 8 bits like the cpu backend, luma from the rounded values with the rec 709 weights
+			uvec3 level = uvec3(clamp(texelFetch(u_Image, u_Rect.xy + texel, 0).rgb, 0.0, 1.0) * 255.0 + 0.5);
+			uint  luma	= (level.r * 54u + level.g * 183u + level.b * 19u) >> 8;
+
+			atomicAdd(localBins[level.r], 1u);
+			atomicAdd(localBins[Bins + level.g], 1u);
+			atomicAdd(localBins[2u * Bins + level.b], 1u);
+			atomicAdd(localBins[3u * Bins + luma], 1u);
+		}
+	}
+
+	barrier();
+
+	for (uint i = gl_LocalInvocationIndex; i < Bins * Channels; i += gl_WorkGroupSize.x * gl_WorkGroupSize.y) {
+		if (localBins[i] != 0u)
+			atomicAdd(bins[i], localBins[i]);
+	}
+}
@@ -0,0 +1,75 @@
+#type vertex
+#version 450 core
+
+// one draw per image quad, the quad is a triangle strip made from the vertex id
+layout(location = 0) uniform vec2 u_DisplayPos;
+layout(location = 1) uniform vec2 u_DisplaySize;
+layout(location = 2) uniform vec4 u_Rect;			// min and max corner in imgui display coordinates
+layout(location = 3) uniform vec4 u_TexRect;		// uvs at those corners
+layout(location = 4) uniform vec4 u_ImageRect;		// the whole image in imgui display coordinates
+
+out vec2 v_TexCoord;
+out vec2 v_MaskCoord;
+
+void main() {
+	vec2 corner	  = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	vec2 position = mix(u_Rect.xy, u_Rect.zw, corner);
+	vec2 ndc	  = (position - u_DisplayPos) / u_DisplaySize * 2.0 - 1.0;
+
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	v_TexCoord	= mix(u_TexRect.xy, u_TexRect.zw, corner);
+
+	// the mask holds the top row first like the image, which is the top of the display
+	v_MaskCoord = (position - u_ImageRect.xy) / (u_ImageRect.zw - u_ImageRect.xy);
+}
+
+#type fragment
+#version 450 core
+
+layout(binding = 0) uniform sampler2D u_Image;
+layout(binding = 1) uniform sampler2D u_Mask;
+
+layout(location = 5) uniform vec3  u_TargetLab;
+layout(location = 6) uniform float u_Threshold;
+layout(location = 7) uniform vec4  u_Highlight;
+layout(location = 8) uniform int   u_Source;		// 0 srgb encoded image, 1 linear (hdr) image, 2 the cpu mask
+
+in vec2 v_TexCoord;
+in vec2 v_MaskCoord;
+out vec4 o_Color;
+
+// the conversions of ColorSpace.cpp
+float SrgbToLinear(float value) {
+	float magnitude = abs(value);
+	return sign(value) * (magnitude <= 0.04045 ? magnitude / 12.92 : pow((magnitude + 0.055) / 1.055, 2.4));
+}
+
+float LabCurve(float t) {
+	return t > 216.0 / 24389.0 ? pow(t, 1.0 / 3.0) : t * (24389.0 / 27.0 / 116.0) + 16.0 / 116.0;
+}
+
+vec3 LinearToLab(vec3 rgb) {
+	float x = dot(vec3(0.4124564, 0.3575761, 0.1804375), rgb) / 0.95047;
+	float y = dot(vec3(0.2126729, 0.7151522, 0.0721750), rgb);
+	float z = dot(vec3(0.0193339, 0.1191920, 0.9503041), rgb) / 1.08883;
+
+	float fx = LabCurve(x), fy = LabCurve(y), fz = LabCurve(z);
+	return vec3(116.0 * fy - 16.0, 500.0 * (fx - fy), 200.0 * (fy - fz));
+}
+
+void main() {
+	if (u_Source == 2) {
+		if (texture(u_Mask, v_MaskCoord).r < 0.5)
+			discard;
+	}
+	else {
+		vec3 rgb = texture(u_Image, v_TexCoord).rgb;
+		if (u_Source == 0)
+			rgb = vec3(SrgbToLinear(rgb.r), SrgbToLinear(rgb.g), SrgbToLinear(rgb.b));
+
+		if (distance(LinearToLab(rgb), u_TargetLab) > u_Threshold)
+			discard;
+	}
+
+	o_Color = u_Highlight;
+}
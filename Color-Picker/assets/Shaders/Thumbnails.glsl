@@ -0,0 +1,41 @@
+#type vertex
+#version 450 core
+
+// one instance per thumbnail, the quad is a triangle strip made from the vertex id
+struct Thumbnail {
+	vec4 Rect;			// min and max corner in imgui display coordinates
+	vec4 Texture;		// uv of the max corner and the layer
+};
+
+layout(std430, binding = 0) readonly buffer Thumbnails {
+	Thumbnail thumbnails[];
+};
+
+layout(location = 0) uniform vec2 u_DisplayPos;
+layout(location = 1) uniform vec2 u_DisplaySize;
+
+out vec3 v_TexCoord;
+
+void main() {
+	Thumbnail thumbnail = thumbnails[gl_InstanceID];
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+	vec2 position = mix(thumbnail.Rect.xy, thumbnail.Rect.zw, corner);
+	vec2 ndc	  = (position - u_DisplayPos) / u_DisplaySize * 2.0 - 1.0;
+
+	// imgui's y points down, the layers hold the top row first like the image textures
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	v_TexCoord	= vec3(corner * thumbnail.Texture.xy, thumbnail.Texture.z);
+}
+
+#type fragment
+#version 450 core
+
+layout(binding = 0) uniform sampler2DArray u_Thumbnails;
+
+in vec3 v_TexCoord;
+out vec4 o_Color;
+
+void main() {
+	o_Color = texture(u_Thumbnails, v_TexCoord);
+}
@@ -0,0 +1,172 @@
+
+
+#include "ColorDifference.h"
+#include "ColorDifferenceSimd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+	#include <intrin.h>
+#endif
+
+namespace ColorDifference {
+
+	// fewest pairs a thread pool chunk of the many against many kernel works on
+	static constexpr size_t ChunkPairs = 1 << 14;
+
+	static bool CpuHasAvx2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+		int info[4];
+		__cpuid(info, 1);
+
+		// fma, and the os saving the ymm registers
+		bool fma	 = (info[2] & (1 << 12)) != 0;
+		bool osSaves = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+
+		__cpuidex(info, 7, 0);
+		return fma && osSaves && (info[1] & (1 << 5)) != 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		// this runs from a static initializer, which may come before the one of the runtime that fills in the cpu features
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+
+	static Path DetectBestPath() {
+		if (IsAvx2Built() && CpuHasAvx2())
+			return Path::Avx2;
+
+#ifdef COLOR_DIFFERENCE_SSE2
+		return Path::Sse2;
+#else
+		return Path::Scalar;
+#endif
+	}
+
+	static const Path bestPath = DetectBestPath();
+	static Path path = bestPath;
+
+	const char* GetPathName(Path path) {
+		switch (path) {
+			case Path::Sse2: return "sse2";
+			case Path::Avx2: return "avx2";
+			default:		 return "scalar";
+		}
+	}
+
+	Path GetBestPath() {
+		return bestPath;
+	}
+
+	Path GetPath() {
+		return path;
+	}
+
+	void SetPath(Path newPath) {
+		path = std::min(newPath, bestPath);
+	}
+
+	// c^7 / (c^7 + 25^7)
+	static double ChromaWeight(double chroma) {
+		double pow7 = std::pow(chroma, 7.0);
+		return pow7 / (pow7 + 6103515625.0);
+	}
+
+	static double HueDegrees(double b, double aPrime) {
+		if (b == 0.0 && aPrime == 0.0)
+			return 0.0;
+
+		double hue = std::atan2(b, aPrime) * (180.0 / 3.14159265358979323846);
+		return hue < 0.0 ? hue + 360.0 : hue;
+	}
+
+	float Ciede2000(const glm::vec3& lab1, const glm::vec3& lab2) {
+		constexpr double toRadians = 3.14159265358979323846 / 180.0;
+
+		double l1 = lab1.x, a1 = lab1.y, b1 = lab1.z;
+		double l2 = lab2.x, a2 = lab2.y, b2 = lab2.z;
+
+		// a is stretched for greyish colors, whose hue differences look larger than lab makes them
+		double meanChroma = (std::sqrt(a1 * a1 + b1 * b1) + std::sqrt(a2 * a2 + b2 * b2)) * 0.5;
+		double g = 0.5 * (1.0 - std::sqrt(ChromaWeight(meanChroma)));
+
+		double a1Prime = a1 * (1.0 + g), a2Prime = a2 * (1.0 + g);
+		double c1Prime = std::sqrt(a1Prime * a1Prime + b1 * b1);
+		double c2Prime = std::sqrt(a2Prime * a2Prime + b2 * b2);
+		double h1 = HueDegrees(b1, a1Prime);
+		double h2 = HueDegrees(b2, a2Prime);
+
+		double chromaProduct = c1Prime * c2Prime;
+
+		double deltaH = 0.0;
+		if (chromaProduct != 0.0) {
+			deltaH = h2 - h1;
+			if (deltaH > 180.0)
+				deltaH -= 360.0;
+			else if (deltaH < -180.0)
+				deltaH += 360.0;
+		}
+
+		double deltaL	 = l2 - l1;
+		double deltaC	 = c2Prime - c1Prime;
+		double deltaBigH = 2.0 * std::sqrt(chromaProduct) * std::sin(deltaH * 0.5 * toRadians);
+
+		double meanL = (l1 + l2) * 0.5;
+		double meanC = (c1Prime + c2Prime) * 0.5;
+
+		double meanH = h1 + h2;
+		if (chromaProduct != 0.0) {
+			if (std::abs(h1 - h2) <= 180.0)
+				meanH *= 0.5;
+			else
+				meanH = meanH < 360.0 ? (meanH + 360.0) * 0.5 : (meanH - 360.0) * 0.5;
+		}
+
+		double t = 1.0 - 0.17 * std::cos((meanH - 30.0) * toRadians) + 0.24 * std::cos(2.0 * meanH * toRadians)
+					   + 0.32 * std::cos((3.0 * meanH + 6.0) * toRadians) - 0.20 * std::cos((4.0 * meanH - 63.0) * toRadians);
+
+		double fromMid = (meanL - 50.0) * (meanL - 50.0);
+		double sl = 1.0 + 0.015 * fromMid / std::sqrt(20.0 + fromMid);
+		double sc = 1.0 + 0.045 * meanC;
+		double sh = 1.0 + 0.015 * meanC * t;
+
+		double fromBlue = (meanH - 275.0) / 25.0;
+		double theta	= 30.0 * std::exp(-fromBlue * fromBlue);
+		double rt		= -2.0 * std::sqrt(ChromaWeight(meanC)) * std::sin(2.0 * theta * toRadians);
+
+		double lightness = deltaL / sl, chroma = deltaC / sc, hue = deltaBigH / sh;
+		return (float)std::sqrt(lightness * lightness + chroma * chroma + hue * hue + rt * chroma * hue);
+	}
+
+	void Ciede2000(const glm::vec3& reference, const float* l, const float* a, const float* b, float* outDeltaE, size_t count) {
+		size_t i = 0;
+
+		if (path == Path::Avx2)
+			i = Ciede2000Avx2(reference.x, reference.y, reference.z, l, a, b, outDeltaE, count);
+
+#ifdef COLOR_DIFFERENCE_SSE2
+		if (path != Path::Scalar)
+			i += Ciede2000Lanes<Sse2Lanes>(reference.x, reference.y, reference.z, l + i, a + i, b + i, outDeltaE + i, count - i);
+#endif
+
+		for (; i < count; ++i)
+			outDeltaE[i] = Ciede2000(reference, { l[i], a[i], b[i] });
+	}
+
+	void Ciede2000(const float* l1, const float* a1, const float* b1, size_t count1, const float* l2, const float* a2, const float* b2, size_t count2, float* outDeltaE) {
+		if (count1 == 0 || count2 == 0)
+			return;
+
+		uint32_t rowsPerChunk = (uint32_t)std::max<size_t>(1, ChunkPairs / count2);
+
+		ThreadPool::ParallelFor((uint32_t)count1, rowsPerChunk, [&](uint32_t firstRow, uint32_t endRow) {
+			for (uint32_t row = firstRow; row < endRow; ++row)
+				Ciede2000({ l1[row], a1[row], b1[row] }, l2, a2, b2, outDeltaE + row * count2, count2);
+		});
+	}
+
+}
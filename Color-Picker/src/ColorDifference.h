@@ -0,0 +1,40 @@
+
+
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// cie delta e 2000 (kL = kC = kH = 1) between lab colors (d65, L 0..100 like ColorSpace), the difference colorists compare by
+// a scalar reference in doubles and batch kernels in floats over planar channels, written once for sse2 and for avx2 with
+// fma (chosen at run time from what the cpu has), the batch kernels agree with the reference to about 1e-4
+// except right at the 180 degree hue boundary of the mean hue, where float rounding may take the other side
+namespace ColorDifference {
+
+	enum class Path : uint32_t {
+		Scalar,
+		Sse2,
+		Avx2
+	};
+
+	const char* GetPathName(Path path);
+
+	// fastest path this build and cpu can run, and the one the batch kernels use (the best by default,
+	// lowered to compare them), a path that is not available falls back to the next slower one
+	Path GetBestPath();
+	Path GetPath();
+	void SetPath(Path path);
+
+	// the reference, follows sharma, wu and dalal's notes on the formula (hue and mean hue of achromatic colors)
+	float Ciede2000(const glm::vec3& lab1, const glm::vec3& lab2);
+
+	// any thread, one color against count colors
+	void Ciede2000(const glm::vec3& reference, const float* l, const float* a, const float* b, float* outDeltaE, size_t count);
+
+	// any thread, every color of the first set against every one of the second, outDeltaE holds count1 rows of count2
+	// rows are split over the thread pool
+	void Ciede2000(const float* l1, const float* a1, const float* b1, size_t count1, const float* l2, const float* a2, const float* b2, size_t count2, float* outDeltaE);
+
+}
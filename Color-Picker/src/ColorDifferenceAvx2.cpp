@@ -0,0 +1,77 @@
+
+
+// built with avx2 and fma enabled (see premake5.lua) and only called once the cpu has been checked for them,
+// so this file includes nothing but the kernel and the intrinsics, any shared inline function compiled here could
+// replace the sse2 build of it elsewhere in the app
+
+#include "ColorDifferenceSimd.h"
+
+#ifdef __AVX2__
+	#include <immintrin.h>
+#endif
+
+namespace ColorDifference {
+
+#ifdef __AVX2__
+
+	namespace {
+
+		struct Avx2Lanes {
+			using Float = __m256;
+			using Int	= __m256i;
+			static constexpr size_t Width = 8;
+
+			static Float Load(const float* p)		  { return _mm256_loadu_ps(p); }
+			static void	 Store(float* p, Float value) { _mm256_storeu_ps(p, value); }
+			static Float Set(float value)			  { return _mm256_set1_ps(value); }
+
+			static Float Add(Float a, Float b)	 { return _mm256_add_ps(a, b); }
+			static Float Sub(Float a, Float b)	 { return _mm256_sub_ps(a, b); }
+			static Float Mul(Float a, Float b)	 { return _mm256_mul_ps(a, b); }
+			static Float Div(Float a, Float b)	 { return _mm256_div_ps(a, b); }
+			static Float MulAdd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+			static Float Sqrt(Float a)			 { return _mm256_sqrt_ps(a); }
+			static Float Min(Float a, Float b)	 { return _mm256_min_ps(a, b); }
+			static Float Max(Float a, Float b)	 { return _mm256_max_ps(a, b); }
+			static Float Abs(Float a)			 { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+			static Float And(Float a, Float b)	  { return _mm256_and_ps(a, b); }
+			static Float AndNot(Float a, Float b) { return _mm256_andnot_ps(a, b); }
+			static Float Xor(Float a, Float b)	  { return _mm256_xor_ps(a, b); }
+			static Float Select(Float mask, Float ifTrue, Float ifFalse) { return _mm256_blendv_ps(ifFalse, ifTrue, mask); }
+
+			static Float Less(Float a, Float b)	   { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+			static Float Greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+			static Float Equal(Float a, Float b)   { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+
+			static Int	 Round(Float a)				{ return _mm256_cvtps_epi32(a); }
+			static Float ToFloat(Int a)				{ return _mm256_cvtepi32_ps(a); }
+			static Int	 AddInt(Int a, int b)		{ return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+			static Float IsOdd(Int a)				{ return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, _mm256_set1_epi32(1)), _mm256_set1_epi32(1))); }
+			static Float SignOfBit1(Int a)			{ return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(a, _mm256_set1_epi32(2)), 30)); }
+			static Float PowerOfTwo(Int exponent)	{ return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(exponent, _mm256_set1_epi32(127)), 23)); }
+		};
+
+	}
+
+	size_t Ciede2000Avx2(float l, float a, float b, const float* l2, const float* a2, const float* b2, float* outDeltaE, size_t count) {
+		return Ciede2000Lanes<Avx2Lanes>(l, a, b, l2, a2, b2, outDeltaE, count);
+	}
+
+	bool IsAvx2Built() {
+		return true;
+	}
+
+#else
+
+	size_t Ciede2000Avx2(float, float, float, const float*, const float*, const float*, float*, size_t) {
+		return 0;
+	}
+
+	bool IsAvx2Built() {
+		return false;
+	}
+
+#endif
+
+}
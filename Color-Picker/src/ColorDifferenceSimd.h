@@ -0,0 +1,238 @@
+
+
+#pragma once
+
+// the ciede2000 batch kernel written once over a lane type, used by ColorDifference.cpp (sse2) and
+// ColorDifferenceAvx2.cpp (avx2 and fma, built with those enabled), everything here has internal linkage so
+// no function compiled for avx2 can stand in for the sse2 one, and of the standard headers only cstddef is pulled in
+
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#define COLOR_DIFFERENCE_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace ColorDifference {
+
+	// one against count colors with the avx2 kernel, returns how many it did (a multiple of 8, 0 when the app was built
+	// without the avx2 file's flags), the caller checks the cpu first
+	size_t Ciede2000Avx2(float l, float a, float b, const float* l2, const float* a2, const float* b2, float* outDeltaE, size_t count);
+	bool IsAvx2Built();
+
+	namespace {
+
+		constexpr float Pi = 3.14159265358979f;
+
+		// 25^7, where the chroma weighting of a' and of the rotation term is halfway
+		constexpr float Pow25To7 = 6103515625.0f;
+
+		// atan2 in degrees 0..360, atan on 0..1 is a polynomial in the square (abramowitz and stegun 4.4.49, error 2e-8)
+		// unfolded by octant like ColorSpace's lch hue, 0 where both are 0
+		template<typename V>
+		typename V::Float HueDegrees(typename V::Float y, typename V::Float x) {
+			constexpr float coefficients[] = { 0.0028662257f, -0.0161657367f, 0.0429096138f, -0.0752896400f, 0.1065626393f, -0.1420889944f, 0.1999355085f, -0.3333314528f, 1.0f };
+
+			typename V::Float zero = V::Set(0.0f);
+			typename V::Float absX = V::Abs(x), absY = V::Abs(y);
+			typename V::Float max  = V::Max(absX, absY), min = V::Min(absX, absY);
+
+			typename V::Float ratio	 = V::And(V::Div(min, max), V::Greater(max, zero));
+			typename V::Float square = V::Mul(ratio, ratio);
+
+			typename V::Float angle = V::Set(coefficients[0]);
+			for (size_t i = 1; i < sizeof(coefficients) / sizeof(float); ++i)
+				angle = V::MulAdd(angle, square, V::Set(coefficients[i]));
+			angle = V::Mul(angle, ratio);
+
+			angle = V::Select(V::Greater(absY, absX), V::Sub(V::Set(Pi * 0.5f), angle), angle);
+			angle = V::Select(V::Less(x, zero), V::Sub(V::Set(Pi), angle), angle);
+			angle = V::Select(V::Less(y, zero), V::Sub(V::Set(2.0f * Pi), angle), angle);
+
+			// the lower half folds to 2 pi - angle, the positive x axis itself stays at 0
+			angle = V::And(angle, V::Less(angle, V::Set(2.0f * Pi)));
+			return V::Mul(angle, V::Set(180.0f / Pi));
+		}
+
+		// sine and cosine of radians, reduced to a quarter turn around 0 (cephes' sinf and cosf polynomials, error 1e-7)
+		template<typename V>
+		void SinCos(typename V::Float radians, typename V::Float& outSin, typename V::Float& outCos) {
+			typename V::Int	  quadrant = V::Round(V::Mul(radians, V::Set(2.0f / Pi)));
+			typename V::Float k		   = V::ToFloat(quadrant);
+
+			// pi / 2 in two parts so the reduction keeps the bits of larger angles
+			typename V::Float r = V::MulAdd(k, V::Set(-1.57079625129f), radians);
+			r = V::MulAdd(k, V::Set(-7.54978995489e-8f), r);
+
+			typename V::Float z = V::Mul(r, r);
+			typename V::Float sin = V::MulAdd(V::MulAdd(V::MulAdd(V::Set(-1.9515295891e-4f), z, V::Set(8.3321608736e-3f)), z, V::Set(-1.6666654611e-1f)), V::Mul(z, r), r);
+			typename V::Float cos = V::MulAdd(V::MulAdd(V::MulAdd(V::Set(2.443315711809948e-5f), z, V::Set(-1.388731625493765e-3f)), z, V::Set(4.166664568298827e-2f)), V::Mul(z, z), V::MulAdd(z, V::Set(-0.5f), V::Set(1.0f)));
+
+			// odd quadrants swap the two, sine is negative in quadrants 2 and 3 and cosine in 1 and 2
+			typename V::Float swap = V::IsOdd(quadrant);
+			outSin = V::Xor(V::Select(swap, cos, sin), V::SignOfBit1(quadrant));
+			outCos = V::Xor(V::Select(swap, sin, cos), V::SignOfBit1(V::AddInt(quadrant, 1)));
+		}
+
+		// e^x for x <= 0, 2^n from the exponent bits times a polynomial of the rest, underflows to about 1e-38
+		template<typename V>
+		typename V::Float Exp(typename V::Float x) {
+			x = V::Max(x, V::Set(-87.0f));
+
+			typename V::Int	  n = V::Round(V::Mul(x, V::Set(1.44269504089f)));
+			typename V::Float g = V::MulAdd(V::ToFloat(n), V::Set(-0.693147180560f), x);
+
+			typename V::Float poly = V::Set(1.0f / 720.0f);
+			poly = V::MulAdd(poly, g, V::Set(1.0f / 120.0f));
+			poly = V::MulAdd(poly, g, V::Set(1.0f / 24.0f));
+			poly = V::MulAdd(poly, g, V::Set(1.0f / 6.0f));
+			poly = V::MulAdd(poly, g, V::Set(0.5f));
+			poly = V::MulAdd(poly, g, V::Set(1.0f));
+			poly = V::MulAdd(poly, g, V::Set(1.0f));
+
+			return V::Mul(poly, V::PowerOfTwo(n));
+		}
+
+		// c^7 / (c^7 + 25^7)
+		template<typename V>
+		typename V::Float ChromaWeight(typename V::Float chroma) {
+			typename V::Float square = V::Mul(chroma, chroma);
+			typename V::Float pow7	 = V::Mul(V::Mul(square, square), V::Mul(square, chroma));
+			return V::Div(pow7, V::Add(pow7, V::Set(Pow25To7)));
+		}
+
+		// the steps of the scalar reference in ColorDifference.cpp, with selects in place of its branches
+		template<typename V>
+		typename V::Float Ciede2000(typename V::Float l1, typename V::Float a1, typename V::Float b1, typename V::Float l2, typename V::Float a2, typename V::Float b2) {
+			using Float = typename V::Float;
+			const Float zero = V::Set(0.0f), half = V::Set(0.5f), one = V::Set(1.0f), turn = V::Set(360.0f);
+			const Float toRadians = V::Set(Pi / 180.0f);
+
+			Float c1 = V::Sqrt(V::MulAdd(a1, a1, V::Mul(b1, b1)));
+			Float c2 = V::Sqrt(V::MulAdd(a2, a2, V::Mul(b2, b2)));
+			Float g	 = V::Mul(half, V::Sub(one, V::Sqrt(ChromaWeight<V>(V::Mul(V::Add(c1, c2), half)))));
+
+			Float a1Prime = V::MulAdd(a1, g, a1), a2Prime = V::MulAdd(a2, g, a2);
+			Float c1Prime = V::Sqrt(V::MulAdd(a1Prime, a1Prime, V::Mul(b1, b1)));
+			Float c2Prime = V::Sqrt(V::MulAdd(a2Prime, a2Prime, V::Mul(b2, b2)));
+			Float h1	  = HueDegrees<V>(b1, a1Prime);
+			Float h2	  = HueDegrees<V>(b2, a2Prime);
+
+			Float chromaProduct = V::Mul(c1Prime, c2Prime);
+			Float achromatic	= V::Equal(chromaProduct, zero);
+
+			// hue difference the short way around, none where either color has no hue
+			Float deltaH = V::Sub(h2, h1);
+			deltaH = V::Sub(deltaH, V::And(V::Greater(deltaH, V::Set(180.0f)), turn));
+			deltaH = V::Add(deltaH, V::And(V::Less(deltaH, V::Set(-180.0f)), turn));
+			deltaH = V::AndNot(achromatic, deltaH);
+
+			Float sinHalfH, cosHalfH;
+			SinCos<V>(V::Mul(deltaH, V::Set(Pi / 360.0f)), sinHalfH, cosHalfH);
+			Float deltaBigH = V::Mul(V::Mul(V::Set(2.0f), V::Sqrt(chromaProduct)), sinHalfH);
+
+			// mean hue the short way around as well
+			Float hueSum  = V::Add(h1, h2);
+			Float wrapped = V::Mul(V::Add(hueSum, V::Select(V::Less(hueSum, turn), turn, V::Sub(zero, turn))), half);
+			Float meanH	  = V::Select(V::Greater(V::Abs(V::Sub(h1, h2)), V::Set(180.0f)), wrapped, V::Mul(hueSum, half));
+			meanH = V::Select(achromatic, hueSum, meanH);
+
+			// the four cosines of t from the sine and cosine of the mean hue by the multiple angle formulas
+			Float s, c;
+			SinCos<V>(V::Mul(meanH, toRadians), s, c);
+
+			Float cos2 = V::MulAdd(V::Add(c, c), c, V::Sub(zero, one));
+			Float sin2 = V::Mul(V::Add(s, s), c);
+			Float cos3 = V::Mul(c, V::MulAdd(V::Set(4.0f), V::Mul(c, c), V::Set(-3.0f)));
+			Float sin3 = V::Mul(s, V::MulAdd(V::Set(-4.0f), V::Mul(s, s), V::Set(3.0f)));
+			Float cos4 = V::MulAdd(V::Add(cos2, cos2), cos2, V::Sub(zero, one));
+			Float sin4 = V::Mul(V::Add(sin2, sin2), cos2);
+
+			// cos(h - 30), cos(3h + 6) and cos(4h - 63) expanded with the constant angles
+			Float t = one;
+			t = V::MulAdd(V::Set(-0.17f), V::MulAdd(c, V::Set(0.866025404f), V::Mul(s, V::Set(0.5f))), t);
+			t = V::MulAdd(V::Set(0.24f), cos2, t);
+			t = V::MulAdd(V::Set(0.32f), V::MulAdd(cos3, V::Set(0.994521895f), V::Mul(sin3, V::Set(-0.104528463f))), t);
+			t = V::MulAdd(V::Set(-0.20f), V::MulAdd(cos4, V::Set(0.453990500f), V::Mul(sin4, V::Set(0.891006524f))), t);
+
+			Float meanL = V::Mul(V::Add(l1, l2), half);
+			Float meanC = V::Mul(V::Add(c1Prime, c2Prime), half);
+
+			Float fromMid = V::Sub(meanL, V::Set(50.0f));
+			Float fromMidSquare = V::Mul(fromMid, fromMid);
+			Float sl = V::MulAdd(V::Set(0.015f), V::Div(fromMidSquare, V::Sqrt(V::Add(fromMidSquare, V::Set(20.0f)))), one);
+			Float sc = V::MulAdd(V::Set(0.045f), meanC, one);
+			Float sh = V::MulAdd(V::Mul(V::Set(0.015f), meanC), t, one);
+
+			// rotation of the blue region, a gaussian around 275 degrees
+			Float fromBlue = V::Mul(V::Sub(meanH, V::Set(275.0f)), V::Set(1.0f / 25.0f));
+			Float theta	   = V::Mul(V::Set(30.0f), Exp<V>(V::Sub(zero, V::Mul(fromBlue, fromBlue))));
+
+			Float sin2Theta, cos2Theta;
+			SinCos<V>(V::Mul(theta, V::Set(Pi / 90.0f)), sin2Theta, cos2Theta);
+			Float rt = V::Mul(V::Mul(V::Set(-2.0f), V::Sqrt(ChromaWeight<V>(meanC))), sin2Theta);
+
+			Float lightness = V::Div(V::Sub(l2, l1), sl);
+			Float chroma	= V::Div(V::Sub(c2Prime, c1Prime), sc);
+			Float hue		= V::Div(deltaBigH, sh);
+
+			Float sum = V::MulAdd(lightness, lightness, V::MulAdd(chroma, chroma, V::MulAdd(hue, hue, V::Mul(rt, V::Mul(chroma, hue)))));
+			return V::Sqrt(V::Max(sum, zero));
+		}
+
+		// one color against count colors, whole registers only, returns how many were done
+		template<typename V>
+		size_t Ciede2000Lanes(float l, float a, float b, const float* l2, const float* a2, const float* b2, float* outDeltaE, size_t count) {
+			typename V::Float l1 = V::Set(l), a1 = V::Set(a), b1 = V::Set(b);
+			size_t i = 0;
+
+			for (; i + V::Width <= count; i += V::Width)
+				V::Store(outDeltaE + i, Ciede2000<V>(l1, a1, b1, V::Load(l2 + i), V::Load(a2 + i), V::Load(b2 + i)));
+
+			return i;
+		}
+
+#ifdef COLOR_DIFFERENCE_SSE2
+
+		struct Sse2Lanes {
+			using Float = __m128;
+			using Int	= __m128i;
+			static constexpr size_t Width = 4;
+
+			static Float Load(const float* p)		  { return _mm_loadu_ps(p); }
+			static void	 Store(float* p, Float value) { _mm_storeu_ps(p, value); }
+			static Float Set(float value)			  { return _mm_set1_ps(value); }
+
+			static Float Add(Float a, Float b)	 { return _mm_add_ps(a, b); }
+			static Float Sub(Float a, Float b)	 { return _mm_sub_ps(a, b); }
+			static Float Mul(Float a, Float b)	 { return _mm_mul_ps(a, b); }
+			static Float Div(Float a, Float b)	 { return _mm_div_ps(a, b); }
+			static Float MulAdd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			static Float Sqrt(Float a)			 { return _mm_sqrt_ps(a); }
+			static Float Min(Float a, Float b)	 { return _mm_min_ps(a, b); }
+			static Float Max(Float a, Float b)	 { return _mm_max_ps(a, b); }
+			static Float Abs(Float a)			 { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+			static Float And(Float a, Float b)	  { return _mm_and_ps(a, b); }
+			static Float AndNot(Float a, Float b) { return _mm_andnot_ps(a, b); }
+			static Float Xor(Float a, Float b)	  { return _mm_xor_ps(a, b); }
+			static Float Select(Float mask, Float ifTrue, Float ifFalse) { return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse)); }
+
+			static Float Less(Float a, Float b)	   { return _mm_cmplt_ps(a, b); }
+			static Float Greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+			static Float Equal(Float a, Float b)   { return _mm_cmpeq_ps(a, b); }
+
+			// to the nearest integer (the default rounding mode)
+			static Int	 Round(Float a)				{ return _mm_cvtps_epi32(a); }
+			static Float ToFloat(Int a)				{ return _mm_cvtepi32_ps(a); }
+			static Int	 AddInt(Int a, int b)		{ return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+			static Float IsOdd(Int a)				{ return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, _mm_set1_epi32(1)), _mm_set1_epi32(1))); }
+			static Float SignOfBit1(Int a)			{ return _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(a, _mm_set1_epi32(2)), 30)); }
+			static Float PowerOfTwo(Int exponent)	{ return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127)), 23)); }
+		};
+
+#endif
+
+	}
+
+}
@@ -0,0 +1,292 @@
+
+
+#include "ColorLibrary.h"
+#include "ColorSpace.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace ColorLibrary {
+
+	static constexpr char	  FileMagic[8] = { 'C', 'P', 'C', 'O', 'L', 'O', 'R', 'S' };
+	static constexpr uint32_t FileVersion  = 1;
+
+	// most matches one lookup keeps
+	static constexpr size_t MaxMatches = 32;
+
+	// written in native byte order, packed on the machine that builds the app
+	struct FileHeader {
+		char	 Magic[8];
+		uint32_t Version;
+		uint32_t ColorCount;
+		uint32_t NamesSize;		// bytes of '\0' terminated names following the nodes
+		uint32_t Reserved;
+	};
+
+	// a color and the k-d tree node it is, the node of a range [begin, end) sits at begin + (end - begin) / 2
+	// with the colors below it on the split axis before it and the ones above after it
+	struct Node {
+		float	 Lab[3];
+		uint8_t	 Srgb[3];
+		uint8_t	 Axis;
+		uint32_t NameOffset;
+	};
+
+	static_assert(sizeof(Node) == 20, "packed libraries store nodes as 20 bytes");
+
+	struct Library {
+		std::string		  Name;
+		std::vector<Node> Nodes;
+		std::vector<char> Names;
+	};
+
+	static std::vector<Library> libraries;
+	static uint32_t colorCount = 0;
+
+	// nearest colors found so far, closest first
+	struct Nearest {
+		size_t	 Capacity = 0;
+		size_t	 Count	  = 0;
+		float	 DistanceSq[MaxMatches];
+		uint32_t Library[MaxMatches];
+		uint32_t Node[MaxMatches];
+
+		float GetWorst() const {
+			return Count < Capacity ? FLT_MAX : DistanceSq[Count - 1];
+		}
+
+		void Offer(float distanceSq, uint32_t library, uint32_t node) {
+			if (distanceSq >= GetWorst())
+				return;
+
+			size_t i = Count < Capacity ? Count++ : Count - 1;
+			for (; i > 0 && DistanceSq[i - 1] > distanceSq; --i) {
+				DistanceSq[i] = DistanceSq[i - 1];
+				Library[i]	  = Library[i - 1];
+				Node[i]		  = Node[i - 1];
+			}
+
+			DistanceSq[i] = distanceSq;
+			Library[i]	  = library;
+			Node[i]		  = node;
+		}
+	};
+
+	static std::string Trim(const std::string& text) {
+		size_t first = text.find_first_not_of(" \t\r");
+		if (first == std::string::npos)
+			return "";
+
+		return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+	}
+
+	static bool ParseHex(const std::string& text, uint8_t (&outSrgb)[3]) {
+		std::string digits = text.size() == 7 && text[0] == '#' ? text.substr(1) : text;
+		if (digits.size() != 6 || digits.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos)
+			return false;
+
+		for (int i = 0; i < 3; ++i)
+			outSrgb[i] = (uint8_t)std::stoul(digits.substr(i * 2, 2), nullptr, 16);
+
+		return true;
+	}
+
+	// orders nodes [begin, end) into a k-d tree, each range split at its median on the component that spreads the most
+	static void BuildTree(std::vector<Node>& nodes, size_t begin, size_t end) {
+		if (end - begin < 2) {
+			if (begin < end)
+				nodes[begin].Axis = 0;
+
+			return;
+		}
+
+		float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = begin; i < end; ++i) {
+			for (int c = 0; c < 3; ++c) {
+				min[c] = std::min(min[c], nodes[i].Lab[c]);
+				max[c] = std::max(max[c], nodes[i].Lab[c]);
+			}
+		}
+
+		uint8_t axis = 0;
+		for (uint8_t c = 1; c < 3; ++c) {
+			if (max[c] - min[c] > max[axis] - min[axis])
+				axis = c;
+		}
+
+		size_t middle = begin + (end - begin) / 2;
+		std::nth_element(nodes.begin() + begin, nodes.begin() + middle, nodes.begin() + end, [axis](const Node& a, const Node& b) { return a.Lab[axis] < b.Lab[axis]; });
+		nodes[middle].Axis = axis;
+
+		BuildTree(nodes, begin, middle);
+		BuildTree(nodes, middle + 1, end);
+	}
+
+	bool Pack(const std::string& textPath, const std::string& packedPath) {
+		std::ifstream text(textPath);
+		if (!text.is_open()) {
+			std::cout << "Could not open color library " << textPath << "\n";
+			return false;
+		}
+
+		std::vector<Node> nodes;
+		std::vector<char> names;
+
+		// blank lines and lines starting with # are skipped, names may hold commas as the color follows the last one
+		std::string line;
+		for (uint32_t lineNumber = 1; std::getline(text, line); ++lineNumber) {
+			line = Trim(line);
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			size_t comma = line.rfind(',');
+			std::string name = comma != std::string::npos ? Trim(line.substr(0, comma)) : "";
+
+			Node node = {};
+			if (name.empty() || !ParseHex(Trim(line.substr(comma + 1)), node.Srgb)) {
+				std::cout << textPath << ":" << lineNumber << ": expected \"name,#rrggbb\"\n";
+				return false;
+			}
+
+			glm::vec3 linear = { ColorSpace::DecodeSrgb8(node.Srgb[0]), ColorSpace::DecodeSrgb8(node.Srgb[1]), ColorSpace::DecodeSrgb8(node.Srgb[2]) };
+			glm::vec3 lab	 = ColorSpace::XyzToLab(ColorSpace::LinearToXyz(linear));
+
+			node.Lab[0]		= lab.x;
+			node.Lab[1]		= lab.y;
+			node.Lab[2]		= lab.z;
+			node.NameOffset = (uint32_t)names.size();
+			nodes.push_back(node);
+
+			names.insert(names.end(), name.begin(), name.end());
+			names.push_back('\0');
+		}
+
+		BuildTree(nodes, 0, nodes.size());
+
+		FileHeader header = {};
+		memcpy(header.Magic, FileMagic, sizeof(FileMagic));
+		header.Version	  = FileVersion;
+		header.ColorCount = (uint32_t)nodes.size();
+		header.NamesSize  = (uint32_t)names.size();
+
+		std::ofstream packed(packedPath, std::ios::binary | std::ios::trunc);
+		packed.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		packed.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(Node));
+		packed.write(names.data(), names.size());
+
+		if (!packed.good()) {
+			std::cout << "Could not write color library " << packedPath << "\n";
+			return false;
+		}
+
+		return true;
+	}
+
+	// one read of the whole file, what is left is checking that it can be trusted
+	static bool LoadLibrary(const std::filesystem::path& path, Library& outLibrary) {
+		std::ifstream file(path, std::ios::binary);
+		std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		FileHeader header = {};
+		if (bytes.size() < sizeof(header))
+			return false;
+
+		memcpy(&header, bytes.data(), sizeof(header));
+		if (memcmp(header.Magic, FileMagic, sizeof(FileMagic)) != 0 || header.Version != FileVersion ||
+			bytes.size() != sizeof(header) + (uint64_t)header.ColorCount * sizeof(Node) + header.NamesSize)
+			return false;
+
+		outLibrary.Name = path.stem().string();
+		outLibrary.Nodes.resize(header.ColorCount);
+		memcpy(outLibrary.Nodes.data(), bytes.data() + sizeof(header), outLibrary.Nodes.size() * sizeof(Node));
+		outLibrary.Names.assign(bytes.end() - header.NamesSize, bytes.end());
+
+		if (!outLibrary.Names.empty() && outLibrary.Names.back() != '\0')
+			return false;
+
+		return std::all_of(outLibrary.Nodes.begin(), outLibrary.Nodes.end(), [&](const Node& node) { return node.Axis < 3 && node.NameOffset < header.NamesSize; });
+	}
+
+	void Init(const std::string& directory) {
+		Shutdown();
+
+		std::error_code error;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (entry.path().extension() != PackedExtension)
+				continue;
+
+			Library library;
+			if (!LoadLibrary(entry.path(), library)) {
+				std::cout << "Skipping broken color library " << entry.path().string() << "\n";
+				continue;
+			}
+
+			colorCount += (uint32_t)library.Nodes.size();
+			libraries.push_back(std::move(library));
+		}
+	}
+
+	void Shutdown() {
+		libraries.clear();
+		colorCount = 0;
+	}
+
+	uint32_t GetColorCount() {
+		return colorCount;
+	}
+
+	static void Search(const std::vector<Node>& nodes, uint32_t library, size_t begin, size_t end, const glm::vec3& lab, Nearest& nearest) {
+		while (begin < end) {
+			size_t middle = begin + (end - begin) / 2;
+			const Node& node = nodes[middle];
+
+			float dL = lab.x - node.Lab[0], dA = lab.y - node.Lab[1], dB = lab.z - node.Lab[2];
+			nearest.Offer(dL * dL + dA * dA + dB * dB, library, (uint32_t)middle);
+
+			// the half the color is in first, the other only while the split plane is closer than the worst match
+			float split = lab[node.Axis] - node.Lab[node.Axis];
+			if (split < 0.0f) {
+				Search(nodes, library, begin, middle, lab, nearest);
+				begin = middle + 1;
+			}
+			else {
+				Search(nodes, library, middle + 1, end, lab, nearest);
+				end = middle;
+			}
+
+			if (split * split >= nearest.GetWorst())
+				return;
+		}
+	}
+
+	size_t FindNearest(const glm::vec3& lab, std::span<Match> outMatches) {
+		Nearest nearest;
+		nearest.Capacity = std::min(outMatches.size(), MaxMatches);
+		if (nearest.Capacity == 0)
+			return 0;
+
+		for (uint32_t i = 0; i < (uint32_t)libraries.size(); ++i)
+			Search(libraries[i].Nodes, i, 0, libraries[i].Nodes.size(), lab, nearest);
+
+		for (size_t i = 0; i < nearest.Count; ++i) {
+			const Library& library = libraries[nearest.Library[i]];
+			const Node&	   node	   = library.Nodes[nearest.Node[i]];
+
+			Match& match  = outMatches[i];
+			match.Name	  = library.Names.data() + node.NameOffset;
+			match.Library = library.Name.c_str();
+			match.Color	  = { node.Srgb[0] / 255.0f, node.Srgb[1] / 255.0f, node.Srgb[2] / 255.0f, 1.0f };
+			match.Lab	  = { node.Lab[0], node.Lab[1], node.Lab[2] };
+			match.DeltaE  = std::sqrt(nearest.DistanceSq[i]);
+		}
+
+		return nearest.Count;
+	}
+
+}
@@ -0,0 +1,41 @@
+
+
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+// named colors (css, paint or brand libraries) looked up by distance to a picked color, delta e 1976 in lab
+// libraries are text files of "name,#rrggbb" lines packed at build time by the ColorLibraryPacker tool into
+// binary files that hold the colors already in lab and already ordered as a balanced k-d tree, so loading one
+// is a single read and a lookup visits a few dozen of the tens of thousands of entries
+namespace ColorLibrary {
+
+	// file extension of packed libraries
+	static constexpr const char* PackedExtension = ".clib";
+
+	struct Match {
+		const char* Name	= "";
+		const char* Library = "";		// file name of the library without extension
+		glm::vec4	Color	= glm::vec4(0.0f);		// srgb 0..1, alpha 1
+		glm::vec3	Lab		= glm::vec3(0.0f);
+		float		DeltaE	= 0.0f;
+	};
+
+	// text library to packed library, false (with the reason printed) if the text has errors or the file can not be written
+	bool Pack(const std::string& textPath, const std::string& packedPath);
+
+	// loads every packed library of directory, libraries stay loaded until Shutdown
+	void Init(const std::string& directory);
+	void Shutdown();
+
+	uint32_t GetColorCount();
+
+	// any thread after Init, fills outMatches with the nearest colors of all libraries closest first, returns how many were found
+	size_t FindNearest(const glm::vec3& lab, std::span<Match> outMatches);
+
+}
@@ -0,0 +1,691 @@
+
+
+#include "ColorSpace.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#define COLOR_SPACE_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace ColorSpace {
+
+	static constexpr float Pi = 3.14159265358979f;
+
+	// d65 white of srgb in xyz
+	static constexpr float WhiteX = 0.95047f;
+	static constexpr float WhiteZ = 1.08883f;
+
+	// lab's cube root turns linear below this
+	static constexpr float LabEpsilon = 216.0f / 24389.0f;
+	static constexpr float LabSlope	  = 24389.0f / 27.0f / 116.0f;
+
+	// rows converted per chunk of the thread pool
+	static constexpr uint32_t ChunkPixels = 1 << 14;
+
+	// x^2.4 as x^2 times the fifth root of x^2, newton's method from above needs no constexpr pow
+	static constexpr double ConstexprPow24(double x) {
+		double square = x * x;
+		double root	  = 1.0;
+
+		for (int i = 0; i < 64; ++i)
+			root -= (root * root * root * root * root - square) / (5.0 * root * root * root * root);
+
+		return square * root;
+	}
+
+	static constexpr std::array<float, 256> MakeSrgbDecodeTable() {
+		std::array<float, 256> table = {};
+
+		for (int i = 0; i < 256; ++i) {
+			double value = i / 255.0;
+			table[i] = (float)(value <= 0.04045 ? value / 12.92 : ConstexprPow24((value + 0.055) / 1.055));
+		}
+
+		return table;
+	}
+
+	static constexpr std::array<float, 256> srgbDecodeTable = MakeSrgbDecodeTable();
+
+	static_assert(srgbDecodeTable[0] == 0.0f && srgbDecodeTable[255] == 1.0f, "srgb decode table must keep black and white exact");
+	static_assert(srgbDecodeTable[128] > 0.2158602f && srgbDecodeTable[128] < 0.2158608f, "srgb decode table is off the curve");
+
+	static const char* const spaceNames[] = { "sRGB", "Linear RGB", "HSV", "HSL", "XYZ", "Lab", "LCh", "OKLab", "CMYK" };
+
+	static const char* const componentNames[][4] = {
+		{ "R", "G", "B", "" },
+		{ "R", "G", "B", "" },
+		{ "H", "S", "V", "" },
+		{ "H", "S", "L", "" },
+		{ "X", "Y", "Z", "" },
+		{ "L", "a", "b", "" },
+		{ "L", "C", "h", "" },
+		{ "L", "a", "b", "" },
+		{ "C", "M", "Y", "K" }
+	};
+
+	const char* GetName(Space space) {
+		return space < Space::Count ? spaceNames[(uint32_t)space] : "";
+	}
+
+	uint32_t GetComponentCount(Space space) {
+		return space == Space::Cmyk ? 4 : 3;
+	}
+
+	const char* GetComponentName(Space space, uint32_t component) {
+		return space < Space::Count && component < 4 ? componentNames[(uint32_t)space][component] : "";
+	}
+
+	float DecodeSrgb8(uint8_t value) {
+		return srgbDecodeTable[value];
+	}
+
+	float SrgbToLinear(float value) {
+		float magnitude = std::abs(value);
+		float linear	= magnitude <= 0.04045f ? magnitude / 12.92f : std::pow((magnitude + 0.055f) / 1.055f, 2.4f);
+		return std::copysign(linear, value);
+	}
+
+	float LinearToSrgb(float value) {
+		float magnitude = std::abs(value);
+		float encoded	= magnitude <= 0.0031308f ? magnitude * 12.92f : 1.055f * std::pow(magnitude, 1.0f / 2.4f) - 0.055f;
+		return std::copysign(encoded, value);
+	}
+
+	glm::vec3 SrgbToLinear(const glm::vec3& rgb) {
+		return { SrgbToLinear(rgb.x), SrgbToLinear(rgb.y), SrgbToLinear(rgb.z) };
+	}
+
+	glm::vec3 LinearToSrgb(const glm::vec3& rgb) {
+		return { LinearToSrgb(rgb.x), LinearToSrgb(rgb.y), LinearToSrgb(rgb.z) };
+	}
+
+	glm::vec3 LinearToXyz(const glm::vec3& rgb) {
+		return {
+			0.4124564f * rgb.x + 0.3575761f * rgb.y + 0.1804375f * rgb.z,
+			0.2126729f * rgb.x + 0.7151522f * rgb.y + 0.0721750f * rgb.z,
+			0.0193339f * rgb.x + 0.1191920f * rgb.y + 0.9503041f * rgb.z
+		};
+	}
+
+	glm::vec3 XyzToLinear(const glm::vec3& xyz) {
+		return {
+			 3.2404542f * xyz.x - 1.5371385f * xyz.y - 0.4985314f * xyz.z,
+			-0.9692660f * xyz.x + 1.8760108f * xyz.y + 0.0415560f * xyz.z,
+			 0.0556434f * xyz.x - 0.2040259f * xyz.y + 1.0572252f * xyz.z
+		};
+	}
+
+	static float LabCurve(float t) {
+		return t > LabEpsilon ? std::cbrt(t) : LabSlope * t + 16.0f / 116.0f;
+	}
+
+	static float InverseLabCurve(float f) {
+		return f * f * f > LabEpsilon ? f * f * f : (f - 16.0f / 116.0f) / LabSlope;
+	}
+
+	glm::vec3 XyzToLab(const glm::vec3& xyz) {
+		float fx = LabCurve(xyz.x / WhiteX), fy = LabCurve(xyz.y), fz = LabCurve(xyz.z / WhiteZ);
+		return { 116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz) };
+	}
+
+	glm::vec3 LabToXyz(const glm::vec3& lab) {
+		float fy = (lab.x + 16.0f) / 116.0f;
+		return { WhiteX * InverseLabCurve(fy + lab.y / 500.0f), InverseLabCurve(fy), WhiteZ * InverseLabCurve(fy - lab.z / 200.0f) };
+	}
+
+	glm::vec3 LabToLch(const glm::vec3& lab) {
+		float hue = std::atan2(lab.z, lab.y) * (180.0f / Pi);
+		return { lab.x, std::sqrt(lab.y * lab.y + lab.z * lab.z), hue < 0.0f ? hue + 360.0f : hue };
+	}
+
+	glm::vec3 LchToLab(const glm::vec3& lch) {
+		float hue = lch.z * (Pi / 180.0f);
+		return { lch.x, lch.y * std::cos(hue), lch.y * std::sin(hue) };
+	}
+
+	glm::vec3 LinearToOklab(const glm::vec3& rgb) {
+		float l = std::cbrt(0.4122214708f * rgb.x + 0.5363325363f * rgb.y + 0.0514459929f * rgb.z);
+		float m = std::cbrt(0.2119034982f * rgb.x + 0.6806995451f * rgb.y + 0.1073969566f * rgb.z);
+		float s = std::cbrt(0.0883024619f * rgb.x + 0.2817188376f * rgb.y + 0.6299787005f * rgb.z);
+
+		return {
+			0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s,
+			1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s,
+			0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s
+		};
+	}
+
+	glm::vec3 OklabToLinear(const glm::vec3& lab) {
+		float l = lab.x + 0.3963377774f * lab.y + 0.2158037573f * lab.z;
+		float m = lab.x - 0.1055613458f * lab.y - 0.0638541728f * lab.z;
+		float s = lab.x - 0.0894841775f * lab.y - 1.2914855480f * lab.z;
+
+		l = l * l * l;
+		m = m * m * m;
+		s = s * s * s;
+
+		return {
+			 4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s,
+			-1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s,
+			-0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s
+		};
+	}
+
+	// hue in degrees of the hexagon hsv and hsl share, 0 for greys
+	static float HexagonHue(const glm::vec3& rgb, float max, float delta) {
+		if (delta <= 0.0f)
+			return 0.0f;
+
+		float hue;
+		if (max == rgb.x)
+			hue = (rgb.y - rgb.z) / delta;
+		else if (max == rgb.y)
+			hue = (rgb.z - rgb.x) / delta + 2.0f;
+		else
+			hue = (rgb.x - rgb.y) / delta + 4.0f;
+
+		hue *= 60.0f;
+		return hue < 0.0f ? hue + 360.0f : hue;
+	}
+
+	// rgb of a hue with the given chroma, lifted by offset
+	static glm::vec3 HexagonRgb(float hue, float chroma, float offset) {
+		float sector = std::fmod(std::fmod(hue, 360.0f) + 360.0f, 360.0f) / 60.0f;
+		float second = chroma * (1.0f - std::abs(std::fmod(sector, 2.0f) - 1.0f));
+
+		glm::vec3 rgb;
+		switch ((int)sector) {
+			case 0:	 rgb = { chroma, second, 0.0f }; break;
+			case 1:	 rgb = { second, chroma, 0.0f }; break;
+			case 2:	 rgb = { 0.0f, chroma, second }; break;
+			case 3:	 rgb = { 0.0f, second, chroma }; break;
+			case 4:	 rgb = { second, 0.0f, chroma }; break;
+			default: rgb = { chroma, 0.0f, second }; break;
+		}
+
+		return { rgb.x + offset, rgb.y + offset, rgb.z + offset };
+	}
+
+	glm::vec3 RgbToHsv(const glm::vec3& rgb) {
+		float max = std::max({ rgb.x, rgb.y, rgb.z }), min = std::min({ rgb.x, rgb.y, rgb.z });
+		float delta = max - min;
+		return { HexagonHue(rgb, max, delta), max > 0.0f ? delta / max : 0.0f, max };
+	}
+
+	glm::vec3 HsvToRgb(const glm::vec3& hsv) {
+		float chroma = hsv.z * hsv.y;
+		return HexagonRgb(hsv.x, chroma, hsv.z - chroma);
+	}
+
+	glm::vec3 RgbToHsl(const glm::vec3& rgb) {
+		float max = std::max({ rgb.x, rgb.y, rgb.z }), min = std::min({ rgb.x, rgb.y, rgb.z });
+		float delta		= max - min;
+		float lightness = (max + min) * 0.5f;
+		float spread	= 1.0f - std::abs(2.0f * lightness - 1.0f);
+		return { HexagonHue(rgb, max, delta), delta > 0.0f && spread > 0.0f ? delta / spread : 0.0f, lightness };
+	}
+
+	glm::vec3 HslToRgb(const glm::vec3& hsl) {
+		float chroma = (1.0f - std::abs(2.0f * hsl.z - 1.0f)) * hsl.y;
+		return HexagonRgb(hsl.x, chroma, hsl.z - chroma * 0.5f);
+	}
+
+	glm::vec4 RgbToCmyk(const glm::vec3& rgb) {
+		float black = 1.0f - std::max({ rgb.x, rgb.y, rgb.z });
+		if (black >= 1.0f)
+			return { 0.0f, 0.0f, 0.0f, 1.0f };
+
+		float scale = 1.0f / (1.0f - black);
+		return { (1.0f - rgb.x - black) * scale, (1.0f - rgb.y - black) * scale, (1.0f - rgb.z - black) * scale, black };
+	}
+
+	glm::vec3 CmykToRgb(const glm::vec4& cmyk) {
+		float white = 1.0f - cmyk.w;
+		return { (1.0f - cmyk.x) * white, (1.0f - cmyk.y) * white, (1.0f - cmyk.z) * white };
+	}
+
+	glm::vec4 FromSrgb(const glm::vec3& srgb, Space space) {
+		switch (space) {
+			case Space::LinearRgb: return glm::vec4(SrgbToLinear(srgb), 0.0f);
+			case Space::Hsv:	   return glm::vec4(RgbToHsv(srgb), 0.0f);
+			case Space::Hsl:	   return glm::vec4(RgbToHsl(srgb), 0.0f);
+			case Space::Xyz:	   return glm::vec4(LinearToXyz(SrgbToLinear(srgb)), 0.0f);
+			case Space::Lab:	   return glm::vec4(XyzToLab(LinearToXyz(SrgbToLinear(srgb))), 0.0f);
+			case Space::Lch:	   return glm::vec4(LabToLch(XyzToLab(LinearToXyz(SrgbToLinear(srgb)))), 0.0f);
+			case Space::Oklab:	   return glm::vec4(LinearToOklab(SrgbToLinear(srgb)), 0.0f);
+			case Space::Cmyk:	   return RgbToCmyk(srgb);
+			default:			   return glm::vec4(srgb, 0.0f);
+		}
+	}
+
+	glm::vec3 ToSrgb(const glm::vec4& color, Space space) {
+		glm::vec3 components = { color.x, color.y, color.z };
+
+		switch (space) {
+			case Space::LinearRgb: return LinearToSrgb(components);
+			case Space::Hsv:	   return HsvToRgb(components);
+			case Space::Hsl:	   return HslToRgb(components);
+			case Space::Xyz:	   return LinearToSrgb(XyzToLinear(components));
+			case Space::Lab:	   return LinearToSrgb(XyzToLinear(LabToXyz(components)));
+			case Space::Lch:	   return LinearToSrgb(XyzToLinear(LabToXyz(LchToLab(components))));
+			case Space::Oklab:	   return LinearToSrgb(OklabToLinear(components));
+			case Space::Cmyk:	   return CmykToRgb(color);
+			default:			   return components;
+		}
+	}
+
+	// the gather of the decode table has no simd form before avx2
+	void DecodeSrgb8(const uint8_t* rgba, float* outR, float* outG, float* outB, size_t count) {
+		for (size_t i = 0; i < count; ++i, rgba += 4) {
+			outR[i] = srgbDecodeTable[rgba[0]];
+			outG[i] = srgbDecodeTable[rgba[1]];
+			outB[i] = srgbDecodeTable[rgba[2]];
+		}
+	}
+
+#ifdef COLOR_SPACE_SSE2
+
+	static __m128 Select(__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+		return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+	}
+
+	// rows of a 3x3 matrix times 4 vectors
+	static void Transform(const float (&m)[9], __m128& x, __m128& y, __m128& z) {
+		__m128 outX = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[0]), x), _mm_mul_ps(_mm_set1_ps(m[1]), y)), _mm_mul_ps(_mm_set1_ps(m[2]), z));
+		__m128 outY = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[3]), x), _mm_mul_ps(_mm_set1_ps(m[4]), y)), _mm_mul_ps(_mm_set1_ps(m[5]), z));
+		__m128 outZ = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m[6]), x), _mm_mul_ps(_mm_set1_ps(m[7]), y)), _mm_mul_ps(_mm_set1_ps(m[8]), z));
+
+		x = outX;
+		y = outY;
+		z = outZ;
+	}
+
+	// cube root of any sign, a guess from the exponent bits divided by 3 refined by three newton steps
+	static __m128 Cbrt(__m128 value) {
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 sign		 = _mm_and_ps(value, signMask);
+		__m128 magnitude = _mm_andnot_ps(signMask, value);
+
+		__m128i bits = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_castps_si128(magnitude)), _mm_set1_ps(1.0f / 3.0f)));
+		__m128	root = _mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(709921077)));
+
+		const __m128 twoThirds = _mm_set1_ps(2.0f / 3.0f), third = _mm_set1_ps(1.0f / 3.0f);
+		for (int i = 0; i < 3; ++i)
+			root = _mm_add_ps(_mm_mul_ps(root, twoThirds), _mm_mul_ps(_mm_div_ps(magnitude, _mm_mul_ps(root, root)), third));
+
+		// the guess for 0 only shrinks towards it
+		root = _mm_and_ps(root, _mm_cmpgt_ps(magnitude, _mm_setzero_ps()));
+		return _mm_or_ps(root, sign);
+	}
+
+	// atan2 in degrees 0..360, atan on 0..1 is a polynomial in the square (abramowitz and stegun 4.4.49, error 2e-8) unfolded by octant
+	static __m128 HueDegrees(__m128 y, __m128 x) {
+		static constexpr float coefficients[] = { 0.0028662257f, -0.0161657367f, 0.0429096138f, -0.0752896400f, 0.1065626393f, -0.1420889944f, 0.1999355085f, -0.3333314528f, 1.0f };
+
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+		__m128 absX = _mm_andnot_ps(signMask, x), absY = _mm_andnot_ps(signMask, y);
+
+		__m128 max = _mm_max_ps(absX, absY), min = _mm_min_ps(absX, absY);
+		__m128 ratio  = _mm_and_ps(_mm_div_ps(min, max), _mm_cmpgt_ps(max, _mm_setzero_ps()));
+		__m128 square = _mm_mul_ps(ratio, ratio);
+
+		__m128 angle = _mm_set1_ps(coefficients[0]);
+		for (size_t i = 1; i < sizeof(coefficients) / sizeof(float); ++i)
+			angle = _mm_add_ps(_mm_mul_ps(angle, square), _mm_set1_ps(coefficients[i]));
+		angle = _mm_mul_ps(angle, ratio);
+
+		angle = Select(_mm_cmpgt_ps(absY, absX), _mm_sub_ps(_mm_set1_ps(Pi * 0.5f), angle), angle);
+		angle = Select(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(Pi), angle), angle);
+		angle = Select(_mm_cmplt_ps(y, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(2.0f * Pi), angle), angle);
+
+		// the lower half folds to 2 pi - angle, the positive x axis itself stays at 0
+		angle = _mm_and_ps(angle, _mm_cmplt_ps(angle, _mm_set1_ps(2.0f * Pi)));
+		return _mm_mul_ps(angle, _mm_set1_ps(180.0f / Pi));
+	}
+
+	static __m128 LabCurve(__m128 t) {
+		__m128 linear = _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(LabSlope)), _mm_set1_ps(16.0f / 116.0f));
+		return Select(_mm_cmpgt_ps(t, _mm_set1_ps(LabEpsilon)), Cbrt(t), linear);
+	}
+
+	// hsv and hsl hue, max and min of 4 pixels
+	static __m128 HexagonHue(__m128 r, __m128 g, __m128 b, __m128 max, __m128 delta) {
+		__m128 grey		  = _mm_cmple_ps(delta, _mm_setzero_ps());
+		__m128 inverse	  = _mm_div_ps(_mm_set1_ps(1.0f), Select(grey, _mm_set1_ps(1.0f), delta));
+		__m128 fromRed	  = _mm_mul_ps(_mm_sub_ps(g, b), inverse);
+		__m128 fromGreen  = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(b, r), inverse), _mm_set1_ps(2.0f));
+		__m128 fromBlue	  = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(r, g), inverse), _mm_set1_ps(4.0f));
+
+		// same order of tests as the scalar version, red wins ties
+		__m128 hue = Select(_mm_cmpeq_ps(max, g), fromGreen, fromBlue);
+		hue = Select(_mm_cmpeq_ps(max, r), fromRed, hue);
+		hue = _mm_mul_ps(hue, _mm_set1_ps(60.0f));
+		hue = _mm_add_ps(hue, _mm_and_ps(_mm_cmplt_ps(hue, _mm_setzero_ps()), _mm_set1_ps(360.0f)));
+		return _mm_andnot_ps(grey, hue);
+	}
+
+#endif
+
+	void UnpackRgba8(const uint8_t* rgba, float* outR, float* outG, float* outB, size_t count) {
+		size_t i = 0;
+
+#ifdef COLOR_SPACE_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128  scale = _mm_set1_ps(1.0f / 255.0f);
+
+		for (; i + 4 <= count; i += 4) {
+			__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 4));
+			__m128i low	   = _mm_unpacklo_epi8(values, zero);
+			__m128i high   = _mm_unpackhi_epi8(values, zero);
+
+			// one pixel per register, transposed to one channel per register
+			__m128 p0 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low,  zero)), scale);
+			__m128 p1 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low,  zero)), scale);
+			__m128 p2 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale);
+			__m128 p3 = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale);
+			_MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+
+			_mm_storeu_ps(outR + i, p0);
+			_mm_storeu_ps(outG + i, p1);
+			_mm_storeu_ps(outB + i, p2);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			outR[i] = rgba[i * 4 + 0] / 255.0f;
+			outG[i] = rgba[i * 4 + 1] / 255.0f;
+			outB[i] = rgba[i * 4 + 2] / 255.0f;
+		}
+	}
+
+	void DecodeSrgb16(const uint16_t* rgba, float* outR, float* outG, float* outB, size_t count) {
+		static const std::vector<float> table = []() {
+			std::vector<float> values(65536);
+			for (uint32_t i = 0; i < 65536; ++i)
+				values[i] = SrgbToLinear(i / 65535.0f);
+
+			return values;
+		}();
+
+		for (size_t i = 0; i < count; ++i, rgba += 4) {
+			outR[i] = table[rgba[0]];
+			outG[i] = table[rgba[1]];
+			outB[i] = table[rgba[2]];
+		}
+	}
+
+	// 3 channels in and 3 out, Simd takes 4 pixels at a time and Scalar the rest
+	template<typename Kernel>
+	static void ForEachPixel(const float* in0, const float* in1, const float* in2, float* out0, float* out1, float* out2, size_t count) {
+		size_t i = 0;
+
+#ifdef COLOR_SPACE_SSE2
+		for (; i + 4 <= count; i += 4) {
+			__m128 c0 = _mm_loadu_ps(in0 + i), c1 = _mm_loadu_ps(in1 + i), c2 = _mm_loadu_ps(in2 + i);
+			Kernel::Simd(c0, c1, c2);
+
+			_mm_storeu_ps(out0 + i, c0);
+			_mm_storeu_ps(out1 + i, c1);
+			_mm_storeu_ps(out2 + i, c2);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			glm::vec3 result = Kernel::Scalar({ in0[i], in1[i], in2[i] });
+			out0[i] = result.x;
+			out1[i] = result.y;
+			out2[i] = result.z;
+		}
+	}
+
+	struct LinearToXyzKernel {
+#ifdef COLOR_SPACE_SSE2
+		static void Simd(__m128& c0, __m128& c1, __m128& c2) {
+			static constexpr float matrix[9] = { 0.4124564f, 0.3575761f, 0.1804375f, 0.2126729f, 0.7151522f, 0.0721750f, 0.0193339f, 0.1191920f, 0.9503041f };
+			Transform(matrix, c0, c1, c2);
+		}
+#endif
+
+		static glm::vec3 Scalar(const glm::vec3& rgb) { return LinearToXyz(rgb); }
+	};
+
+	struct XyzToLabKernel {
+#ifdef COLOR_SPACE_SSE2
+		static void Simd(__m128& c0, __m128& c1, __m128& c2) {
+			__m128 fx = LabCurve(_mm_mul_ps(c0, _mm_set1_ps(1.0f / WhiteX)));
+			__m128 fy = LabCurve(c1);
+			__m128 fz = LabCurve(_mm_mul_ps(c2, _mm_set1_ps(1.0f / WhiteZ)));
+
+			c0 = _mm_sub_ps(_mm_mul_ps(fy, _mm_set1_ps(116.0f)), _mm_set1_ps(16.0f));
+			c1 = _mm_mul_ps(_mm_sub_ps(fx, fy), _mm_set1_ps(500.0f));
+			c2 = _mm_mul_ps(_mm_sub_ps(fy, fz), _mm_set1_ps(200.0f));
+		}
+#endif
+
+		static glm::vec3 Scalar(const glm::vec3& xyz) { return XyzToLab(xyz); }
+	};
+
+	struct LabToLchKernel {
+#ifdef COLOR_SPACE_SSE2
+		static void Simd(__m128&, __m128& c1, __m128& c2) {
+			__m128 hue = HueDegrees(c2, c1);
+			c1 = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(c1, c1), _mm_mul_ps(c2, c2)));
+			c2 = hue;
+		}
+#endif
+
+		static glm::vec3 Scalar(const glm::vec3& lab) { return LabToLch(lab); }
+	};
+
+	struct LinearToOklabKernel {
+#ifdef COLOR_SPACE_SSE2
+		static void Simd(__m128& c0, __m128& c1, __m128& c2) {
+			static constexpr float toCone[9] = { 0.4122214708f, 0.5363325363f, 0.0514459929f, 0.2119034982f, 0.6806995451f, 0.1073969566f, 0.0883024619f, 0.2817188376f, 0.6299787005f };
+			static constexpr float toLab[9]	 = { 0.2104542553f, 0.7936177850f, -0.0040720468f, 1.9779984951f, -2.4285922050f, 0.4505937099f, 0.0259040371f, 0.7827717662f, -0.8086757660f };
+
+			Transform(toCone, c0, c1, c2);
+			c0 = Cbrt(c0);
+			c1 = Cbrt(c1);
+			c2 = Cbrt(c2);
+			Transform(toLab, c0, c1, c2);
+		}
+#endif
+
+		static glm::vec3 Scalar(const glm::vec3& rgb) { return LinearToOklab(rgb); }
+	};
+
+	struct SrgbToHsvKernel {
+#ifdef COLOR_SPACE_SSE2
+		static void Simd(__m128& c0, __m128& c1, __m128& c2) {
+			__m128 max	 = _mm_max_ps(_mm_max_ps(c0, c1), c2);
+			__m128 delta = _mm_sub_ps(max, _mm_min_ps(_mm_min_ps(c0, c1), c2));
+
+			c0 = HexagonHue(c0, c1, c2, max, delta);
+			c1 = _mm_and_ps(_mm_div_ps(delta, max), _mm_cmpgt_ps(max, _mm_setzero_ps()));
+			c2 = max;
+		}
+#endif
+
+		static glm::vec3 Scalar(const glm::vec3& rgb) { return RgbToHsv(rgb); }
+	};
+
+	struct SrgbToHslKernel {
+#ifdef COLOR_SPACE_SSE2
+		static void Simd(__m128& c0, __m128& c1, __m128& c2) {
+			__m128 max		 = _mm_max_ps(_mm_max_ps(c0, c1), c2);
+			__m128 min		 = _mm_min_ps(_mm_min_ps(c0, c1), c2);
+			__m128 delta	 = _mm_sub_ps(max, min);
+			__m128 lightness = _mm_mul_ps(_mm_add_ps(max, min), _mm_set1_ps(0.5f));
+
+			__m128 twice  = _mm_sub_ps(_mm_mul_ps(lightness, _mm_set1_ps(2.0f)), _mm_set1_ps(1.0f));
+			__m128 spread = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_andnot_ps(_mm_set1_ps(-0.0f), twice));
+			__m128 valid  = _mm_and_ps(_mm_cmpgt_ps(delta, _mm_setzero_ps()), _mm_cmpgt_ps(spread, _mm_setzero_ps()));
+
+			c0 = HexagonHue(c0, c1, c2, max, delta);
+			c1 = _mm_and_ps(_mm_div_ps(delta, Select(valid, spread, _mm_set1_ps(1.0f))), valid);
+			c2 = lightness;
+		}
+#endif
+
+		static glm::vec3 Scalar(const glm::vec3& rgb) { return RgbToHsl(rgb); }
+	};
+
+	void LinearToXyz(const float* r, const float* g, const float* b, float* outX, float* outY, float* outZ, size_t count) {
+		ForEachPixel<LinearToXyzKernel>(r, g, b, outX, outY, outZ, count);
+	}
+
+	void XyzToLab(const float* x, const float* y, const float* z, float* outL, float* outA, float* outB, size_t count) {
+		ForEachPixel<XyzToLabKernel>(x, y, z, outL, outA, outB, count);
+	}
+
+	void LabToLch(const float* l, const float* a, const float* b, float* outL, float* outC, float* outH, size_t count) {
+		ForEachPixel<LabToLchKernel>(l, a, b, outL, outC, outH, count);
+	}
+
+	void LinearToOklab(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, size_t count) {
+		ForEachPixel<LinearToOklabKernel>(r, g, b, outL, outA, outB, count);
+	}
+
+	void SrgbToHsv(const float* r, const float* g, const float* b, float* outH, float* outS, float* outV, size_t count) {
+		ForEachPixel<SrgbToHsvKernel>(r, g, b, outH, outS, outV, count);
+	}
+
+	void SrgbToHsl(const float* r, const float* g, const float* b, float* outH, float* outS, float* outL, size_t count) {
+		ForEachPixel<SrgbToHslKernel>(r, g, b, outH, outS, outL, count);
+	}
+
+	void SrgbToCmyk(const float* r, const float* g, const float* b, float* outC, float* outM, float* outY, float* outK, size_t count) {
+		size_t i = 0;
+
+#ifdef COLOR_SPACE_SSE2
+		const __m128 one = _mm_set1_ps(1.0f);
+
+		for (; i + 4 <= count; i += 4) {
+			__m128 red = _mm_loadu_ps(r + i), green = _mm_loadu_ps(g + i), blue = _mm_loadu_ps(b + i);
+			__m128 white = _mm_max_ps(_mm_max_ps(red, green), blue);
+			__m128 black = _mm_sub_ps(one, white);
+
+			// 1 - c = r / white, all zero for black
+			__m128 valid = _mm_cmpgt_ps(white, _mm_setzero_ps());
+			__m128 scale = _mm_and_ps(_mm_div_ps(one, Select(valid, white, one)), valid);
+
+			_mm_storeu_ps(outC + i, _mm_and_ps(_mm_sub_ps(one, _mm_mul_ps(red,	 scale)), valid));
+			_mm_storeu_ps(outM + i, _mm_and_ps(_mm_sub_ps(one, _mm_mul_ps(green, scale)), valid));
+			_mm_storeu_ps(outY + i, _mm_and_ps(_mm_sub_ps(one, _mm_mul_ps(blue,	 scale)), valid));
+			_mm_storeu_ps(outK + i, Select(valid, black, one));
+		}
+#endif
+
+		for (; i < count; ++i) {
+			glm::vec4 cmyk = RgbToCmyk({ r[i], g[i], b[i] });
+			outC[i] = cmyk.x;
+			outM[i] = cmyk.y;
+			outY[i] = cmyk.z;
+			outK[i] = cmyk.w;
+		}
+	}
+
+	static bool NeedsLinear(Space space) {
+		return space == Space::LinearRgb || space == Space::Xyz || space == Space::Lab || space == Space::Lch || space == Space::Oklab;
+	}
+
+	// a row of the store to planar rgb, linear or srgb encoded
+	static void LoadRow(const Renderer::PixelStore& pixels, uint32_t row, bool linear, float* r, float* g, float* b) {
+		const uint8_t* pixel = pixels.GetPixel(0, row);
+		uint32_t	   width = pixels.GetWidth();
+
+		switch (pixels.GetFormat()) {
+			case Renderer::PixelFormat::RGBA16: {
+				const uint16_t* channels = reinterpret_cast<const uint16_t*>(pixel);
+				if (linear) {
+					DecodeSrgb16(channels, r, g, b, width);
+					break;
+				}
+
+				for (uint32_t x = 0; x < width; ++x, channels += 4) {
+					r[x] = channels[0] / 65535.0f;
+					g[x] = channels[1] / 65535.0f;
+					b[x] = channels[2] / 65535.0f;
+				}
+
+				break;
+			}
+
+			case Renderer::PixelFormat::RGBA32F: {
+				const float* channels = reinterpret_cast<const float*>(pixel);
+				for (uint32_t x = 0; x < width; ++x, channels += 4) {
+					glm::vec3 rgb = { channels[0], channels[1], channels[2] };
+					if (!linear)
+						rgb = LinearToSrgb(rgb);
+
+					r[x] = rgb.x;
+					g[x] = rgb.y;
+					b[x] = rgb.z;
+				}
+
+				break;
+			}
+
+			default:
+				if (linear)
+					DecodeSrgb8(pixel, r, g, b, width);
+				else
+					UnpackRgba8(pixel, r, g, b, width);
+
+				break;
+		}
+	}
+
+	void ConvertImage(const Renderer::PixelStore& pixels, Space space, Planes& outPlanes) {
+		outPlanes.Width	 = pixels.IsValid() ? pixels.GetWidth()  : 0;
+		outPlanes.Height = pixels.IsValid() ? pixels.GetHeight() : 0;
+
+		size_t count = (size_t)outPlanes.Width * outPlanes.Height;
+		for (uint32_t channel = 0; channel < 4; ++channel)
+			outPlanes.Channels[channel].resize(channel < GetComponentCount(space) ? count : 0);
+
+		if (count == 0)
+			return;
+
+		uint32_t rowsPerChunk = std::max(1u, ChunkPixels / outPlanes.Width);
+
+		ThreadPool::ParallelFor(outPlanes.Height, rowsPerChunk, [&](uint32_t firstRow, uint32_t endRow) {
+			for (uint32_t row = firstRow; row < endRow; ++row) {
+				size_t offset = (size_t)row * outPlanes.Width;
+				float* c0 = outPlanes.Channels[0].data() + offset;
+				float* c1 = outPlanes.Channels[1].data() + offset;
+				float* c2 = outPlanes.Channels[2].data() + offset;
+
+				// loaded straight into the output, each step converts in place
+				LoadRow(pixels, row, NeedsLinear(space), c0, c1, c2);
+
+				switch (space) {
+					case Space::Hsv:   SrgbToHsv(c0, c1, c2, c0, c1, c2, outPlanes.Width); break;
+					case Space::Hsl:   SrgbToHsl(c0, c1, c2, c0, c1, c2, outPlanes.Width); break;
+					case Space::Oklab: LinearToOklab(c0, c1, c2, c0, c1, c2, outPlanes.Width); break;
+					case Space::Cmyk:  SrgbToCmyk(c0, c1, c2, c0, c1, c2, outPlanes.Channels[3].data() + offset, outPlanes.Width); break;
+
+					case Space::Xyz:
+					case Space::Lab:
+					case Space::Lch:
+						LinearToXyz(c0, c1, c2, c0, c1, c2, outPlanes.Width);
+						if (space != Space::Xyz)
+							XyzToLab(c0, c1, c2, c0, c1, c2, outPlanes.Width);
+						if (space == Space::Lch)
+							LabToLch(c0, c1, c2, c0, c1, c2, outPlanes.Width);
+
+						break;
+
+					default:
+						break;
+				}
+			}
+		});
+	}
+
+}
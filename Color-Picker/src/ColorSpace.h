@@ -0,0 +1,97 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+
+#include "glm/glm.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// conversions between the color spaces the ui shows a picked color in, and batch versions of them for whole images
+// rgb is 0..1 and srgb encoded unless it is called linear, xyz, lab and lch use the d65 white of srgb (Y of white is 1,
+// L of lab runs 0..100), hue of hsv, hsl and lch is in degrees 0..360, oklab L runs 0..1
+// the batch kernels work on planar channels with sse2 when available, they agree with the single color functions
+// to float rounding, outputs may be the same arrays as the inputs
+// the lch hue of LabToLch is within 0.0001 degrees of atan2, from rgb the rounding of a and b moves it by up to
+// 0.01 / chroma degrees (greys have no defined hue)
+namespace ColorSpace {
+
+	enum class Space : uint32_t {
+		Srgb,
+		LinearRgb,
+		Hsv,
+		Hsl,
+		Xyz,
+		Lab,
+		Lch,
+		Oklab,
+		Cmyk,
+		Count
+	};
+
+	const char* GetName(Space space);
+
+	// cmyk has four components, the other spaces three
+	uint32_t GetComponentCount(Space space);
+	const char* GetComponentName(Space space, uint32_t component);
+
+	// 8 bit srgb to linear through a table built at compile time
+	float DecodeSrgb8(uint8_t value);
+
+	// the curves are mirrored for negative values, values over 1 (hdr) follow the curve
+	float SrgbToLinear(float value);
+	float LinearToSrgb(float value);
+	glm::vec3 SrgbToLinear(const glm::vec3& rgb);
+	glm::vec3 LinearToSrgb(const glm::vec3& rgb);
+
+	glm::vec3 LinearToXyz(const glm::vec3& rgb);
+	glm::vec3 XyzToLinear(const glm::vec3& xyz);
+	glm::vec3 XyzToLab(const glm::vec3& xyz);
+	glm::vec3 LabToXyz(const glm::vec3& lab);
+	glm::vec3 LabToLch(const glm::vec3& lab);
+	glm::vec3 LchToLab(const glm::vec3& lch);
+	glm::vec3 LinearToOklab(const glm::vec3& rgb);
+	glm::vec3 OklabToLinear(const glm::vec3& lab);
+
+	// on srgb encoded rgb
+	glm::vec3 RgbToHsv(const glm::vec3& rgb);
+	glm::vec3 HsvToRgb(const glm::vec3& hsv);
+	glm::vec3 RgbToHsl(const glm::vec3& rgb);
+	glm::vec3 HslToRgb(const glm::vec3& hsl);
+	glm::vec4 RgbToCmyk(const glm::vec3& rgb);
+	glm::vec3 CmykToRgb(const glm::vec4& cmyk);
+
+	// srgb to any space and back, the fourth component is only used by cmyk
+	glm::vec4 FromSrgb(const glm::vec3& srgb, Space space);
+	glm::vec3 ToSrgb(const glm::vec4& color, Space space);
+
+	// batch kernels, count pixels of interleaved rgba8 to planar rgb (alpha is dropped)
+	void DecodeSrgb8(const uint8_t* rgba, float* outR, float* outG, float* outB, size_t count);		// to linear
+	void UnpackRgba8(const uint8_t* rgba, float* outR, float* outG, float* outB, size_t count);		// to encoded 0..1
+
+	// the same for rgba16 to linear, through a table of every 16 bit value built on first use (256 KB)
+	void DecodeSrgb16(const uint16_t* rgba, float* outR, float* outG, float* outB, size_t count);
+
+	// batch kernels over planar channels, the names say what goes in and what comes out
+	void LinearToXyz(const float* r, const float* g, const float* b, float* outX, float* outY, float* outZ, size_t count);
+	void XyzToLab(const float* x, const float* y, const float* z, float* outL, float* outA, float* outB, size_t count);
+	void LabToLch(const float* l, const float* a, const float* b, float* outL, float* outC, float* outH, size_t count);
+	void LinearToOklab(const float* r, const float* g, const float* b, float* outL, float* outA, float* outB, size_t count);
+	void SrgbToHsv(const float* r, const float* g, const float* b, float* outH, float* outS, float* outV, size_t count);
+	void SrgbToHsl(const float* r, const float* g, const float* b, float* outH, float* outS, float* outL, size_t count);
+	void SrgbToCmyk(const float* r, const float* g, const float* b, float* outC, float* outM, float* outY, float* outK, size_t count);
+
+	// a whole image in one space, one plane per component with the rows top row first like the pixel store
+	struct Planes {
+		uint32_t Width	= 0;
+		uint32_t Height = 0;
+		std::vector<float> Channels[4];
+	};
+
+	// any thread, rows are split over the thread pool, rgba8 and 16 bit pixels are srgb encoded, float ones linear
+	void ConvertImage(const Renderer::PixelStore& pixels, Space space, Planes& outPlanes);
+
+}
@@ -0,0 +1,357 @@
+
+
+#include "DiskCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace DiskCache {
+
+	static constexpr char	  FileMagic[8] = { 'C', 'P', 'P', 'I', 'X', 'E', 'L', 'S' };
+	static constexpr uint32_t FileVersion  = 1;
+
+	// rows start on a page boundary, the mapped pixels are as aligned as a fresh allocation
+	static constexpr uint64_t PixelAlignment = 4096;
+
+	// about 4 megapixels of rgba8, smaller images decode in a few tens of milliseconds anyway
+	static constexpr size_t MinStoredBytes = 16 * 1024 * 1024;
+
+	// written in native byte order, the cache never leaves the machine that wrote it
+	struct FileHeader {
+		char	 Magic[8];
+		uint32_t Version;
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t Format;			// Renderer::PixelFormat
+		uint32_t Channels;			// always 4, rgba
+		uint32_t PathLength;		// bytes of the source path following the header
+		uint64_t RowStride;
+		uint64_t PixelOffset;
+		uint64_t SourceSize;
+		int64_t	 SourceWriteTime;
+		uint64_t PathHash;			// also the name of the entry's file
+	};
+
+	// what a lookup needs to know about an entry without opening it
+	struct IndexEntry {
+		uint64_t SourceSize		 = 0;
+		int64_t	 SourceWriteTime = 0;
+		uint64_t Bytes			 = 0;
+		uint64_t LastUse		 = 0;
+	};
+
+	// everything below is guarded by cacheMutex, decodes on the worker threads look entries up and store them
+	static std::mutex cacheMutex;
+	static std::filesystem::path cacheDirectory;	// empty while the cache is off
+	static std::unordered_map<uint64_t, IndexEntry> index;
+
+	static uint64_t budget	   = 4ull * 1024 * 1024 * 1024;
+	static uint64_t useCounter = 0;
+	static uint64_t tempCounter = 0;
+	static Stats	stats;
+
+	// the same file opened through a relative path finds the same entry
+	static std::string GetSourceKey(const std::string& filePath) {
+		std::error_code error;
+		std::filesystem::path absolute = std::filesystem::absolute(filePath, error);
+		return error ? filePath : absolute.lexically_normal().string();
+	}
+
+	// 64 bit fnv-1a
+	static uint64_t HashPath(const std::string& path) {
+		uint64_t hash = 14695981039346656037ull;
+		for (char c : path) {
+			hash ^= (uint8_t)c;
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	static std::filesystem::path GetEntryPath(uint64_t pathHash) {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.pixels", (unsigned long long)pathHash);
+		return cacheDirectory / name;
+	}
+
+	static bool IsValidFormat(uint32_t format) {
+		return format <= (uint32_t)Renderer::PixelFormat::RGBA32F;
+	}
+
+	// caller holds cacheMutex, a file that is still mapped somewhere (windows) stays behind until the next Init
+	static void RemoveEntry(std::unordered_map<uint64_t, IndexEntry>::iterator it) {
+		std::error_code error;
+		std::filesystem::remove(GetEntryPath(it->first), error);
+
+		stats.Bytes -= it->second.Bytes;
+		index.erase(it);
+		stats.Entries = (uint32_t)index.size();
+	}
+
+	// caller holds cacheMutex, the cache holds a few hundred large images at most so a scan for the oldest is enough
+	static void EvictOverBudget() {
+		while (!index.empty() && stats.Bytes > budget) {
+			auto oldest = std::min_element(index.begin(), index.end(), [](const auto& a, const auto& b) { return a.second.LastUse < b.second.LastUse; });
+			RemoveEntry(oldest);
+			++stats.Evictions;
+		}
+	}
+
+	std::string GetDefaultDirectory() {
+#ifdef PLATFORM_WINDOWS
+		const char* localAppData = std::getenv("LOCALAPPDATA");
+		if (localAppData != nullptr && *localAppData != '\0')
+			return (std::filesystem::path(localAppData) / "Color-Picker" / "Cache").string();
+#else
+		const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+		if (cacheHome != nullptr && *cacheHome != '\0')
+			return (std::filesystem::path(cacheHome) / "Color-Picker").string();
+
+		const char* home = std::getenv("HOME");
+		if (home != nullptr && *home != '\0')
+			return (std::filesystem::path(home) / ".cache" / "Color-Picker").string();
+#endif
+
+		return "Cache";
+	}
+
+	void Init(const std::string& directory) {
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		if (error) {
+			std::cout << "Could not create the disk cache in " << directory;
+			return;
+		}
+
+		// entries are ordered by their write time, a hit touches its file so the order survives restarts
+		struct ScannedEntry {
+			uint64_t PathHash;
+			IndexEntry Entry;
+			std::filesystem::file_time_type WriteTime;
+		};
+		std::vector<ScannedEntry> scanned;
+
+		for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+			if (!file.is_regular_file(error))
+				continue;
+
+			const std::filesystem::path& path = file.path();
+
+			// left behind by a store that did not finish
+			if (path.extension() == ".tmp") {
+				std::filesystem::remove(path, error);
+				continue;
+			}
+
+			if (path.extension() != ".pixels")
+				continue;
+
+			FileHeader header;
+			std::ifstream stream(path, std::ios::binary);
+			bool valid = stream.read(reinterpret_cast<char*>(&header), sizeof(header)) && memcmp(header.Magic, FileMagic, sizeof(FileMagic)) == 0 && header.Version == FileVersion;
+			stream.close();
+
+			if (!valid) {
+				std::filesystem::remove(path, error);
+				continue;
+			}
+
+			ScannedEntry entry;
+			entry.PathHash				  = header.PathHash;
+			entry.Entry.SourceSize		  = header.SourceSize;
+			entry.Entry.SourceWriteTime	  = header.SourceWriteTime;
+			entry.Entry.Bytes			  = file.file_size(error);
+			entry.WriteTime				  = file.last_write_time(error);
+			scanned.push_back(entry);
+		}
+
+		std::sort(scanned.begin(), scanned.end(), [](const ScannedEntry& a, const ScannedEntry& b) { return a.WriteTime < b.WriteTime; });
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		cacheDirectory = directory;
+		index.clear();
+		stats = {};
+
+		for (ScannedEntry& entry : scanned) {
+			entry.Entry.LastUse = ++useCounter;
+			stats.Bytes += entry.Entry.Bytes;
+			index[entry.PathHash] = entry.Entry;
+		}
+
+		stats.Entries = (uint32_t)index.size();
+		EvictOverBudget();
+	}
+
+	void SetBudget(uint64_t bytes) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		budget = bytes;
+		EvictOverBudget();
+	}
+
+	uint64_t GetBudget() {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return budget;
+	}
+
+	bool Open(const std::string& filePath, uint64_t fileSize, int64_t writeTime, Entry& outEntry) {
+		std::string sourceKey = GetSourceKey(filePath);
+		uint64_t	pathHash  = HashPath(sourceKey);
+		std::filesystem::path entryPath;
+
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			if (cacheDirectory.empty())
+				return false;
+
+			auto it = index.find(pathHash);
+			if (it == index.end()) {
+				++stats.Misses;
+				return false;
+			}
+
+			// the file changed since the entry was written
+			if (it->second.SourceSize != fileSize || it->second.SourceWriteTime != writeTime) {
+				RemoveEntry(it);
+				++stats.Misses;
+				return false;
+			}
+
+			it->second.LastUse = ++useCounter;
+			entryPath = GetEntryPath(pathHash);
+		}
+
+		ImageLoader::MappedFile file(entryPath.string());
+		const FileHeader* header = file.GetSize() >= sizeof(FileHeader) ? reinterpret_cast<const FileHeader*>(file.GetData()) : nullptr;
+
+		// the header is checked in full here, the index only knew the source it was written for
+		bool valid = header != nullptr && memcmp(header->Magic, FileMagic, sizeof(FileMagic)) == 0 && header->Version == FileVersion &&
+			header->PathHash == pathHash && header->SourceSize == fileSize && header->SourceWriteTime == writeTime &&
+			IsValidFormat(header->Format) && header->Channels == 4 &&
+			header->RowStride == static_cast<uint64_t>(header->Width) * Renderer::GetBytesPerPixel((Renderer::PixelFormat)header->Format) &&
+			sizeof(FileHeader) + header->PathLength <= header->PixelOffset &&
+			header->PixelOffset + header->RowStride * header->Height <= file.GetSize() &&
+			sourceKey.compare(0, std::string::npos, reinterpret_cast<const char*>(file.GetData() + sizeof(FileHeader)), header->PathLength) == 0;
+
+		if (!valid) {
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			auto it = index.find(pathHash);
+			if (it != index.end())
+				RemoveEntry(it);
+
+			++stats.Misses;
+			return false;
+		}
+
+		outEntry.Width	   = header->Width;
+		outEntry.Height	   = header->Height;
+		outEntry.Format	   = (Renderer::PixelFormat)header->Format;
+		outEntry.RowStride = header->RowStride;
+		outEntry.Pixels	   = file.GetData() + header->PixelOffset;
+		outEntry.File	   = std::move(file);
+
+		// the write time of the entry is its last use for the next Init
+		std::error_code error;
+		std::filesystem::last_write_time(entryPath, std::filesystem::file_time_type::clock::now(), error);
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		++stats.Hits;
+		return true;
+	}
+
+	bool WouldStore(uint64_t pixelBytes) {
+		if (pixelBytes < MinStoredBytes)
+			return false;
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return !cacheDirectory.empty() && pixelBytes <= budget;
+	}
+
+	void Store(const std::string& filePath, uint64_t fileSize, int64_t writeTime, const Renderer::PixelStore& pixels) {
+		if (!pixels.IsValid() || pixels.GetSizeInBytes() < MinStoredBytes)
+			return;
+
+		std::string sourceKey = GetSourceKey(filePath);
+
+		FileHeader header = {};
+		memcpy(header.Magic, FileMagic, sizeof(FileMagic));
+		header.Version		   = FileVersion;
+		header.Width		   = pixels.GetWidth();
+		header.Height		   = pixels.GetHeight();
+		header.Format		   = (uint32_t)pixels.GetFormat();
+		header.Channels		   = 4;
+		header.PathLength	   = (uint32_t)sourceKey.size();
+		header.RowStride	   = pixels.GetRowStride();
+		header.PixelOffset	   = (sizeof(FileHeader) + sourceKey.size() + PixelAlignment - 1) / PixelAlignment * PixelAlignment;
+		header.SourceSize	   = fileSize;
+		header.SourceWriteTime = writeTime;
+		header.PathHash		   = HashPath(sourceKey);
+
+		uint64_t bytes = header.PixelOffset + pixels.GetSizeInBytes();
+
+		std::filesystem::path entryPath, tempPath;
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			if (cacheDirectory.empty() || bytes > budget)
+				return;
+
+			entryPath = GetEntryPath(header.PathHash);
+			tempPath  = entryPath;
+			tempPath += "." + std::to_string(++tempCounter) + ".tmp";
+		}
+
+		// written under a temporary name and renamed, a reader never maps a half written entry
+		std::vector<char> padding(header.PixelOffset - sizeof(FileHeader) - sourceKey.size(), 0);
+		std::ofstream stream(tempPath, std::ios::binary);
+		stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		stream.write(sourceKey.data(), sourceKey.size());
+		stream.write(padding.data(), padding.size());
+		stream.write(reinterpret_cast<const char*>(pixels.GetData()), pixels.GetSizeInBytes());
+		stream.close();
+
+		std::error_code error;
+		if (stream)
+			std::filesystem::rename(tempPath, entryPath, error);
+
+		if (!stream || error) {
+			std::cout << "Could not write the disk cache entry for " << filePath;
+			std::filesystem::remove(tempPath, error);
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		IndexEntry& entry = index[header.PathHash];
+		stats.Bytes -= entry.Bytes;
+
+		entry.SourceSize	  = fileSize;
+		entry.SourceWriteTime = writeTime;
+		entry.Bytes			  = bytes;
+		entry.LastUse		  = ++useCounter;
+
+		stats.Bytes  += bytes;
+		stats.Entries = (uint32_t)index.size();
+		++stats.Writes;
+
+		EvictOverBudget();
+	}
+
+	void Clear() {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		while (!index.empty())
+			RemoveEntry(index.begin());
+	}
+
+	Stats GetStats() {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return stats;
+	}
+
+}
@@ -0,0 +1,62 @@
+
+
+#pragma once
+
+#include "MappedFile.h"
+#include "PixelStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// decoded pixels of large images kept on disk between runs, reopening a file maps its pixels instead of decoding it again
+// every entry is one raw file, a header (size, format, row stride and the source it came from) followed by page aligned rows
+// the directory is scanned once at Init, lookups after that only touch an in memory index and open the entry on a hit
+namespace DiskCache {
+
+	struct Stats {
+		uint64_t Hits	   = 0;
+		uint64_t Misses	   = 0;
+		uint64_t Writes	   = 0;
+		uint64_t Evictions = 0;
+		uint32_t Entries   = 0;
+		uint64_t Bytes	   = 0;
+	};
+
+	// pixels of a cache hit, rows are top row first like a PixelStore and stay mapped as long as the entry lives
+	struct Entry {
+		ImageLoader::MappedFile File;
+		uint32_t Width	= 0;
+		uint32_t Height = 0;
+		Renderer::PixelFormat Format = Renderer::PixelFormat::RGBA8;
+		size_t		   RowStride = 0;
+		const uint8_t* Pixels	 = nullptr;
+	};
+
+	// per user cache directory of the platform (XDG_CACHE_HOME or LOCALAPPDATA)
+	std::string GetDefaultDirectory();
+
+	// creates the directory if needed and indexes the entries in it, the cache stays off if this fails
+	void Init(const std::string& directory);
+
+	// least recently used entries are removed until the cache fits
+	void SetBudget(uint64_t bytes);
+	uint64_t GetBudget();
+
+	// any thread, maps the pixels stored for this version of the file (size and write time as in ImageCache::Key)
+	// false on a miss, an entry of an older version is removed
+	bool Open(const std::string& filePath, uint64_t fileSize, int64_t writeTime, Entry& outEntry);
+
+	// any thread, whether Store would write pixels of this size, the loader only keeps a decode around for the cache if so
+	bool WouldStore(uint64_t pixelBytes);
+
+	// any thread, writes the pixels for this version of the file, replacing the entry of an older one
+	// small images decode about as fast as they are read back and are not stored
+	void Store(const std::string& filePath, uint64_t fileSize, int64_t writeTime, const Renderer::PixelStore& pixels);
+
+	// removes every entry from the disk
+	void Clear();
+
+	Stats GetStats();
+
+}
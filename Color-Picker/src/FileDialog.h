@@ -33,4 +33,15 @@ std::string OpenFileDialog(const char* filters, GLFWwindow* window) {
 
 }
 
+#else
+
+#include <string>
+
+struct GLFWwindow;
+
+// no native dialog on other platforms yet, the path has to be typed in
+inline std::string OpenFileDialog(const char*, GLFWwindow*) {
+	return std::string();
+}
+
 #endif // PLATFORM_WINDOWS
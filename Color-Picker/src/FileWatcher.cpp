@@ -0,0 +1,329 @@
+
+
+#include "FileWatcher.h"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#if defined(PLATFORM_LINUX)
+	#include <sys/inotify.h>
+	#include <sys/eventfd.h>
+	#include <poll.h>
+	#include <unistd.h>
+	#include <cerrno>
+#elif defined(PLATFORM_WINDOWS)
+	#include <windows.h>
+#else
+	#include <chrono>
+	#include <condition_variable>
+#endif
+
+namespace FileWatcher {
+
+	// state read by the render thread
+	static std::atomic<bool> fileExists	 = false;
+	static std::atomic<bool> fileChanged = false;
+
+	// what is being watched, guarded by watchMutex
+	static std::mutex			 watchMutex;
+	static std::filesystem::path watchedDirectory;
+	static std::filesystem::path watchedName;
+
+	static std::thread		 watchThread;
+	static std::atomic<bool> stopping = false;
+
+	// the path typed in the ui may have no directory part
+	static std::filesystem::path GetDirectory(const std::filesystem::path& filePath) {
+		std::filesystem::path directory = filePath.parent_path();
+		return directory.empty() ? std::filesystem::path(".") : directory;
+	}
+
+	static void OnFileWritten() {
+		fileExists.store(true);
+		fileChanged.store(true);
+	}
+
+	static void OnFileRemoved() {
+		fileExists.store(false);
+	}
+
+#if defined(PLATFORM_LINUX)
+
+	static int inotifyFd	   = -1;
+	static int wakeFd		   = -1;	// wakes the thread up for shutdown
+	static int watchDescriptor = -1;
+
+	static void WatchLoop() {
+		alignas(inotify_event) char buffer[4096];
+		pollfd fds[2] = { { inotifyFd, POLLIN, 0 }, { wakeFd, POLLIN, 0 } };
+
+		while (!stopping.load()) {
+			if (poll(fds, 2, -1) < 0) {
+				if (errno == EINTR)
+					continue;
+
+				break;
+			}
+
+			if (fds[1].revents & POLLIN)
+				break;
+
+			ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+			if (length <= 0)
+				continue;
+
+			std::lock_guard<std::mutex> lock(watchMutex);
+
+			for (char* ptr = buffer; ptr < buffer + length;) {
+				const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+
+				if (event->wd == watchDescriptor && event->len > 0 && watchedName == event->name) {
+					if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+						OnFileRemoved();
+					else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+						OnFileWritten();
+				}
+
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+	}
+
+	void Init() {
+		stopping.store(false);
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		wakeFd	  = eventfd(0, EFD_CLOEXEC);
+		watchThread = std::thread(WatchLoop);
+	}
+
+	void Shutdown() {
+		stopping.store(true);
+
+		uint64_t wake = 1;
+		if (write(wakeFd, &wake, sizeof(wake)) < 0) {}
+
+		watchThread.join();
+		close(inotifyFd);
+		close(wakeFd);
+		inotifyFd = wakeFd = watchDescriptor = -1;
+	}
+
+	// expects watchMutex to be held
+	static void SetWatch(const std::filesystem::path& directory) {
+		if (watchDescriptor >= 0)
+			inotify_rm_watch(inotifyFd, watchDescriptor);
+
+		// watching the directory instead of the file also catches editors that save by replacing the file
+		watchDescriptor = directory.empty() ? -1 : inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE);
+	}
+
+#elif defined(PLATFORM_WINDOWS)
+
+	static HANDLE wakeEvent = nullptr;
+	static std::atomic<uint32_t> watchGeneration = 0;
+
+	static void ProcessNotifications(const BYTE* buffer, const std::wstring& name) {
+		const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer);
+
+		while (true) {
+			int length = info->FileNameLength / sizeof(WCHAR);
+
+			if (CompareStringOrdinal(info->FileName, length, name.c_str(), (int)name.size(), TRUE) == CSTR_EQUAL) {
+				if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME)
+					OnFileRemoved();
+				else
+					OnFileWritten();
+			}
+
+			if (info->NextEntryOffset == 0)
+				break;
+
+			info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(reinterpret_cast<const BYTE*>(info) + info->NextEntryOffset);
+		}
+	}
+
+	static void WatchLoop() {
+		const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+
+		HANDLE		 directory		= INVALID_HANDLE_VALUE;
+		std::wstring name;
+		uint32_t	 seenGeneration = 0;
+		bool		 reading		= false;
+
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+		alignas(DWORD) BYTE buffer[4096];
+
+		while (!stopping.load()) {
+			// switching to the newly watched directory
+			if (seenGeneration != watchGeneration.load()) {
+				if (reading) {
+					DWORD bytes = 0;
+					CancelIo(directory);
+					GetOverlappedResult(directory, &overlapped, &bytes, TRUE);
+					reading = false;
+				}
+
+				if (directory != INVALID_HANDLE_VALUE)
+					CloseHandle(directory);
+
+				std::filesystem::path directoryPath;
+				{
+					std::lock_guard<std::mutex> lock(watchMutex);
+					directoryPath  = watchedDirectory;
+					name		   = watchedName.wstring();
+					seenGeneration = watchGeneration.load();
+				}
+
+				directory = directoryPath.empty() ? INVALID_HANDLE_VALUE : CreateFileW(
+					directoryPath.c_str(), FILE_LIST_DIRECTORY,
+					FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+					OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr
+				);
+			}
+
+			if (directory != INVALID_HANDLE_VALUE && !reading) {
+				ResetEvent(overlapped.hEvent);
+				reading = ReadDirectoryChangesW(directory, buffer, sizeof(buffer), FALSE, filter, nullptr, &overlapped, nullptr);
+			}
+
+			HANDLE events[2] = { wakeEvent, overlapped.hEvent };
+			DWORD result = WaitForMultipleObjects(reading ? 2 : 1, events, FALSE, INFINITE);
+
+			if (result == WAIT_OBJECT_0 + 1) {
+				DWORD bytes = 0;
+				reading = false;
+
+				if (GetOverlappedResult(directory, &overlapped, &bytes, FALSE) && bytes > 0)
+					ProcessNotifications(buffer, name);
+			}
+		}
+
+		if (reading) {
+			DWORD bytes = 0;
+			CancelIo(directory);
+			GetOverlappedResult(directory, &overlapped, &bytes, TRUE);
+		}
+
+		if (directory != INVALID_HANDLE_VALUE)
+			CloseHandle(directory);
+
+		CloseHandle(overlapped.hEvent);
+	}
+
+	void Init() {
+		stopping.store(false);
+		wakeEvent	= CreateEventW(nullptr, FALSE, FALSE, nullptr);
+		watchThread = std::thread(WatchLoop);
+	}
+
+	void Shutdown() {
+		stopping.store(true);
+		SetEvent(wakeEvent);
+
+		watchThread.join();
+		CloseHandle(wakeEvent);
+		wakeEvent = nullptr;
+	}
+
+	// expects watchMutex to be held, the thread opens the directory itself
+	static void SetWatch(const std::filesystem::path&) {
+		++watchGeneration;
+		SetEvent(wakeEvent);
+	}
+
+#else
+
+	// no file system events on this platform, falling back to checking the file twice a second
+	static std::condition_variable stopCondition;
+
+	static void WatchLoop() {
+		std::filesystem::file_time_type lastWriteTime;
+		std::filesystem::path lastPath;
+
+		std::unique_lock<std::mutex> lock(watchMutex);
+
+		while (!stopCondition.wait_for(lock, std::chrono::milliseconds(500), [] { return stopping.load(); })) {
+			if (watchedName.empty())
+				continue;
+
+			std::filesystem::path filePath = watchedDirectory / watchedName;
+
+			std::error_code error;
+			auto writeTime = std::filesystem::last_write_time(filePath, error);
+
+			if (error) {
+				OnFileRemoved();
+			}
+			else if (filePath == lastPath && writeTime != lastWriteTime) {
+				OnFileWritten();
+			}
+
+			lastPath	  = filePath;
+			lastWriteTime = writeTime;
+		}
+	}
+
+	void Init() {
+		stopping.store(false);
+		watchThread = std::thread(WatchLoop);
+	}
+
+	void Shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(watchMutex);
+			stopping.store(true);
+		}
+
+		stopCondition.notify_all();
+		watchThread.join();
+	}
+
+	static void SetWatch(const std::filesystem::path&) {}
+
+#endif
+
+	bool Watch(const std::string& filePath) {
+		std::filesystem::path path(filePath);
+
+		std::error_code error;
+		bool exists = std::filesystem::is_regular_file(path, error);
+
+		std::lock_guard<std::mutex> lock(watchMutex);
+
+		watchedDirectory = GetDirectory(path);
+		watchedName		 = path.filename();
+		SetWatch(watchedDirectory);
+
+		fileExists.store(exists);
+		fileChanged.store(false);
+		return exists;
+	}
+
+	void Unwatch() {
+		std::lock_guard<std::mutex> lock(watchMutex);
+
+		watchedDirectory.clear();
+		watchedName.clear();
+		SetWatch(watchedDirectory);
+
+		fileExists.store(false);
+		fileChanged.store(false);
+	}
+
+	bool Exists() {
+		return fileExists.load(std::memory_order_relaxed);
+	}
+
+	bool ConsumeChanged() {
+		// cheap relaxed check first, the exchange only runs when something happened
+		if (!fileChanged.load(std::memory_order_relaxed))
+			return false;
+
+		return fileChanged.exchange(false);
+	}
+
+}
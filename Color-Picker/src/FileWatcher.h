@@ -0,0 +1,27 @@
+
+
+#pragma once
+
+#include <string>
+
+// cached state of the opened image file, kept up to date by a background thread that waits
+// for file system events (inotify on linux, ReadDirectoryChangesW on windows)
+// so the render thread never has to stat the file itself
+namespace FileWatcher {
+
+	// starts the thread waiting for file system events
+	void Init();
+	void Shutdown();
+
+	// watches a single file (replacing the previous one), this is the only call doing syscalls
+	// on the calling thread, returns whether the file exists
+	bool Watch(const std::string& filePath);
+	void Unwatch();
+
+	// cached existence of the watched file
+	bool Exists();
+
+	// true once after the watched file was written, created or replaced
+	bool ConsumeChanged();
+
+}
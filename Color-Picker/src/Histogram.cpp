@@ -0,0 +1,201 @@
+
+
+#include "glad/glad.h"
+
+#include "Histogram.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace Histogram {
+
+	// fewest pixels worth a band of their own on the cpu
+	static constexpr uint64_t BandPixels = 1 << 16;
+
+	// pixels per side a compute work group counts, 16x16 invocations of 4x4 pixels each (see Histogram.glsl)
+	static constexpr uint32_t GroupTile = 64;
+
+	static uint32_t program	  = 0;
+	static uint32_t binBuffer = 0;
+
+	// bins of a band, pixels alternate between two copies so runs of equal values do not wait on the same counters
+	struct BandBins {
+		uint32_t Values[2][ChannelCount][Bins];
+	};
+
+	static uint32_t ToLevel(uint8_t value) {
+		return value;
+	}
+
+	// rounded like the gpu's unorm16 * 255 + 0.5
+	static uint32_t ToLevel(uint16_t value) {
+		return ((uint32_t)value * 255 + 32767) / 65535;
+	}
+
+	static uint32_t ToLevel(float value) {
+		// also sends nan to 0
+		return value > 0.0f ? (uint32_t)(std::min(value, 1.0f) * 255.0f + 0.5f) : 0;
+	}
+
+	template<typename T>
+	static void CountRow(const T* pixel, uint32_t count, BandBins& bins) {
+		for (uint32_t i = 0; i < count; ++i, pixel += 4) {
+			uint32_t red = ToLevel(pixel[0]), green = ToLevel(pixel[1]), blue = ToLevel(pixel[2]);
+			uint32_t (&values)[ChannelCount][Bins] = bins.Values[i & 1];
+
+			++values[Red][red];
+			++values[Green][green];
+			++values[Blue][blue];
+			++values[Luma][(red * 54 + green * 183 + blue * 19) >> 8];
+		}
+	}
+
+	static bool ClipRect(uint32_t width, uint32_t height, PixelKernels::PixelRect& rect) {
+		if (rect.X >= width || rect.Y >= height)
+			return false;
+
+		rect.Width	= std::min(rect.Width, width - rect.X);
+		rect.Height = std::min(rect.Height, height - rect.Y);
+		return rect.Width != 0 && rect.Height != 0;
+	}
+
+	static uint64_t Area(const PixelKernels::PixelRect& rect) {
+		return (uint64_t)rect.Width * rect.Height;
+	}
+
+	// adds the pixels of a clipped rect to counts, or takes them away
+	static void Accumulate(const Renderer::PixelStore& pixels, const PixelKernels::PixelRect& rect, Counts& counts, bool subtract) {
+		uint32_t bandCount = (uint32_t)std::min<uint64_t>({ rect.Height, ThreadPool::GetThreadCount() + 1, Area(rect) / BandPixels + 1 });
+		std::vector<Counts> bandCounts(bandCount);
+
+		// the store holds the top row first
+		uint32_t firstRow = pixels.GetHeight() - rect.Y - rect.Height;
+
+		ThreadPool::ParallelFor(bandCount, 1, [&](uint32_t firstBand, uint32_t endBand) {
+			for (uint32_t band = firstBand; band < endBand; ++band) {
+				BandBins bins = {};
+				uint32_t endRow = firstRow + (uint32_t)((uint64_t)(band + 1) * rect.Height / bandCount);
+
+				for (uint32_t row = firstRow + (uint32_t)((uint64_t)band * rect.Height / bandCount); row < endRow; ++row) {
+					const uint8_t* pixel = pixels.GetPixel(rect.X, row);
+
+					switch (pixels.GetFormat()) {
+						case Renderer::PixelFormat::RGBA16:  CountRow(reinterpret_cast<const uint16_t*>(pixel), rect.Width, bins); break;
+						case Renderer::PixelFormat::RGBA32F: CountRow(reinterpret_cast<const float*>(pixel), rect.Width, bins);	   break;
+						default:							 CountRow(pixel, rect.Width, bins);									   break;
+					}
+				}
+
+				for (uint32_t channel = 0; channel < ChannelCount; ++channel) {
+					for (uint32_t bin = 0; bin < Bins; ++bin)
+						bandCounts[band].Values[channel][bin] = bins.Values[0][channel][bin] + bins.Values[1][channel][bin];
+				}
+			}
+		});
+
+		// merge, unsigned wrap around makes taking away exact
+		for (const Counts& band : bandCounts) {
+			for (uint32_t channel = 0; channel < ChannelCount; ++channel) {
+				for (uint32_t bin = 0; bin < Bins; ++bin)
+					counts.Values[channel][bin] += subtract ? 0u - band.Values[channel][bin] : band.Values[channel][bin];
+			}
+		}
+
+		counts.PixelCount += subtract ? 0 - Area(rect) : Area(rect);
+	}
+
+	// adds or takes away the pixels of outer that are not in inner (inner lies inside outer), up to four rects
+	static void AccumulateOutside(const Renderer::PixelStore& pixels, const PixelKernels::PixelRect& outer, const PixelKernels::PixelRect& inner, Counts& counts, bool subtract) {
+		PixelKernels::PixelRect parts[4] = {
+			{ outer.X, outer.Y, outer.Width, inner.Y - outer.Y },											// below
+			{ outer.X, inner.Y + inner.Height, outer.Width, outer.Y + outer.Height - inner.Y - inner.Height },	// above
+			{ outer.X, inner.Y, inner.X - outer.X, inner.Height },											// left
+			{ inner.X + inner.Width, inner.Y, outer.X + outer.Width - inner.X - inner.Width, inner.Height }	// right
+		};
+
+		for (const PixelKernels::PixelRect& part : parts) {
+			if (Area(part) != 0)
+				Accumulate(pixels, part, counts, subtract);
+		}
+	}
+
+	Counts ComputeCpu(const Renderer::PixelStore& pixels, const PixelKernels::PixelRect& rect) {
+		Counts counts;
+		PixelKernels::PixelRect clipped = rect;
+
+		if (pixels.IsValid() && ClipRect(pixels.GetWidth(), pixels.GetHeight(), clipped))
+			Accumulate(pixels, clipped, counts, false);
+
+		return counts;
+	}
+
+	void MoveCpu(const Renderer::PixelStore& pixels, const PixelKernels::PixelRect& fromRect, const PixelKernels::PixelRect& toRect, Counts& counts) {
+		PixelKernels::PixelRect from = fromRect, to = toRect;
+		bool hasFrom = pixels.IsValid() && ClipRect(pixels.GetWidth(), pixels.GetHeight(), from);
+		bool hasTo	 = pixels.IsValid() && ClipRect(pixels.GetWidth(), pixels.GetHeight(), to);
+
+		uint32_t overlapX = std::max(from.X, to.X), overlapY = std::max(from.Y, to.Y);
+		uint32_t overlapEndX = std::min(from.X + from.Width, to.X + to.Width), overlapEndY = std::min(from.Y + from.Height, to.Y + to.Height);
+
+		if (!hasFrom || !hasTo || overlapX >= overlapEndX || overlapY >= overlapEndY) {
+			counts = ComputeCpu(pixels, toRect);
+			return;
+		}
+
+		PixelKernels::PixelRect overlap = { overlapX, overlapY, overlapEndX - overlapX, overlapEndY - overlapY };
+		if (Area(from) - Area(overlap) + Area(to) - Area(overlap) >= Area(to)) {
+			counts = ComputeCpu(pixels, toRect);
+			return;
+		}
+
+		AccumulateOutside(pixels, from, overlap, counts, true);
+		AccumulateOutside(pixels, to, overlap, counts, false);
+	}
+
+	void InitGpu() {
+		program = Renderer::LoadShader("assets/Shaders/Histogram.glsl");
+		if (program == 0)
+			return;
+
+		glCreateBuffers(1, &binBuffer);
+		glNamedBufferStorage(binBuffer, sizeof(uint32_t) * Bins * ChannelCount, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	void ShutdownGpu() {
+		glDeleteProgram(program);
+		glDeleteBuffers(1, &binBuffer);
+		program = binBuffer = 0;
+	}
+
+	bool IsGpuAvailable() {
+		return program != 0;
+	}
+
+	bool ComputeGpu(uint32_t texture, uint32_t textureWidth, uint32_t textureHeight, const PixelKernels::PixelRect& rect, Counts& outCounts) {
+		outCounts = {};
+
+		PixelKernels::PixelRect clipped = rect;
+		if (program == 0 || !ClipRect(textureWidth, textureHeight, clipped))
+			return program != 0;
+
+		glClearNamedBufferData(binBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+		glUseProgram(program);
+		glUniform4i(0, (GLint)clipped.X, (GLint)(textureHeight - clipped.Y - clipped.Height), (GLint)clipped.Width, (GLint)clipped.Height);
+		glBindTextureUnit(0, texture);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, binBuffer);
+
+		glDispatchCompute((clipped.Width + GroupTile - 1) / GroupTile, (clipped.Height + GroupTile - 1) / GroupTile, 1);
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		// waits for the dispatch
+		glGetNamedBufferSubData(binBuffer, 0, sizeof(outCounts.Values), outCounts.Values.data());
+		glUseProgram(0);
+
+		outCounts.PixelCount = Area(clipped);
+		return true;
+	}
+
+}
@@ -0,0 +1,48 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+#include "PixelKernels.h"
+
+#include <array>
+#include <cstdint>
+
+// 256 bin histograms of red, green, blue and luma over a rect of the image, values are rounded to 8 bits
+// (16 bit and float pixels clamped to 0..1 first) and luma uses the rec 709 weights on the stored values
+// the cpu backend splits the rows over the thread pool with private bins per band, merged at the end
+// the gpu backend is a gl 4.5 compute shader over the image texture, counting into shared memory per work group
+// and adding those to the global bins with atomics, both give the same counts for rgba8 and 16 bit images
+namespace Histogram {
+
+	static constexpr uint32_t Bins = 256;
+
+	enum Channel : uint32_t {
+		Red,
+		Green,
+		Blue,
+		Luma,
+		ChannelCount
+	};
+
+	struct Counts {
+		std::array<std::array<uint32_t, Bins>, ChannelCount> Values = {};
+		uint64_t PixelCount = 0;
+	};
+
+	// any thread, rects are in image pixels with the origin at the bottom left and clipped to the image
+	Counts ComputeCpu(const Renderer::PixelStore& pixels, const PixelKernels::PixelRect& rect);
+
+	// counts that were taken over fromRect become those of toRect, only the pixels that left and entered are counted
+	// when the rects overlap (a pan), toRect is counted from scratch when that would read less
+	void MoveCpu(const Renderer::PixelStore& pixels, const PixelKernels::PixelRect& fromRect, const PixelKernels::PixelRect& toRect, Counts& counts);
+
+	// render thread, builds assets/Shaders/Histogram.glsl, the gpu backend stays off if that fails
+	void InitGpu();
+	void ShutdownGpu();
+	bool IsGpuAvailable();
+
+	// counts rect (clipped to the texture) of a 2d texture holding its top row first like the image textures, waits for the result
+	bool ComputeGpu(uint32_t texture, uint32_t textureWidth, uint32_t textureHeight, const PixelKernels::PixelRect& rect, Counts& outCounts);
+
+}
@@ -0,0 +1,187 @@
+
+
+#include "ImageCache.h"
+
+#include <filesystem>
+#include <list>
+
+namespace ImageCache {
+
+	struct Entry {
+		Key				FileKey;
+		Renderer::Image Image;
+		size_t			CpuBytes = 0;
+		size_t			GpuBytes = 0;
+		bool			Prefetched = false;
+	};
+
+	// most recently used first, the cache holds a handful of images so a list is enough
+	static std::list<Entry> entries;
+
+	static size_t cpuBudget = 1024ull * 1024 * 1024;
+	static size_t gpuBudget = 512ull * 1024 * 1024;
+	static size_t prefetchBudget = 512ull * 1024 * 1024;
+	static Stats  stats;
+
+	static size_t GetCpuBytes(const Renderer::Image& image) {
+		size_t bytes = image.Pixels.GetSizeInBytes();
+
+		if (image.Tiles != nullptr) {
+			for (const Renderer::PixelStore& level : image.Tiles->MipLevels)
+				bytes += level.GetSizeInBytes();
+		}
+
+		return bytes;
+	}
+
+	static size_t GetGpuBytes(const Renderer::Image& image) {
+		size_t bytesPerPixel = Renderer::GetTextureFormat(image.Format).BytesPerPixel;
+
+		if (image.Tiles != nullptr)
+			return static_cast<size_t>(Renderer::TiledImage::LayerSize) * Renderer::TiledImage::LayerSize * Renderer::TiledImage::ResidentTiles * bytesPerPixel;
+
+		return static_cast<size_t>(image.Width) * image.Height * bytesPerPixel;
+	}
+
+	static void RemoveEntry(std::list<Entry>::iterator it) {
+		stats.CpuBytes -= it->CpuBytes;
+		stats.GpuBytes -= it->GpuBytes;
+
+		if (it->Prefetched) {
+			stats.PrefetchBytes -= it->CpuBytes + it->GpuBytes;
+			--stats.Prefetched;
+		}
+
+		entries.erase(it);
+		stats.Entries = (uint32_t)entries.size();
+	}
+
+	static void EvictOverBudget() {
+		while (!entries.empty() && (stats.CpuBytes > cpuBudget || stats.GpuBytes > gpuBudget)) {
+			++stats.Evictions;
+			Renderer::FreeImage(entries.back().Image);
+			RemoveEntry(std::prev(entries.end()));
+		}
+
+		// prefetches only ever displace other prefetches, starting with the one inserted first
+		for (auto it = entries.end(); it != entries.begin() && stats.PrefetchBytes > prefetchBudget;) {
+			if (!(--it)->Prefetched)
+				continue;
+
+			++stats.Evictions;
+			Renderer::FreeImage(it->Image);
+			RemoveEntry(it++);
+		}
+	}
+
+	void SetBudgets(size_t cpuBytes, size_t gpuBytes) {
+		cpuBudget = cpuBytes;
+		gpuBudget = gpuBytes;
+		EvictOverBudget();
+	}
+
+	void GetBudgets(size_t& outCpuBytes, size_t& outGpuBytes) {
+		outCpuBytes = cpuBudget;
+		outGpuBytes = gpuBudget;
+	}
+
+	void SetPrefetchBudget(size_t bytes) {
+		prefetchBudget = bytes;
+		EvictOverBudget();
+	}
+
+	size_t GetPrefetchBudget() {
+		return prefetchBudget;
+	}
+
+	bool MakeKey(const std::string& filePath, Key& outKey) {
+		std::error_code error;
+		outKey.Path		 = filePath;
+		outKey.FileSize	 = std::filesystem::file_size(filePath, error);
+		if (error)
+			return false;
+
+		outKey.WriteTime = std::filesystem::last_write_time(filePath, error).time_since_epoch().count();
+		return !error;
+	}
+
+	void Insert(const Key& key, Renderer::Image&& image, bool prefetched) {
+		Entry entry;
+		entry.FileKey	 = key;
+		entry.CpuBytes	 = GetCpuBytes(image);
+		entry.GpuBytes	 = GetGpuBytes(image);
+		entry.Prefetched = prefetched;
+		entry.Image		 = std::move(image);
+		image = {};
+
+		if (entry.CpuBytes > cpuBudget || entry.GpuBytes > gpuBudget || (prefetched && entry.CpuBytes + entry.GpuBytes > prefetchBudget)) {
+			Renderer::FreeImage(entry.Image);
+			return;
+		}
+
+		// an older version of the same file is replaced
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			if (it->FileKey.Path == key.Path) {
+				Renderer::FreeImage(it->Image);
+				RemoveEntry(it);
+				break;
+			}
+		}
+
+		stats.CpuBytes += entry.CpuBytes;
+		stats.GpuBytes += entry.GpuBytes;
+
+		if (prefetched) {
+			stats.PrefetchBytes += entry.CpuBytes + entry.GpuBytes;
+			++stats.Prefetched;
+		}
+
+		entries.push_front(std::move(entry));
+		stats.Entries = (uint32_t)entries.size();
+
+		EvictOverBudget();
+	}
+
+	bool Contains(const Key& key) {
+		for (const Entry& entry : entries) {
+			if (entry.FileKey == key)
+				return true;
+		}
+
+		return false;
+	}
+
+	bool Take(const Key& key, Renderer::Image& outImage) {
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			if (it->FileKey == key) {
+				++stats.Hits;
+				if (it->Prefetched)
+					++stats.PrefetchHits;
+
+				outImage = std::move(it->Image);
+				RemoveEntry(it);
+				return true;
+			}
+		}
+
+		++stats.Misses;
+		return false;
+	}
+
+	void Clear() {
+		for (Entry& entry : entries)
+			Renderer::FreeImage(entry.Image);
+
+		entries.clear();
+		stats.CpuBytes		= 0;
+		stats.GpuBytes		= 0;
+		stats.Entries		= 0;
+		stats.Prefetched	= 0;
+		stats.PrefetchBytes = 0;
+	}
+
+	Stats GetStats() {
+		return stats;
+	}
+
+}
@@ -0,0 +1,61 @@
+
+
+#pragma once
+
+#include "Renderer.h"
+
+#include <string>
+
+// recently shown images (texture and cpu pixels) kept around so switching back to them is a texture bind
+// the shown image is owned by the renderer and is not counted against the budgets
+namespace ImageCache {
+
+	// an entry is only reused if the file still has the same size and write time
+	struct Key {
+		std::string Path;
+		uint64_t	FileSize  = 0;
+		int64_t		WriteTime = 0;
+
+		bool operator==(const Key& other) const = default;
+	};
+
+	struct Stats {
+		uint64_t Hits	   = 0;
+		uint64_t Misses	   = 0;
+		uint64_t Evictions = 0;
+		uint32_t Entries   = 0;
+		size_t	 CpuBytes  = 0;
+		size_t	 GpuBytes  = 0;
+
+		// images decoded ahead of being opened, counted until they are taken
+		uint64_t PrefetchHits  = 0;
+		uint32_t Prefetched	   = 0;
+		size_t	 PrefetchBytes = 0;		// cpu and gpu
+	};
+
+	// least recently used entries are evicted until both budgets hold
+	void SetBudgets(size_t cpuBytes, size_t gpuBytes);
+	void GetBudgets(size_t& outCpuBytes, size_t& outGpuBytes);
+
+	// prefetched images that have not been opened yet are also held to this, least recently inserted go first
+	void SetPrefetchBudget(size_t bytes);
+	size_t GetPrefetchBudget();
+
+	// reads size and write time of the file, false if it can not be read
+	bool MakeKey(const std::string& filePath, Key& outKey);
+
+	// takes ownership of the image, an image larger than a budget on its own is freed instead
+	// prefetched images were decoded before anyone asked for them and count against the prefetch budget until taken
+	void Insert(const Key& key, Renderer::Image&& image, bool prefetched = false);
+
+	bool Contains(const Key& key);
+
+	// moves a cached image out of the cache, false on a miss
+	bool Take(const Key& key, Renderer::Image& outImage);
+
+	// frees every cached image, needs the gl context
+	void Clear();
+
+	Stats GetStats();
+
+}
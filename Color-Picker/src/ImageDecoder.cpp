@@ -0,0 +1,142 @@
+
+
+#include "stb_image.h"
+
+#include "ImageDecoder.h"
+#include "ImageLoader.h"
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+namespace ImageLoader {
+
+	// stb_image finds the format itself, it is tried for anything the other decoders did not take
+	static bool SniffStb(const uint8_t*, size_t) {
+		return true;
+	}
+
+	static bool ReadStbInfo(const uint8_t* data, size_t size, ImageInfo& outInfo) {
+		// stb_image takes the length as an int
+		if (size > INT_MAX)
+			return false;
+
+		int width, height, channels;
+		if (!stbi_info_from_memory(data, (int)size, &width, &height, &channels))
+			return false;
+
+		outInfo.Width  = width;
+		outInfo.Height = height;
+
+		// hdr stays linear float and 16 bit files keep every bit, the rest decodes to 8 bits
+		if (stbi_is_hdr_from_memory(data, (int)size))
+			outInfo.Format = Renderer::PixelFormat::RGBA32F;
+		else if (stbi_is_16_bit_from_memory(data, (int)size))
+			outInfo.Format = Renderer::PixelFormat::RGBA16;
+		else
+			outInfo.Format = Renderer::PixelFormat::RGBA8;
+
+		return true;
+	}
+
+	// the file handed to stb_image in reads, which report the fraction of the file consumed and abort the decode on cancel
+	struct StbReader {
+		const uint8_t* Data = nullptr;
+		size_t		   Size = 0;
+		size_t		   Read = 0;
+		LoadTask*	   Task = nullptr;
+
+		bool IsCancelled() const {
+			return Task != nullptr && Task->Cancelled.load(std::memory_order_relaxed);
+		}
+	};
+
+	static int ReadCallback(void* user, char* data, int size) {
+		StbReader& reader = *static_cast<StbReader*>(user);
+
+		// returning no data makes stb_image fail out of the decode
+		if (reader.IsCancelled())
+			return 0;
+
+		size_t bytes = std::min(static_cast<size_t>(size), reader.Size - reader.Read);
+		memcpy(data, reader.Data + reader.Read, bytes);
+		reader.Read += bytes;
+
+		if (reader.Task != nullptr)
+			reader.Task->Progress.store((float)reader.Read / reader.Size, std::memory_order_relaxed);
+
+		return static_cast<int>(bytes);
+	}
+
+	static void SkipCallback(void* user, int n) {
+		StbReader& reader = *static_cast<StbReader*>(user);
+		reader.Read = std::min(reader.Size, reader.Read + std::max(n, 0));
+	}
+
+	static int EofCallback(void* user) {
+		const StbReader& reader = *static_cast<const StbReader*>(user);
+		return reader.IsCancelled() || reader.Read == reader.Size;
+	}
+
+	static bool DecodeStb(const uint8_t* data, size_t size, const ImageInfo& info, uint32_t, uint8_t* outPixels, LoadTask* task) {
+		StbReader reader = { data, size, 0, task };
+		stbi_io_callbacks callbacks = { ReadCallback, SkipCallback, EofCallback };
+
+		int width, height, channels;
+		void* pixels = nullptr;
+
+		// stb_image decodes into a buffer of its own with the channels of the file, the simd expansion to rgba copies it into outPixels
+		switch (info.Format) {
+			case Renderer::PixelFormat::RGBA32F:
+				pixels = stbi_loadf_from_callbacks(&callbacks, &reader, &width, &height, &channels, 0);
+				break;
+
+			case Renderer::PixelFormat::RGBA16:
+				pixels = stbi_load_16_from_callbacks(&callbacks, &reader, &width, &height, &channels, 0);
+				break;
+
+			default:
+				pixels = stbi_load_from_callbacks(&callbacks, &reader, &width, &height, &channels, 0);
+				break;
+		}
+
+		if (pixels == nullptr) {
+			if (!reader.IsCancelled())
+				std::cout << "stb_image: " << stbi_failure_reason();
+
+			return false;
+		}
+
+		if (reader.IsCancelled()) {
+			stbi_image_free(pixels);
+			return false;
+		}
+
+		// outPixels was sized from the header
+		bool matches = (uint32_t)width == info.Width && (uint32_t)height == info.Height;
+		if (matches)
+			PixelKernels::ExpandToRGBA(pixels, channels, info.Format, outPixels, static_cast<size_t>(width) * height);
+
+		stbi_image_free(pixels);
+		return matches;
+	}
+
+	static const Decoder StbDecoder = { "stb_image", 1, SniffStb, ReadStbInfo, DecodeStb, nullptr };
+
+	static const Decoder* const decoders[] = {
+#ifdef USE_JPEG_TURBO
+		&JpegTurboDecoder,
+#endif
+#ifdef USE_LIBPNG
+		&LibPngDecoder,
+#endif
+		&StbDecoder
+	};
+
+	std::span<const Decoder* const> GetDecoders() {
+		return decoders;
+	}
+
+}
@@ -0,0 +1,70 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ImageLoader {
+
+	struct LoadTask;
+
+	// what the header says about the image, Format is what the decoder will write
+	struct ImageInfo {
+		uint32_t Width	= 0;
+		uint32_t Height = 0;
+		Renderer::PixelFormat Format = Renderer::PixelFormat::RGBA8;
+	};
+
+	// receives rows [firstRow, firstRow + rowCount) as rgba of the image's format, top row first and tightly packed
+	// returning false stops the decode
+	using RowSink = bool (*)(void* user, uint32_t firstRow, uint32_t rowCount, const uint8_t* rows);
+
+	// one image format backend, decoders read the whole file from memory (a MappedFile when loading)
+	struct Decoder {
+		const char* Name = "";
+
+		// largest n the decoder can shrink the image by while decoding (1/n of the width and height), 1 if it can not
+		uint32_t MaxScaleDenom = 1;
+
+		// true if the data starts like a file this decoder reads, only looks at the first bytes
+		bool (*Sniff)(const uint8_t* data, size_t size) = nullptr;
+
+		// reads the image size and pixel format from the header without decoding the pixels
+		bool (*ReadInfo)(const uint8_t* data, size_t size, ImageInfo& outInfo) = nullptr;
+
+		// decodes to rgba rows of info.Format, top row first and tightly packed, into outPixels of
+		// GetScaledSize(width) * GetScaledSize(height) pixels, info is what ReadInfo returned for the same data
+		// scaleDenom is a power of two up to MaxScaleDenom, task (optional) receives progress and cancels the decode if the decoder checks it
+		// outPixels may be write combined staging memory, rows should be written once and not read back (interlaced pngs do, slowly)
+		bool (*Decode)(const uint8_t* data, size_t size, const ImageInfo& info, uint32_t scaleDenom, uint8_t* outPixels, LoadTask* task) = nullptr;
+
+		// optional, decodes up to stripeRows rows at a time into a buffer of its own and hands each stripe to the sink,
+		// so the whole image is never held decoded, returns false if the file can not be streamed (interlaced pngs)
+		// the buffer is stripeRows rows of the full width, the loader keeps stripeRows to a few rows
+		bool (*DecodeStripes)(const uint8_t* data, size_t size, const ImageInfo& info, uint32_t stripeRows, RowSink sink, void* user, LoadTask* task) = nullptr;
+	};
+
+#ifdef USE_JPEG_TURBO
+	// simd jpeg decoding through libjpeg-turbo, cmyk files are left to stb_image
+	extern const Decoder JpegTurboDecoder;
+#endif
+
+#ifdef USE_LIBPNG
+	// png decoding through libpng, the one decoder that can stream stripes of huge images
+	extern const Decoder LibPngDecoder;
+#endif
+
+	// every compiled in decoder, the loader uses the first one that sniffs the file and decodes it,
+	// specialized decoders come first and stb_image last as the catch all
+	std::span<const Decoder* const> GetDecoders();
+
+	// size of a side decoded at 1/scaleDenom, partial blocks round up like in libjpeg
+	inline uint32_t GetScaledSize(uint32_t size, uint32_t scaleDenom) {
+		return (size + scaleDenom - 1) / scaleDenom;
+	}
+
+}
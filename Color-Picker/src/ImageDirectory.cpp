@@ -0,0 +1,78 @@
+
+
+#include "ImageDirectory.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <vector>
+
+namespace ImageDirectory {
+
+	static std::filesystem::path			  listedDirectory;
+	static std::vector<std::filesystem::path> files;		// sorted by file name
+
+	// the same order a file manager shows, upper and lower case mixed
+	static bool CompareNames(const std::filesystem::path& a, const std::filesystem::path& b) {
+		std::string nameA = a.filename().string(), nameB = b.filename().string();
+		return std::lexicographical_compare(nameA.begin(), nameA.end(), nameB.begin(), nameB.end(),
+			[](char x, char y) { return std::tolower((unsigned char)x) < std::tolower((unsigned char)y); });
+	}
+
+	static void ListDirectory(const std::filesystem::path& directory) {
+		listedDirectory = directory;
+		files.clear();
+
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (entry.is_regular_file(error) && IsImageFile(entry.path().string()))
+				files.push_back(entry.path());
+		}
+
+		std::sort(files.begin(), files.end(), CompareNames);
+	}
+
+	static std::vector<std::filesystem::path>::const_iterator Find(const std::filesystem::path& path) {
+		return std::find_if(files.begin(), files.end(), [&](const std::filesystem::path& file) { return file.filename() == path.filename(); });
+	}
+
+	bool IsImageFile(const std::string& filePath) {
+		static const char* const extensions[] = { ".jpg", ".jpeg", ".png", ".bmp", ".tga", ".gif", ".psd", ".hdr", ".pic", ".ppm", ".pgm", ".pnm" };
+
+		std::string extension = std::filesystem::path(filePath).extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+
+		return std::find_if(std::begin(extensions), std::end(extensions), [&](const char* known) { return extension == known; }) != std::end(extensions);
+	}
+
+	bool GetNeighbour(const std::string& filePath, int offset, std::string& outPath) {
+		std::filesystem::path path(filePath);
+		std::filesystem::path directory = path.parent_path().empty() ? std::filesystem::path(".") : path.parent_path();
+
+		if (directory != listedDirectory)
+			ListDirectory(directory);
+
+		// an image created since the listing was made
+		auto it = Find(path);
+		if (it == files.end() && IsImageFile(filePath)) {
+			ListDirectory(directory);
+			it = Find(path);
+		}
+
+		// the opened file itself may not be an image the listing keeps (or may be gone), stepping starts next to where it would be
+		int count = (int)files.size();
+		int index = it != files.end() ? (int)(it - files.begin()) : (int)(std::lower_bound(files.begin(), files.end(), path, CompareNames) - files.begin()) - (offset > 0 ? 1 : 0);
+		if (count == 0 || (it != files.end() && count == 1))
+			return false;
+
+		int neighbour = ((index + offset) % count + count) % count;
+		outPath = files[neighbour].string();
+		return outPath != filePath;
+	}
+
+	void Refresh() {
+		listedDirectory.clear();
+		files.clear();
+	}
+
+}
@@ -0,0 +1,21 @@
+
+
+#pragma once
+
+#include <string>
+
+// the images next to the opened one, for stepping through a folder
+// a directory is listed once and its listing kept until a file outside of it is asked about
+namespace ImageDirectory {
+
+	// true if the file name has the extension of a format the decoders read
+	bool IsImageFile(const std::string& filePath);
+
+	// path of the image offset entries away from filePath in its directory (file name order, wrapping around)
+	// false if the directory holds no other image
+	bool GetNeighbour(const std::string& filePath, int offset, std::string& outPath);
+
+	// drops the listing, the next call reads the directory again
+	void Refresh();
+
+}
@@ -0,0 +1,724 @@
+
+
+#include "ImageLoader.h"
+#include "DiskCache.h"
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ImageLoader {
+
+	// streamed stripes aim for this many bytes of texture rows
+	static constexpr size_t StripeBytes = 16 * 1024 * 1024;
+
+	// rows the decoder hands over at a time while streaming, WriteStripe takes them one by one
+	// so this stays small whatever the texture stripes and the scale are
+	static constexpr uint32_t SourceStripeRows = 16;
+
+	// finished stripes the render thread has not taken yet, the decoder waits beyond this so memory stays bounded
+	static constexpr size_t MaxQueuedStripes = 4;
+
+	// vram a streamed image may take, larger images are box filtered down while streaming
+	static constexpr size_t MaxStreamedTextureBytes = 1024ull * 1024 * 1024;
+
+	// thumbnails of images that decode to more than this are not made, unless their decoder shrinks or streams them
+	static constexpr size_t MaxThumbnailDecodeBytes = 256 * 1024 * 1024;
+
+	static bool IsCancelled(const LoadTask* task) {
+		return task != nullptr && task->Cancelled.load(std::memory_order_relaxed);
+	}
+
+	// caller holds task.Mutex
+	static void FreeStripes(LoadTask& task) {
+		for (const StreamedStripe& stripe : task.Stripes)
+			StagingRing::Free(stripe.Staging);
+
+		task.Stripes.clear();
+	}
+
+	// images that would need the tile pyramid or go over the pixel store budget are not held decoded if the decoder can stream
+	static bool ShouldStream(const Decoder& decoder, const ImageInfo& info, const LoadTask* task) {
+		if (task == nullptr || decoder.DecodeStripes == nullptr)
+			return false;
+
+		size_t imageSize = static_cast<size_t>(info.Width) * info.Height * Renderer::GetBytesPerPixel(info.Format);
+		size_t budget	 = Renderer::GetPixelStoreBudget();
+
+		return Renderer::NeedsTiling(info.Width, info.Height, info.Format) || (budget != 0 && imageSize > budget);
+	}
+
+	// smallest power of two reduction that fits one texture of at most MaxStreamedTextureBytes
+	static uint32_t ChooseStreamScaleDenom(const ImageInfo& info) {
+		uint32_t maxSize	   = Renderer::GetMaxTextureSize();
+		size_t	 bytesPerPixel = Renderer::GetTextureFormat(info.Format).BytesPerPixel;
+
+		uint32_t scaleDenom = 1;
+		for (;; scaleDenom *= 2) {
+			uint32_t width	= GetScaledSize(info.Width,	 scaleDenom);
+			uint32_t height = GetScaledSize(info.Height, scaleDenom);
+
+			bool fitsSize  = maxSize == 0 || (width <= maxSize && height <= maxSize);
+			bool fitsBytes = static_cast<size_t>(width) * height * bytesPerPixel <= MaxStreamedTextureBytes;
+			if ((fitsSize && fitsBytes) || (width == 1 && height == 1))
+				return scaleDenom;
+		}
+	}
+
+	// turns the decoder's stripes into stripes of the texture, box filtering the rows when the image is scaled down
+	struct StripeWriter {
+		LoadTask*	 Task = nullptr;
+		StreamHeader Header;
+		uint32_t	 SourceWidth  = 0;
+		uint32_t	 SourceHeight = 0;
+		uint32_t	 StripeRows	  = 0;		// texture rows per stripe
+		size_t		 RowStride	  = 0;		// bytes of a texture row
+
+		StreamedStripe Stripe;				// being filled, StripeData is null between stripes
+		uint8_t*	   StripeData = nullptr;
+		uint32_t	   NextRow	  = 0;		// next texture row to write
+
+		std::vector<double> Sums;			// source rows summed up for NextRow so far
+		uint32_t			SummedRows = 0;
+	};
+
+	// takes the next stripe from the staging ring once the render thread has caught up, from the heap if the ring is missing
+	static bool BeginStripe(StripeWriter& writer) {
+		LoadTask& task = *writer.Task;
+
+		writer.Stripe.FirstRow = writer.NextRow;
+		writer.Stripe.Rows	   = std::min(writer.StripeRows, writer.Header.Height - writer.NextRow);
+		size_t size = writer.Stripe.Rows * writer.RowStride;
+
+		for (;;) {
+			if (IsCancelled(&task))
+				return false;
+
+			size_t queued;
+			{
+				std::lock_guard<std::mutex> lock(task.Mutex);
+				queued = task.Stripes.size();
+			}
+
+			if (queued < MaxQueuedStripes) {
+				if (StagingRing::GetCapacity() < size) {
+					writer.Stripe.Pixels = Renderer::PixelStore(writer.Header.Width, writer.Stripe.Rows, writer.Header.Format);
+					writer.StripeData	 = writer.Stripe.Pixels.GetData();
+					return writer.StripeData != nullptr;
+				}
+
+				writer.Stripe.Staging = StagingRing::Allocate(size);
+				if (writer.Stripe.Staging.IsValid()) {
+					writer.StripeData = writer.Stripe.Staging.Data;
+					return true;
+				}
+			}
+
+			// the render thread frees ring space and takes stripes every frame
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	// next texture row to write, null if the decode was cancelled
+	static uint8_t* GetNextRow(StripeWriter& writer) {
+		if (writer.StripeData == nullptr && !BeginStripe(writer))
+			return nullptr;
+
+		return writer.StripeData + (writer.NextRow - writer.Stripe.FirstRow) * writer.RowStride;
+	}
+
+	// hands a full stripe to the render thread, the first one also tells it that the image streams
+	static void CommitRow(StripeWriter& writer) {
+		if (++writer.NextRow < writer.Stripe.FirstRow + writer.Stripe.Rows)
+			return;
+
+		LoadTask& task = *writer.Task;
+		std::lock_guard<std::mutex> lock(task.Mutex);
+
+		if (!task.Streaming.load()) {
+			task.Header = writer.Header;
+			task.Streaming.store(true);
+		}
+
+		task.Stripes.push_back(std::move(writer.Stripe));
+		writer.Stripe	  = {};
+		writer.StripeData = nullptr;
+	}
+
+	template<typename T>
+	static void SumRow(const uint8_t* row, uint32_t sourceWidth, uint32_t scaleDenom, double* sums) {
+		const T* values = reinterpret_cast<const T*>(row);
+
+		for (uint32_t x = 0; x < sourceWidth; ++x) {
+			double* sum = sums + (x / scaleDenom) * 4;
+			for (uint32_t c = 0; c < 4; ++c)
+				sum[c] += values[x * 4 + c];
+		}
+	}
+
+	// edge blocks of odd sized images hold fewer source pixels
+	template<typename T>
+	static void AverageRow(const double* sums, const StripeWriter& writer, uint8_t* outRow) {
+		T* out = reinterpret_cast<T*>(outRow);
+		uint32_t scaleDenom = writer.Header.ScaleDenom;
+
+		for (uint32_t x = 0; x < writer.Header.Width; ++x) {
+			uint32_t columns = std::min(scaleDenom, writer.SourceWidth - x * scaleDenom);
+			double	 count	 = static_cast<double>(columns) * writer.SummedRows;
+
+			for (uint32_t c = 0; c < 4; ++c) {
+				double value = sums[x * 4 + c] / count;
+				out[x * 4 + c] = std::is_floating_point_v<T> ? (T)value : (T)(value + 0.5);
+			}
+		}
+	}
+
+	// RowSink of a streamed decode
+	static bool WriteStripe(void* user, uint32_t firstRow, uint32_t rowCount, const uint8_t* rows) {
+		StripeWriter& writer = *static_cast<StripeWriter*>(user);
+		Renderer::PixelFormat format = writer.Header.Format;
+		uint32_t scaleDenom	  = writer.Header.ScaleDenom;
+		size_t	 sourceStride = static_cast<size_t>(writer.SourceWidth) * Renderer::GetBytesPerPixel(format);
+
+		for (uint32_t i = 0; i < rowCount; ++i, rows += sourceStride) {
+			if (scaleDenom == 1) {
+				uint8_t* out = GetNextRow(writer);
+				if (out == nullptr)
+					return false;
+
+				memcpy(out, rows, sourceStride);
+				CommitRow(writer);
+				continue;
+			}
+
+			switch (format) {
+				case Renderer::PixelFormat::RGBA16:  SumRow<uint16_t>(rows, writer.SourceWidth, scaleDenom, writer.Sums.data()); break;
+				case Renderer::PixelFormat::RGBA32F: SumRow<float>(rows, writer.SourceWidth, scaleDenom, writer.Sums.data());	  break;
+				default:							 SumRow<uint8_t>(rows, writer.SourceWidth, scaleDenom, writer.Sums.data());  break;
+			}
+
+			// a texture row is done after scaleDenom source rows, or at the last row of the image
+			if (++writer.SummedRows < scaleDenom && firstRow + i + 1 < writer.SourceHeight)
+				continue;
+
+			uint8_t* out = GetNextRow(writer);
+			if (out == nullptr)
+				return false;
+
+			switch (format) {
+				case Renderer::PixelFormat::RGBA16:  AverageRow<uint16_t>(writer.Sums.data(), writer, out); break;
+				case Renderer::PixelFormat::RGBA32F: AverageRow<float>(writer.Sums.data(), writer, out);	break;
+				default:							 AverageRow<uint8_t>(writer.Sums.data(), writer, out);	break;
+			}
+
+			std::fill(writer.Sums.begin(), writer.Sums.end(), 0.0);
+			writer.SummedRows = 0;
+			CommitRow(writer);
+		}
+
+		return true;
+	}
+
+	// decodes straight into texture stripes, peak memory is the decoder's few rows and the queued texture stripes
+	static bool StreamDecode(const Decoder& decoder, const MappedFile& file, const ImageInfo& info, LoadTask& task, DecodedImage& outImage) {
+		StripeWriter writer;
+		writer.Task				 = &task;
+		writer.SourceWidth		 = info.Width;
+		writer.SourceHeight		 = info.Height;
+		writer.Header.ScaleDenom = ChooseStreamScaleDenom(info);
+		writer.Header.Width		 = GetScaledSize(info.Width,  writer.Header.ScaleDenom);
+		writer.Header.Height	 = GetScaledSize(info.Height, writer.Header.ScaleDenom);
+		writer.Header.Format	 = info.Format;
+		writer.RowStride		 = static_cast<size_t>(writer.Header.Width) * Renderer::GetBytesPerPixel(info.Format);
+		writer.StripeRows		 = (uint32_t)std::max<size_t>(StripeBytes / writer.RowStride, 1);
+
+		if (writer.Header.ScaleDenom > 1)
+			writer.Sums.assign(static_cast<size_t>(writer.Header.Width) * 4, 0.0);
+
+		bool decoded = decoder.DecodeStripes(file.GetData(), file.GetSize(), info, SourceStripeRows, WriteStripe, &writer, &task);
+		StagingRing::Free(writer.Stripe.Staging);
+
+		if (!decoded || writer.NextRow != writer.Header.Height)
+			return false;
+
+		outImage.Width		= writer.Header.Width;
+		outImage.Height		= writer.Header.Height;
+		outImage.ScaleDenom = writer.Header.ScaleDenom;
+		outImage.Format		= writer.Header.Format;
+		outImage.Streamed	= true;
+		return true;
+	}
+
+	// largest scale the decoder supports that still covers the display size with the image fitted into it
+	static uint32_t ChooseScaleDenom(const Decoder& decoder, const ImageInfo& info, const LoadTask* task) {
+		if (task == nullptr || task->DisplayWidth == 0 || task->DisplayHeight == 0)
+			return 1;
+
+		float fitScale = std::min((float)task->DisplayWidth / info.Width, (float)task->DisplayHeight / info.Height);
+
+		uint32_t scaleDenom = 1;
+		while (scaleDenom * 2 <= decoder.MaxScaleDenom && fitScale * scaleDenom * 2 <= 1.0f)
+			scaleDenom *= 2;
+
+		return scaleDenom;
+	}
+
+	// tiled images stream their tiles out of the pixel store, others keep it for picking while it fits the budget
+	static bool KeepsPixelStore(uint32_t width, uint32_t height, Renderer::PixelFormat format) {
+		size_t imageSize = static_cast<size_t>(width) * height * Renderer::GetBytesPerPixel(format);
+		size_t budget	 = Renderer::GetPixelStoreBudget();
+
+		return Renderer::NeedsTiling(width, height, format) || budget == 0 || imageSize <= budget;
+	}
+
+	// hands the decoded pixels to the tile pyramid or to the staging ring and the pixel store
+	static bool FinishDecode(Renderer::PixelStore&& pixels, DecodedImage& outImage) {
+		uint32_t width	= pixels.GetWidth();
+		uint32_t height = pixels.GetHeight();
+
+		outImage.Width	= width;
+		outImage.Height = height;
+		outImage.Format = pixels.GetFormat();
+
+		// tiles are streamed out of the pixel store, building the pyramid here keeps it off the render thread
+		if (Renderer::NeedsTiling(width, height, outImage.Format)) {
+			outImage.Tiled	   = true;
+			outImage.Pixels	   = std::move(pixels);
+			outImage.MipLevels = Renderer::BuildMipLevels(outImage.Pixels);
+			return true;
+		}
+
+		size_t imageSize = pixels.GetSizeInBytes();
+
+		// writing the upload copy straight into gpu visible memory, the render thread only issues the copy
+		outImage.Staging = StagingRing::Allocate(imageSize);
+		if (outImage.Staging.IsValid())
+			memcpy(outImage.Staging.Data, pixels.GetData(), imageSize);
+
+		// pixels over the budget are only kept when there is no staging copy to upload from
+		if (KeepsPixelStore(width, height, outImage.Format) || !outImage.Staging.IsValid())
+			outImage.Pixels = std::move(pixels);
+
+		return true;
+	}
+
+	// pixels decoded in an earlier run, the render thread uploads straight out of the mapped entry
+	static bool FinishCached(DiskCache::Entry&& cached, DecodedImage& outImage) {
+		size_t imageSize = cached.RowStride * cached.Height;
+
+		// the tile pyramid is built from a pixel store like after a decode
+		if (Renderer::NeedsTiling(cached.Width, cached.Height, cached.Format)) {
+			Renderer::PixelStore pixels(cached.Width, cached.Height, cached.Format);
+			if (!pixels.IsValid())
+				return false;
+
+			memcpy(pixels.GetData(), cached.Pixels, imageSize);
+			return FinishDecode(std::move(pixels), outImage);
+		}
+
+		outImage.Width	= cached.Width;
+		outImage.Height = cached.Height;
+		outImage.Format = cached.Format;
+
+		// the copy for picking is only made when the budget keeps one, same as after a decode
+		if (KeepsPixelStore(cached.Width, cached.Height, cached.Format)) {
+			outImage.Pixels = Renderer::PixelStore(cached.Width, cached.Height, cached.Format);
+			if (outImage.Pixels.IsValid())
+				memcpy(outImage.Pixels.GetData(), cached.Pixels, imageSize);
+		}
+
+		outImage.Cached = std::move(cached);
+		return true;
+	}
+
+	// the disk write runs as a job of its own, so the decoded image goes back without waiting for it
+	// pixels shared with the decoded image stay allocated until the write is done
+	static void StoreInDiskCache(const std::string& filePath, uint64_t fileSize, int64_t writeTime, Renderer::PixelStore&& pixels) {
+		auto stored = std::make_shared<Renderer::PixelStore>(std::move(pixels));
+
+		ThreadPool::Submit([filePath, fileSize, writeTime, stored]() {
+			DiskCache::Store(filePath, fileSize, writeTime, *stored);
+		});
+	}
+
+	// a file rewritten while it was decoded, most likely a truncated mapping read as zeros or a half written snapshot
+	static bool IsUnchanged(const MappedFile& file, const std::string& filePath) {
+		if (!file.HasChanged())
+			return true;
+
+		std::cout << "Image changed while it was decoded " << filePath;
+		return false;
+	}
+
+	bool Decode(const std::string& filePath, DecodedImage& outImage, LoadTask* task) {
+		bool useDiskCache = task != nullptr && task->FileSize != 0;
+
+		// a hit skips the file and the decoder, and is full resolution whatever the display size
+		if (useDiskCache) {
+			DiskCache::Entry cached;
+			if (DiskCache::Open(filePath, task->FileSize, task->WriteTime, cached)) {
+				task->Progress.store(1.0f, std::memory_order_relaxed);
+				return !IsCancelled(task) && FinishCached(std::move(cached), outImage);
+			}
+		}
+
+		bool changedOnDisk = task != nullptr && task->ChangedOnDisk;
+		MappedFile file(filePath, changedOnDisk ? MappedFile::Access::Snapshot : MappedFile::Access::Map);
+
+		if (!file.IsValid()) {
+			std::cout << "Could not open image " << filePath;
+			return false;
+		}
+
+		// rows stay in file order (top row first), the texture coordinates flip the image on screen
+		for (const Decoder* decoder : GetDecoders()) {
+			ImageInfo info;
+			if (!decoder->Sniff(file.GetData(), file.GetSize()) || !decoder->ReadInfo(file.GetData(), file.GetSize(), info))
+				continue;
+
+			if (IsCancelled(task))
+				return false;
+
+			if (ShouldStream(*decoder, info, task)) {
+				if (StreamDecode(*decoder, file, info, *task, outImage) && IsUnchanged(file, filePath)) {
+					task->Progress.store(1.0f, std::memory_order_relaxed);
+					return !IsCancelled(task);
+				}
+
+				// a decoder that could not stream this file (interlaced png) gets to decode it whole, once stripes went out it failed
+				if (IsCancelled(task) || task->Streaming.load() || file.HasChanged())
+					return false;
+			}
+
+			uint32_t scaleDenom = ChooseScaleDenom(*decoder, info, task);
+			uint32_t width		= GetScaledSize(info.Width,  scaleDenom);
+			uint32_t height		= GetScaledSize(info.Height, scaleDenom);
+			size_t	 imageSize	= static_cast<size_t>(width) * height * Renderer::GetBytesPerPixel(info.Format);
+
+			// reduced decodes are not worth keeping, the next open would want the full resolution
+			bool storeInCache = useDiskCache && scaleDenom == 1 && DiskCache::WouldStore(imageSize);
+
+			// the upload copy is all that is left of these pixels, the decoder writes it straight into the staging ring
+			if (!storeInCache && !KeepsPixelStore(width, height, info.Format)) {
+				outImage.Staging = StagingRing::Allocate(imageSize);
+
+				if (outImage.Staging.IsValid()) {
+					if (decoder->Decode(file.GetData(), file.GetSize(), info, scaleDenom, outImage.Staging.Data, task) && IsUnchanged(file, filePath)) {
+						outImage.Width		= width;
+						outImage.Height		= height;
+						outImage.Format		= info.Format;
+						outImage.ScaleDenom = scaleDenom;
+
+						if (task != nullptr)
+							task->Progress.store(1.0f, std::memory_order_relaxed);
+
+						return !IsCancelled(task);
+					}
+
+					StagingRing::Free(outImage.Staging);
+					if (IsCancelled(task) || file.HasChanged())
+						return false;
+
+					continue;
+				}
+			}
+
+			Renderer::PixelStore pixels(width, height, info.Format);
+			if (!pixels.IsValid()) {
+				std::cout << "Out of memory for the pixels of " << filePath;
+				return false;
+			}
+
+			if (decoder->Decode(file.GetData(), file.GetSize(), info, scaleDenom, pixels.GetData(), task)) {
+				if (!IsUnchanged(file, filePath))
+					return false;
+
+				file.Release();
+				outImage.ScaleDenom = scaleDenom;
+
+				if (task != nullptr)
+					task->Progress.store(1.0f, std::memory_order_relaxed);
+
+				if (IsCancelled(task) || !FinishDecode(std::move(pixels), outImage))
+					return false;
+
+				// FinishDecode leaves the pixels alone when only the staging copy is kept, else the cache job shares the kept ones
+				if (storeInCache)
+					StoreInDiskCache(filePath, task->FileSize, task->WriteTime, pixels.IsValid() ? std::move(pixels) : outImage.Pixels.Share());
+
+				return true;
+			}
+
+			if (IsCancelled(task))
+				return false;
+		}
+
+		std::cout << "Could not load image " << filePath;
+		return false;
+	}
+
+	// 8 bit value of a channel, hdr is clamped without tone mapping
+	static uint8_t ToUnorm8(uint8_t value)	{ return value; }
+	static uint8_t ToUnorm8(uint16_t value) { return (uint8_t)(value >> 8); }
+	static uint8_t ToUnorm8(float value)	{ return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); }
+
+	// area average of the source over each destination pixel
+	template<typename T>
+	static void ShrinkToRGBA8(const Renderer::PixelStore& source, Renderer::PixelStore& outPixels) {
+		uint32_t sourceWidth = source.GetWidth(), sourceHeight = source.GetHeight();
+		uint32_t width		 = outPixels.GetWidth(), height = outPixels.GetHeight();
+
+		for (uint32_t y = 0; y < height; ++y) {
+			uint32_t y0 = y * sourceHeight / height, y1 = std::max(y0 + 1, (y + 1) * sourceHeight / height);
+
+			for (uint32_t x = 0; x < width; ++x) {
+				uint32_t x0 = x * sourceWidth / width, x1 = std::max(x0 + 1, (x + 1) * sourceWidth / width);
+				float sum[4] = {};
+
+				for (uint32_t sy = y0; sy < y1; ++sy) {
+					const T* pixel = reinterpret_cast<const T*>(source.GetPixel(x0, sy));
+					for (uint32_t sx = x0; sx < x1; ++sx, pixel += 4) {
+						for (uint32_t c = 0; c < 4; ++c)
+							sum[c] += (float)pixel[c];
+					}
+				}
+
+				float count = (float)((x1 - x0) * (y1 - y0));
+				uint8_t* out = outPixels.GetData() + (static_cast<size_t>(y) * width + x) * 4;
+				for (uint32_t c = 0; c < 4; ++c)
+					out[c] = ToUnorm8((T)(sum[c] / count + (std::is_floating_point_v<T> ? 0.0f : 0.5f)));
+			}
+		}
+	}
+
+	// RowSink of a thumbnail streamed out of the decoder, every source pixel is summed into the thumbnail pixel it falls in
+	struct ThumbnailShrinker {
+		uint32_t SourceWidth  = 0;
+		uint32_t SourceHeight = 0;
+		Renderer::PixelFormat Format = Renderer::PixelFormat::RGBA8;
+
+		std::vector<uint32_t> Columns;			// thumbnail column of each source column
+		std::vector<uint32_t> ColumnCounts;		// source columns summed into each thumbnail column
+		std::vector<uint32_t> RowCounts;
+		std::vector<double>	  Sums;				// 4 per thumbnail pixel
+	};
+
+	template<typename T>
+	static void SumThumbnailRow(ThumbnailShrinker& shrinker, uint32_t sourceY, const uint8_t* row) {
+		const T* values = reinterpret_cast<const T*>(row);
+		uint32_t width	= (uint32_t)shrinker.ColumnCounts.size();
+		uint32_t y		= (uint32_t)(static_cast<uint64_t>(sourceY) * shrinker.RowCounts.size() / shrinker.SourceHeight);
+		double*	 sums	= shrinker.Sums.data() + static_cast<size_t>(y) * width * 4;
+
+		++shrinker.RowCounts[y];
+		for (uint32_t x = 0; x < shrinker.SourceWidth; ++x) {
+			double* sum = sums + shrinker.Columns[x] * 4;
+			for (uint32_t c = 0; c < 4; ++c)
+				sum[c] += values[x * 4 + c];
+		}
+	}
+
+	static bool ShrinkThumbnailRows(void* user, uint32_t firstRow, uint32_t rowCount, const uint8_t* rows) {
+		ThumbnailShrinker& shrinker = *static_cast<ThumbnailShrinker*>(user);
+		size_t sourceStride = static_cast<size_t>(shrinker.SourceWidth) * Renderer::GetBytesPerPixel(shrinker.Format);
+
+		for (uint32_t i = 0; i < rowCount; ++i, rows += sourceStride) {
+			switch (shrinker.Format) {
+				case Renderer::PixelFormat::RGBA16:  SumThumbnailRow<uint16_t>(shrinker, firstRow + i, rows); break;
+				case Renderer::PixelFormat::RGBA32F: SumThumbnailRow<float>(shrinker, firstRow + i, rows);	  break;
+				default:							 SumThumbnailRow<uint8_t>(shrinker, firstRow + i, rows);  break;
+			}
+		}
+
+		return true;
+	}
+
+	template<typename T>
+	static void AverageThumbnail(const ThumbnailShrinker& shrinker, Renderer::PixelStore& outPixels) {
+		uint32_t width = outPixels.GetWidth();
+
+		for (uint32_t y = 0; y < outPixels.GetHeight(); ++y) {
+			for (uint32_t x = 0; x < width; ++x) {
+				size_t	 pixel = static_cast<size_t>(y) * width + x;
+				double	 count = std::max(1.0, (double)shrinker.ColumnCounts[x] * shrinker.RowCounts[y]);
+				uint8_t* out   = outPixels.GetData() + pixel * 4;
+
+				for (uint32_t c = 0; c < 4; ++c)
+					out[c] = ToUnorm8((T)(shrinker.Sums[pixel * 4 + c] / count + (std::is_floating_point_v<T> ? 0.0 : 0.5)));
+			}
+		}
+	}
+
+	// fitted into maxSize x maxSize keeping the aspect ratio, never enlarged
+	static Renderer::PixelStore MakeThumbnailStore(uint32_t width, uint32_t height, uint32_t maxSize) {
+		float fit = std::min(1.0f, (float)maxSize / std::max(width, height));
+		return Renderer::PixelStore(std::max(1u, (uint32_t)(width * fit)), std::max(1u, (uint32_t)(height * fit)));
+	}
+
+	// a decoder that can stream but not scale never holds more than a few rows of the image, false if it could not stream the file
+	static bool StreamThumbnail(const Decoder& decoder, const MappedFile& file, const ImageInfo& info, uint32_t maxSize, Renderer::PixelStore& outPixels) {
+		outPixels = MakeThumbnailStore(info.Width, info.Height, maxSize);
+		if (!outPixels.IsValid())
+			return false;
+
+		ThumbnailShrinker shrinker;
+		shrinker.SourceWidth  = info.Width;
+		shrinker.SourceHeight = info.Height;
+		shrinker.Format		  = info.Format;
+		shrinker.Columns.resize(info.Width);
+		shrinker.ColumnCounts.assign(outPixels.GetWidth(), 0);
+		shrinker.RowCounts.assign(outPixels.GetHeight(), 0);
+		shrinker.Sums.assign(static_cast<size_t>(outPixels.GetWidth()) * outPixels.GetHeight() * 4, 0.0);
+
+		for (uint32_t x = 0; x < info.Width; ++x) {
+			shrinker.Columns[x] = (uint32_t)(static_cast<uint64_t>(x) * outPixels.GetWidth() / info.Width);
+			++shrinker.ColumnCounts[shrinker.Columns[x]];
+		}
+
+		if (!decoder.DecodeStripes(file.GetData(), file.GetSize(), info, SourceStripeRows, ShrinkThumbnailRows, &shrinker, nullptr)) {
+			outPixels.Release();
+			return false;
+		}
+
+		switch (info.Format) {
+			case Renderer::PixelFormat::RGBA16:  AverageThumbnail<uint16_t>(shrinker, outPixels); break;
+			case Renderer::PixelFormat::RGBA32F: AverageThumbnail<float>(shrinker, outPixels);	  break;
+			default:							 AverageThumbnail<uint8_t>(shrinker, outPixels);  break;
+		}
+
+		return true;
+	}
+
+	bool DecodeThumbnail(const std::string& filePath, uint32_t maxSize, Renderer::PixelStore& outPixels) {
+		MappedFile file(filePath);
+		if (!file.IsValid())
+			return false;
+
+		for (const Decoder* decoder : GetDecoders()) {
+			ImageInfo info;
+			if (!decoder->Sniff(file.GetData(), file.GetSize()) || !decoder->ReadInfo(file.GetData(), file.GetSize(), info) || info.Width == 0 || info.Height == 0)
+				continue;
+
+			// smallest decode whose longer side still covers the thumbnail
+			uint32_t longSide	= std::max(info.Width, info.Height);
+			uint32_t scaleDenom = 1;
+			while (scaleDenom * 2 <= decoder->MaxScaleDenom && GetScaledSize(longSide, scaleDenom * 2) >= maxSize)
+				scaleDenom *= 2;
+
+			if (scaleDenom == 1 && decoder->DecodeStripes != nullptr && StreamThumbnail(*decoder, file, info, maxSize, outPixels))
+				return !file.HasChanged();
+
+			// every worker of the pool may be decoding a thumbnail, a whole decode of a huge image is not worth the memory
+			uint32_t width	= GetScaledSize(info.Width,	 scaleDenom);
+			uint32_t height = GetScaledSize(info.Height, scaleDenom);
+			if (static_cast<size_t>(width) * height * Renderer::GetBytesPerPixel(info.Format) > MaxThumbnailDecodeBytes)
+				return false;
+
+			Renderer::PixelStore pixels(width, height, info.Format);
+			if (!pixels.IsValid() || !decoder->Decode(file.GetData(), file.GetSize(), info, scaleDenom, pixels.GetData(), nullptr))
+				continue;
+
+			if (file.HasChanged())
+				return false;
+
+			file.Release();
+
+			outPixels = MakeThumbnailStore(pixels.GetWidth(), pixels.GetHeight(), maxSize);
+			if (!outPixels.IsValid())
+				return false;
+
+			switch (pixels.GetFormat()) {
+				case Renderer::PixelFormat::RGBA16:  ShrinkToRGBA8<uint16_t>(pixels, outPixels); break;
+				case Renderer::PixelFormat::RGBA32F: ShrinkToRGBA8<float>(pixels, outPixels);	 break;
+				default:							 ShrinkToRGBA8<uint8_t>(pixels, outPixels);	 break;
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	LoadHandle LoadAsync(const std::string& filePath, uint64_t fileSize, int64_t writeTime, uint32_t displayWidth, uint32_t displayHeight, bool changedOnDisk) {
+		LoadHandle handle = std::make_shared<LoadTask>();
+		handle->FilePath	  = filePath;
+		handle->FileSize	  = fileSize;
+		handle->WriteTime	  = writeTime;
+		handle->DisplayWidth  = displayWidth;
+		handle->DisplayHeight = displayHeight;
+		handle->ChangedOnDisk = changedOnDisk;
+
+		ThreadPool::Submit([handle]() {
+			if (handle->Cancelled.load()) {
+				handle->Status.store(LoadStatus::Cancelled);
+				return;
+			}
+
+			DecodedImage decoded;
+			bool succeeded = Decode(handle->FilePath, decoded, handle.get());
+
+			std::lock_guard<std::mutex> lock(handle->Mutex);
+
+			if (handle->Cancelled.load()) {
+				StagingRing::Free(decoded.Staging);
+				FreeStripes(*handle);
+				handle->Status.store(LoadStatus::Cancelled);
+			}
+			else {
+				if (!succeeded)
+					FreeStripes(*handle);
+
+				handle->Result = std::move(decoded);
+				handle->Progress.store(1.0f);
+				handle->Status.store(succeeded ? LoadStatus::Ready : LoadStatus::Failed);
+			}
+		});
+
+		return handle;
+	}
+
+	void Cancel(const LoadHandle& handle) {
+		if (handle == nullptr)
+			return;
+
+		std::lock_guard<std::mutex> lock(handle->Mutex);
+		handle->Cancelled.store(true);
+		FreeStripes(*handle);
+
+		if (handle->Status.load() == LoadStatus::Ready) {
+			StagingRing::Free(handle->Result.Staging);
+			handle->Result = {};
+			handle->Status.store(LoadStatus::Cancelled);
+		}
+	}
+
+	bool TakeResult(const LoadHandle& handle, DecodedImage& outImage) {
+		std::lock_guard<std::mutex> lock(handle->Mutex);
+
+		if (handle->Status.load() != LoadStatus::Ready)
+			return false;
+
+		outImage = std::move(handle->Result);
+		handle->Result = {};
+		return true;
+	}
+
+	void TakeStripes(const LoadHandle& handle, std::vector<StreamedStripe>& outStripes) {
+		std::lock_guard<std::mutex> lock(handle->Mutex);
+
+		for (StreamedStripe& stripe : handle->Stripes)
+			outStripes.push_back(std::move(stripe));
+
+		handle->Stripes.clear();
+	}
+
+}
@@ -0,0 +1,123 @@
+
+
+#pragma once
+
+#include "DiskCache.h"
+#include "PixelStore.h"
+#include "StagingRing.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ImageLoader {
+
+	enum class LoadStatus : uint8_t {
+		Pending,
+		Ready,
+		Failed,
+		Cancelled
+	};
+
+	// decoded rgba pixels of an image in the format of the file (8 bit, 16 bit or float), waiting to be uploaded
+	// Staging holds the upload copy when the staging ring had room, Pixels the copy kept for picking
+	// (empty if over the pixel store budget and staged), at least one of the two is valid
+	// a disk cache hit has neither copy for the upload, it is uploaded from the mapped Cached entry
+	struct DecodedImage {
+		uint32_t Width  = 0;
+		uint32_t Height = 0;
+		uint32_t ScaleDenom = 1;		// decoded at 1/ScaleDenom of the file's width and height
+		Renderer::PixelFormat Format = Renderer::PixelFormat::RGBA8;
+		Renderer::PixelStore	Pixels;
+		StagingRing::Allocation Staging;
+		DiskCache::Entry		Cached;
+
+		// images too large for one texture keep Pixels and carry their mip pyramid instead of a staging copy
+		bool Tiled = false;
+		std::vector<Renderer::PixelStore> MipLevels;
+
+		// streamed images arrive as LoadTask stripes, the result then only describes them
+		bool Streamed = false;
+	};
+
+	// rows [FirstRow, FirstRow + Rows) of a streamed image, in Staging if the ring had room, else in Pixels
+	struct StreamedStripe {
+		uint32_t FirstRow = 0;
+		uint32_t Rows	  = 0;
+		Renderer::PixelStore	Pixels;
+		StagingRing::Allocation Staging;
+	};
+
+	// texture a streamed image is written to, images over the texture limits are box filtered down by ScaleDenom
+	struct StreamHeader {
+		uint32_t Width		= 0;
+		uint32_t Height		= 0;
+		uint32_t ScaleDenom = 1;
+		Renderer::PixelFormat Format = Renderer::PixelFormat::RGBA8;
+	};
+
+	// shared between the render thread and the worker decoding the image
+	struct LoadTask {
+		std::string FilePath;
+
+		// size the image will be fitted into, decoders that can scale decode just large enough to cover it (0 = full size)
+		uint32_t DisplayWidth  = 0;
+		uint32_t DisplayHeight = 0;
+
+		// size and write time of the file when the load was queued (ImageCache::MakeKey), the disk cache only
+		// hands back pixels decoded from that version of the file, a FileSize of 0 leaves the disk cache out
+		uint64_t FileSize  = 0;
+		int64_t	 WriteTime = 0;
+
+		// the file watcher just reported the file changed, its writer may still be truncating it, so it is read into
+		// a snapshot instead of being mapped (see MappedFile::Access)
+		bool ChangedOnDisk = false;
+
+		std::atomic<float>		Progress  = 0.0f;		// 1 once the decoder is done with the file
+		std::atomic<LoadStatus> Status	  = LoadStatus::Pending;
+		std::atomic<bool>		Cancelled = false;
+
+		// only valid once Status is Ready, Mutex guards the Ready -> Cancelled hand over of the result
+		DecodedImage Result;
+		std::mutex	 Mutex;
+
+		// images too large to hold decoded are streamed, Header is written before Streaming is set
+		// and the stripes queue up for the render thread (guarded by Mutex) while the decode runs
+		std::atomic<bool>		   Streaming = false;
+		StreamHeader			   Header;
+		std::deque<StreamedStripe> Stripes;
+	};
+
+	using LoadHandle = std::shared_ptr<LoadTask>;
+
+	// decodes the image on the calling thread, task (optional) receives progress and cancellation
+	bool Decode(const std::string& filePath, DecodedImage& outImage, LoadTask* task = nullptr);
+
+	// decodes a small rgba8 copy of the image fitting in maxSize x maxSize for the folder thumbnails, on the calling thread
+	// decoders that can scale decode at the smallest scale still covering it, decoders that can stream are shrunk a few rows
+	// at a time, other images that would decode to over 256 MB get no thumbnail, neither the disk cache nor the staging ring are used
+	bool DecodeThumbnail(const std::string& filePath, uint32_t maxSize, Renderer::PixelStore& outPixels);
+
+	// queues the image to be decoded on the thread pool, the display size lets jpegs decode at 1/2, 1/4 or 1/8
+	// of their size when that still leaves a decoded pixel for every displayed one (0 decodes at full size)
+	// images too large to hold decoded are streamed in stripes if their decoder can (see LoadTask::Streaming), only libpng can,
+	// without it (--with-libpng) huge pngs are decoded whole by stb_image like every other format
+	// full resolution decodes of large images are kept in the disk cache for this fileSize and writeTime, written by a pool job
+	// of their own once the image is handed back, changedOnDisk is set for reloads of a file the file watcher reported
+	// a decode of a file whose size changed while it was read is thrown away and the load fails
+	LoadHandle LoadAsync(const std::string& filePath, uint64_t fileSize, int64_t writeTime, uint32_t displayWidth = 0, uint32_t displayHeight = 0, bool changedOnDisk = false);
+
+	// a queued task never starts and a running decode is dropped once it finishes, the task ends as Cancelled
+	// a result that was already Ready is released
+	void Cancel(const LoadHandle& handle);
+
+	// moves the result out of a Ready task, false if the task is not Ready (or was cancelled)
+	bool TakeResult(const LoadHandle& handle, DecodedImage& outImage);
+
+	// moves the stripes a streaming task has finished so far to outStripes, in row order
+	void TakeStripes(const LoadHandle& handle, std::vector<StreamedStripe>& outStripes);
+
+}
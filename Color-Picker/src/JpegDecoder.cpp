@@ -0,0 +1,128 @@
+
+
+#ifdef USE_JPEG_TURBO
+
+#include "ImageDecoder.h"
+#include "ImageLoader.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <iostream>
+
+#include <jpeglib.h>
+
+namespace ImageLoader {
+
+	// rows handed to libjpeg per call, enough to cover one mcu row of subsampled chroma
+	static constexpr uint32_t RowsPerRead = 16;
+
+	// libjpeg reports errors through error_exit, jumping back out of the decode instead of exiting the app
+	struct JpegError {
+		jpeg_error_mgr Manager;
+		std::jmp_buf   Jump;
+	};
+
+	static void OnJpegError(j_common_ptr info) {
+		char message[JMSG_LENGTH_MAX];
+		info->err->format_message(info, message);
+		std::cout << "libjpeg-turbo: " << message;
+
+		std::longjmp(reinterpret_cast<JpegError*>(info->err)->Jump, 1);
+	}
+
+	// only locals without destructors may live between the setjmp and a longjmp out of libjpeg
+	static void CreateDecompress(jpeg_decompress_struct& info, JpegError& error, const uint8_t* data, size_t size) {
+		info.err = jpeg_std_error(&error.Manager);
+		error.Manager.error_exit = OnJpegError;
+
+		jpeg_create_decompress(&info);
+		jpeg_mem_src(&info, data, static_cast<unsigned long>(size));
+	}
+
+	static bool SniffJpeg(const uint8_t* data, size_t size) {
+		return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+	}
+
+	static bool ReadJpegInfo(const uint8_t* data, size_t size, ImageInfo& outInfo) {
+		jpeg_decompress_struct info;
+		JpegError error;
+
+		if (setjmp(error.Jump)) {
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+
+		CreateDecompress(info, error, data, size);
+		jpeg_read_header(&info, TRUE);
+
+		outInfo.Width  = info.image_width;
+		outInfo.Height = info.image_height;
+		outInfo.Format = Renderer::PixelFormat::RGBA8;
+
+		jpeg_destroy_decompress(&info);
+		return true;
+	}
+
+	static bool DecodeJpeg(const uint8_t* data, size_t size, const ImageInfo&, uint32_t scaleDenom, uint8_t* outPixels, LoadTask* task) {
+		jpeg_decompress_struct info;
+		JpegError error;
+
+		if (setjmp(error.Jump)) {
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+
+		CreateDecompress(info, error, data, size);
+		jpeg_read_header(&info, TRUE);
+
+		// libjpeg has no rgba conversion for cmyk
+		if (info.jpeg_color_space == JCS_CMYK || info.jpeg_color_space == JCS_YCCK) {
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+
+		// the simd color conversion writes rgba straight into the pixel rows, the accurate idct keeps picked colors exact
+		info.out_color_space = JCS_EXT_RGBA;
+		info.dct_method		 = JDCT_ISLOW;
+
+		// scaling inside the idct, a 1/8 decode only ever computes the dc term of each block
+		info.scale_num	 = 1;
+		info.scale_denom = scaleDenom;
+		jpeg_start_decompress(&info);
+
+		// the caller sized outPixels from the header, libjpeg must agree on the scaled size
+		if (info.output_width != GetScaledSize(info.image_width, scaleDenom) || info.output_height != GetScaledSize(info.image_height, scaleDenom)) {
+			jpeg_destroy_decompress(&info);
+			return false;
+		}
+
+		size_t rowStride = static_cast<size_t>(info.output_width) * 4;
+		JSAMPROW rows[RowsPerRead];
+
+		while (info.output_scanline < info.output_height) {
+			if (task != nullptr && task->Cancelled.load(std::memory_order_relaxed)) {
+				jpeg_destroy_decompress(&info);
+				return false;
+			}
+
+			uint32_t count = std::min(RowsPerRead, info.output_height - info.output_scanline);
+			for (uint32_t i = 0; i < count; ++i)
+				rows[i] = outPixels + (info.output_scanline + i) * rowStride;
+
+			jpeg_read_scanlines(&info, rows, count);
+
+			if (task != nullptr)
+				task->Progress.store((float)info.output_scanline / info.output_height, std::memory_order_relaxed);
+		}
+
+		jpeg_finish_decompress(&info);
+		jpeg_destroy_decompress(&info);
+		return true;
+	}
+
+	const Decoder JpegTurboDecoder = { "libjpeg-turbo", 8, SniffJpeg, ReadJpegInfo, DecodeJpeg, nullptr };
+
+}
+
+#endif
@@ -0,0 +1,169 @@
+
+
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef PLATFORM_WINDOWS
+	#include <windows.h>
+#else
+	#include <cerrno>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace ImageLoader {
+
+#ifdef PLATFORM_WINDOWS
+
+	MappedFile::MappedFile(const std::string& filePath, Access) {
+		// the sequential scan flag is the windows side of the read ahead hint
+		HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+			// the mapping keeps the file alive, the file handle is not needed past this point
+			m_Mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+			if (m_Mapping != nullptr) {
+				m_Data = static_cast<const uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+				m_Size = m_Data != nullptr ? static_cast<size_t>(size.QuadPart) : 0;
+			}
+		}
+
+		CloseHandle(file);
+	}
+
+	bool MappedFile::HasChanged() const {
+		return false;
+	}
+
+	void MappedFile::Release() {
+		if (m_Data != nullptr)
+			UnmapViewOfFile(m_Data);
+
+		if (m_Mapping != nullptr)
+			CloseHandle(m_Mapping);
+
+		m_Data	  = nullptr;
+		m_Size	  = 0;
+		m_Mapping = nullptr;
+	}
+
+#else
+
+	// reads the file into anonymous pages, so Release unmaps it like a mapped file, a file that shrank meanwhile gives a shorter snapshot
+	static void* ReadSnapshot(int file, size_t& size) {
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (data == MAP_FAILED)
+			return MAP_FAILED;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+		posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+		size_t done = 0;
+		while (done < size) {
+			ssize_t bytes = read(file, static_cast<uint8_t*>(data) + done, size - done);
+			if (bytes < 0 && errno == EINTR)
+				continue;
+
+			if (bytes <= 0)
+				break;
+
+			done += static_cast<size_t>(bytes);
+		}
+
+		if (done == 0) {
+			munmap(data, size);
+			return MAP_FAILED;
+		}
+
+		// the pages past a short read are still mapped, they are freed with the rest
+		mprotect(data, size, PROT_READ);
+		size = done;
+		return data;
+	}
+
+	MappedFile::MappedFile(const std::string& filePath, Access access) {
+		int file = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0)
+			return;
+
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0) {
+			size_t mappedBytes = static_cast<size_t>(info.st_size), size = mappedBytes;
+			void* data = access == Access::Snapshot ? ReadSnapshot(file, size) : mmap(nullptr, mappedBytes, PROT_READ, MAP_PRIVATE, file, 0);
+
+			if (data != MAP_FAILED) {
+				// decoders walk the file once from front to back, letting the kernel read ahead aggressively
+				if (access == Access::Map)
+					madvise(data, mappedBytes, MADV_SEQUENTIAL);
+
+				m_Data		  = static_cast<const uint8_t*>(data);
+				m_Size		  = size;
+				m_MappedBytes = mappedBytes;
+				m_File		  = file;
+				return;
+			}
+		}
+
+		close(file);
+	}
+
+	bool MappedFile::HasChanged() const {
+		struct stat info;
+		return m_File >= 0 && (fstat(m_File, &info) != 0 || static_cast<size_t>(info.st_size) != m_MappedBytes);
+	}
+
+	void MappedFile::Release() {
+		if (m_Data != nullptr)
+			munmap(const_cast<uint8_t*>(m_Data), m_MappedBytes);
+
+		if (m_File >= 0)
+			close(m_File);
+
+		m_Data		  = nullptr;
+		m_Size		  = 0;
+		m_MappedBytes = 0;
+		m_File		  = -1;
+	}
+
+#endif
+
+	MappedFile::~MappedFile() {
+		Release();
+	}
+
+	MappedFile::MappedFile(MappedFile&& other) noexcept :
+		m_Data(std::exchange(other.m_Data, nullptr)),
+		m_Size(std::exchange(other.m_Size, 0))
+#ifdef PLATFORM_WINDOWS
+		, m_Mapping(std::exchange(other.m_Mapping, nullptr))
+#else
+		, m_MappedBytes(std::exchange(other.m_MappedBytes, 0))
+		, m_File(std::exchange(other.m_File, -1))
+#endif
+	{}
+
+	MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+		if (this != &other) {
+			Release();
+			m_Data = std::exchange(other.m_Data, nullptr);
+			m_Size = std::exchange(other.m_Size, 0);
+#ifdef PLATFORM_WINDOWS
+			m_Mapping = std::exchange(other.m_Mapping, nullptr);
+#else
+			m_MappedBytes = std::exchange(other.m_MappedBytes, 0);
+			m_File		  = std::exchange(other.m_File, -1);
+#endif
+		}
+
+		return *this;
+	}
+
+}
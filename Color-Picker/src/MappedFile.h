@@ -0,0 +1,61 @@
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace ImageLoader {
+
+	// read only view of a whole file in memory, mapped (decoders read straight out of the page cache) or read into a snapshot
+	// either is hinted for a single sequential pass, which is how every decoder reads it
+	class MappedFile {
+	public:
+		enum class Access : uint8_t {
+			// the page cache itself, no copy of the file is made
+			// elsewhere than on windows touching a page past the end of a file truncated meanwhile is a SIGBUS
+			Map,
+
+			// read into private memory, for a file that was just reported changed and may still be being rewritten,
+			// a truncation then gives a broken image instead of a crash
+			// windows maps it anyway, a file can not be truncated there while it has a mapping
+			Snapshot
+		};
+
+		MappedFile() = default;
+		explicit MappedFile(const std::string& filePath, Access access = Access::Map);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		MappedFile(MappedFile&& other) noexcept;
+		MappedFile& operator=(MappedFile&& other) noexcept;
+
+		// unmaps the file, the view becomes invalid
+		void Release();
+
+		// false if the file could not be opened or is empty
+		bool IsValid() const { return m_Data != nullptr; }
+
+		const uint8_t* GetData() const { return m_Data; }
+		size_t		   GetSize() const { return m_Size; }
+
+		// true if the size of the file is no longer the one it had when it was opened, what was decoded from it meanwhile
+		// may be broken and is thrown away, always false on windows where a mapped file can not be truncated
+		bool HasChanged() const;
+
+	private:
+		const uint8_t* m_Data = nullptr;
+		size_t		   m_Size = 0;
+
+#ifdef PLATFORM_WINDOWS
+		void* m_Mapping = nullptr;
+#else
+		size_t m_MappedBytes = 0;		// size of the file when opened, more than m_Size when a snapshot came up short
+		int	   m_File		 = -1;		// kept open for HasChanged
+#endif
+	};
+
+}
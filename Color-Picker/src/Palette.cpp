@@ -0,0 +1,365 @@
+
+
+#include "Palette.h"
+#include "ColorSpace.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#define PALETTE_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace Palette {
+
+	static constexpr uint32_t LevelBits = 6;
+	static constexpr uint32_t Levels	= 1 << LevelBits;
+	static constexpr uint32_t Bins		= Levels * Levels * Levels;
+
+	// pixels with alpha under one half are counted in this extra bin and left out
+	static constexpr uint32_t SkipBin = Bins;
+
+	// fewest pixels worth a band of their own when counting
+	static constexpr uint64_t BandPixels = 1 << 18;
+
+	// bins merged and converted to oklab per chunk
+	static constexpr uint32_t BinChunk = 4096;
+
+	// points assigned per chunk of a k-means step, and per block of the vectorized distance loop
+	static constexpr uint32_t PointChunk = 8192;
+	static constexpr uint32_t PointBlock = 256;
+
+	static constexpr uint32_t MaxIterations = 24;
+
+	// k-means stops once no center moves further than this in oklab (about a tenth of a just noticeable difference)
+	static constexpr float ConvergedShift = 1e-3f;
+
+	// 1.96 standard errors of a share of one half, the worst case of a binomial proportion
+	static constexpr float ShareErrorScale = 0.98f;
+
+	// rgba8 pixel read as a little endian uint32, r in the low byte and alpha in the high one
+	static uint32_t BinOf8(uint32_t pixel) {
+		uint32_t bin = ((pixel & 0xFC) << 10) | ((pixel >> 4) & 0xFC0) | ((pixel >> 18) & 0x3F);
+		return (pixel >> 31) != 0 ? bin : SkipBin;
+	}
+
+	static uint32_t LevelOf(float value) {
+		// also sends nan to 0
+		return value > 0.0f ? (uint32_t)(std::min(value, 1.0f) * (Levels - 0.001f)) : 0;
+	}
+
+	static uint32_t BinOf(const uint8_t* pixel, Renderer::PixelFormat format) {
+		switch (format) {
+			case Renderer::PixelFormat::RGBA16: {
+				uint16_t channels[4];
+				std::memcpy(channels, pixel, sizeof(channels));
+				if (channels[3] < 0x8000)
+					return SkipBin;
+
+				return ((uint32_t)(channels[0] >> 10) << 12) | ((uint32_t)(channels[1] >> 10) << 6) | (uint32_t)(channels[2] >> 10);
+			}
+
+			case Renderer::PixelFormat::RGBA32F: {
+				float channels[4];
+				std::memcpy(channels, pixel, sizeof(channels));
+				if (!(channels[3] >= 0.5f))
+					return SkipBin;
+
+				return (LevelOf(channels[0]) << 12) | (LevelOf(channels[1]) << 6) | LevelOf(channels[2]);
+			}
+
+			default: {
+				uint32_t value;
+				std::memcpy(&value, pixel, sizeof(value));
+				return BinOf8(value);
+			}
+		}
+	}
+
+#ifdef PALETTE_SSE2
+
+	// bins of 4 pixels at a time, only the increments are scalar
+	static void CountRow8(const uint8_t* pixel, uint32_t count, uint32_t* histogram) {
+		const __m128i redMask	= _mm_set1_epi32(0xFC);
+		const __m128i greenMask = _mm_set1_epi32(0xFC0);
+		const __m128i blueMask	= _mm_set1_epi32(0x3F);
+		const __m128i skipBin	= _mm_set1_epi32(SkipBin);
+
+		alignas(16) uint32_t bins[4];
+		uint32_t i = 0;
+
+		for (; i + 4 <= count; i += 4, pixel += 16) {
+			__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel));
+
+			__m128i bin = _mm_or_si128(_mm_slli_epi32(_mm_and_si128(values, redMask), 10), _mm_and_si128(_mm_srli_epi32(values, 4), greenMask));
+			bin = _mm_or_si128(bin, _mm_and_si128(_mm_srli_epi32(values, 18), blueMask));
+
+			// all ones where the top bit of alpha is set
+			__m128i opaque = _mm_srai_epi32(values, 31);
+			bin = _mm_or_si128(_mm_and_si128(opaque, bin), _mm_andnot_si128(opaque, skipBin));
+
+			_mm_store_si128(reinterpret_cast<__m128i*>(bins), bin);
+			++histogram[bins[0]];
+			++histogram[bins[1]];
+			++histogram[bins[2]];
+			++histogram[bins[3]];
+		}
+
+		for (; i < count; ++i, pixel += 4)
+			++histogram[BinOf(pixel, Renderer::PixelFormat::RGBA8)];
+	}
+
+#else
+
+	static void CountRow8(const uint8_t* pixel, uint32_t count, uint32_t* histogram) {
+		for (uint32_t i = 0; i < count; ++i, pixel += 4)
+			++histogram[BinOf(pixel, Renderer::PixelFormat::RGBA8)];
+	}
+
+#endif
+
+	// every step-th pixel of every step-th row, each row shifted so the grid does not line up with vertical structures
+	// rows are split into bands counted into histograms of their own, summed afterwards
+	static std::vector<std::vector<uint32_t>> CountPixels(const Renderer::PixelStore& pixels, uint32_t step) {
+		uint32_t firstRow = step / 2;
+		uint32_t rowCount = (pixels.GetHeight() - firstRow + step - 1) / step;
+
+		// every band costs a histogram to clear and sum, a sampled read is small enough for one
+		uint64_t readPixels = (uint64_t)rowCount * ((pixels.GetWidth() + step - 1) / step);
+		uint32_t bandCount	= (uint32_t)std::min<uint64_t>({ rowCount, 2 * (ThreadPool::GetThreadCount() + 1), 32, readPixels / BandPixels + 1 });
+		std::vector<std::vector<uint32_t>> bandHistograms(bandCount);
+
+		ThreadPool::ParallelFor(bandCount, 1, [&](uint32_t firstBand, uint32_t endBand) {
+			for (uint32_t band = firstBand; band < endBand; ++band) {
+				std::vector<uint32_t>& histogram = bandHistograms[band];
+				histogram.assign(Bins + 1, 0);
+
+				uint32_t bytesPerPixel = pixels.GetBytesPerPixel();
+				uint32_t endRow = (uint32_t)((uint64_t)(band + 1) * rowCount / bandCount);
+
+				for (uint32_t row = (uint32_t)((uint64_t)band * rowCount / bandCount); row < endRow; ++row) {
+					const uint8_t* pixel = pixels.GetPixel(0, firstRow + row * step);
+
+					if (step == 1 && pixels.GetFormat() == Renderer::PixelFormat::RGBA8) {
+						CountRow8(pixel, pixels.GetWidth(), histogram.data());
+						continue;
+					}
+
+					for (uint32_t x = (row * 7 + step / 2) % step; x < pixels.GetWidth(); x += step)
+						++histogram[BinOf(pixel + (size_t)x * bytesPerPixel, pixels.GetFormat())];
+				}
+			}
+		});
+
+		return bandHistograms;
+	}
+
+	// colors to cluster, one per occupied bin weighted by its pixel count, kept as separate arrays for the distance loop
+	struct Points {
+		std::vector<float> L, A, B, Weight;
+
+		void Append(const Points& other) {
+			L.insert(L.end(), other.L.begin(), other.L.end());
+			A.insert(A.end(), other.A.begin(), other.A.end());
+			B.insert(B.end(), other.B.begin(), other.B.end());
+			Weight.insert(Weight.end(), other.Weight.begin(), other.Weight.end());
+		}
+
+		uint32_t Size() const { return (uint32_t)Weight.size(); }
+	};
+
+	// sums the band histograms and turns every occupied bin into an oklab point at the center of the bin
+	static Points CollectPoints(const std::vector<std::vector<uint32_t>>& bandHistograms) {
+		static const std::array<float, Levels> linearLevels = []() {
+			std::array<float, Levels> levels;
+			for (uint32_t i = 0; i < Levels; ++i)
+				levels[i] = ColorSpace::SrgbToLinear((i + 0.5f) / Levels);
+
+			return levels;
+		}();
+
+		std::vector<Points> chunkPoints(Bins / BinChunk);
+
+		ThreadPool::ParallelFor(Bins, BinChunk, [&](uint32_t begin, uint32_t end) {
+			Points& points = chunkPoints[begin / BinChunk];
+
+			for (uint32_t bin = begin; bin < end; ++bin) {
+				uint32_t count = 0;
+				for (const std::vector<uint32_t>& histogram : bandHistograms)
+					count += histogram[bin];
+
+				if (count == 0)
+					continue;
+
+				glm::vec3 lab = ColorSpace::LinearToOklab({ linearLevels[bin >> 12], linearLevels[(bin >> 6) & (Levels - 1)], linearLevels[bin & (Levels - 1)] });
+				points.L.push_back(lab.x);
+				points.A.push_back(lab.y);
+				points.B.push_back(lab.z);
+				points.Weight.push_back((float)count);
+			}
+		});
+
+		Points points;
+		for (const Points& chunk : chunkPoints)
+			points.Append(chunk);
+
+		return points;
+	}
+
+	static float DistanceSq(const Points& points, uint32_t i, const glm::vec3& center) {
+		float dl = points.L[i] - center.x, da = points.A[i] - center.y, db = points.B[i] - center.z;
+		return dl * dl + da * da + db * db;
+	}
+
+	// heaviest color first, then each time the one with the largest weight times squared distance to its nearest center
+	// (k-means++ without the randomness), stops early when every color already is a center
+	static std::vector<glm::vec3> SeedCenters(const Points& points, uint32_t colors) {
+		std::vector<glm::vec3> centers;
+		std::vector<float>	   nearest(points.Size(), INFINITY);
+
+		uint32_t next = (uint32_t)(std::max_element(points.Weight.begin(), points.Weight.end()) - points.Weight.begin());
+
+		while (centers.size() < colors) {
+			glm::vec3 center = { points.L[next], points.A[next], points.B[next] };
+			centers.push_back(center);
+
+			float best = 0.0f;
+			for (uint32_t i = 0; i < points.Size(); ++i) {
+				nearest[i] = std::min(nearest[i], DistanceSq(points, i, center));
+
+				float score = points.Weight[i] * nearest[i];
+				if (score > best) {
+					best = score;
+					next = i;
+				}
+			}
+
+			if (best == 0.0f)
+				break;
+		}
+
+		return centers;
+	}
+
+	// adds the weight and weighted oklab of each point in [begin, end) to its nearest center, 4 doubles per center
+	// the centers are few, so the loop over a block of points is the inner one and vectorizes
+	static void AssignPoints(const Points& points, uint32_t begin, uint32_t end, const std::vector<glm::vec3>& centers, double* sums) {
+		float	best[PointBlock];
+		uint8_t labels[PointBlock];
+
+		for (uint32_t blockBegin = begin; blockBegin < end; blockBegin += PointBlock) {
+			uint32_t count = std::min(end - blockBegin, PointBlock);
+			const float* l = points.L.data() + blockBegin;
+			const float* a = points.A.data() + blockBegin;
+			const float* b = points.B.data() + blockBegin;
+
+			std::fill_n(best, count, INFINITY);
+
+			for (uint32_t c = 0; c < (uint32_t)centers.size(); ++c) {
+				const glm::vec3 center = centers[c];
+
+				for (uint32_t i = 0; i < count; ++i) {
+					float dl = l[i] - center.x, da = a[i] - center.y, db = b[i] - center.z;
+					float distance = dl * dl + da * da + db * db;
+
+					labels[i] = distance < best[i] ? (uint8_t)c : labels[i];
+					best[i]	  = std::min(best[i], distance);
+				}
+			}
+
+			for (uint32_t i = 0; i < count; ++i) {
+				double	weight = points.Weight[blockBegin + i];
+				double* sum	   = sums + labels[i] * 4;
+
+				sum[0] += weight;
+				sum[1] += weight * l[i];
+				sum[2] += weight * a[i];
+				sum[3] += weight * b[i];
+			}
+		}
+	}
+
+	Result Extract(const Renderer::PixelStore& pixels, const Options& options) {
+		Result result;
+		if (!pixels.IsValid() || pixels.GetWidth() == 0 || pixels.GetHeight() == 0)
+			return result;
+
+		uint32_t colors = std::clamp(options.Colors, 1u, MaxColors);
+
+		// grid step giving enough samples for the asked share error, at least one row and column are read
+		uint32_t step = 1;
+		if (options.MaxShareError > 0.0f) {
+			double samples = std::ceil(std::pow(ShareErrorScale / options.MaxShareError, 2.0));
+			double total   = (double)pixels.GetWidth() * pixels.GetHeight();
+
+			step = (uint32_t)std::clamp(std::floor(std::sqrt(total / samples)), 1.0, (double)std::min(pixels.GetWidth(), pixels.GetHeight()));
+		}
+
+		Points points = CollectPoints(CountPixels(pixels, step));
+		if (points.Size() == 0)
+			return result;
+
+		double totalWeight = 0.0;
+		for (float weight : points.Weight)
+			totalWeight += weight;
+
+		result.CountedPixels = (uint64_t)totalWeight;
+		result.ShareError	 = step > 1 ? ShareErrorScale / std::sqrt((float)totalWeight) : 0.0f;
+
+		std::vector<glm::vec3> centers = SeedCenters(points, colors);
+
+		uint32_t chunks = (points.Size() - 1) / PointChunk + 1;
+		std::vector<double> chunkSums(chunks * centers.size() * 4);
+		std::vector<double> sums(centers.size() * 4);
+
+		for (uint32_t iteration = 0; iteration < MaxIterations; ++iteration) {
+			std::fill(chunkSums.begin(), chunkSums.end(), 0.0);
+
+			ThreadPool::ParallelFor(points.Size(), PointChunk, [&](uint32_t begin, uint32_t end) {
+				AssignPoints(points, begin, end, centers, chunkSums.data() + (begin / PointChunk) * centers.size() * 4);
+			});
+
+			std::fill(sums.begin(), sums.end(), 0.0);
+			for (uint32_t chunk = 0; chunk < chunks; ++chunk) {
+				for (size_t i = 0; i < sums.size(); ++i)
+					sums[i] += chunkSums[chunk * sums.size() + i];
+			}
+
+			// a center left without points keeps its place
+			float shift = 0.0f;
+			for (size_t c = 0; c < centers.size(); ++c) {
+				const double* sum = sums.data() + c * 4;
+				if (sum[0] == 0.0)
+					continue;
+
+				glm::vec3 center = { (float)(sum[1] / sum[0]), (float)(sum[2] / sum[0]), (float)(sum[3] / sum[0]) };
+				shift = std::max(shift, glm::distance(center, centers[c]));
+				centers[c] = center;
+			}
+
+			if (shift < ConvergedShift)
+				break;
+		}
+
+		for (size_t c = 0; c < centers.size(); ++c) {
+			double weight = sums[c * 4];
+			if (weight == 0.0)
+				continue;
+
+			glm::vec3 linear = glm::clamp(ColorSpace::OklabToLinear(centers[c]), glm::vec3(0.0f), glm::vec3(1.0f));
+
+			Swatch& swatch = result.Swatches.emplace_back();
+			swatch.Color = glm::vec4(ColorSpace::LinearToSrgb(linear), 1.0f);
+			swatch.Lab	 = centers[c];
+			swatch.Share = (float)(weight / totalWeight);
+		}
+
+		std::sort(result.Swatches.begin(), result.Swatches.end(), [](const Swatch& a, const Swatch& b) { return a.Share > b.Share; });
+		return result;
+	}
+
+}
@@ -0,0 +1,42 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// dominant colors of an image, k-means in oklab over a histogram of the pixels
+// pixels are binned to 6 bits per channel first (each bin within 2/255 of its pixels), so the clustering runs over at most
+// 262144 weighted colors whatever the image size, both passes are split over the thread pool
+namespace Palette {
+
+	static constexpr uint32_t MaxColors = 32;
+
+	struct Options {
+		uint32_t Colors = 8;		// clamped to 1..MaxColors
+
+		// 0 reads every pixel, otherwise a grid of pixels is read that is large enough for the share of each
+		// color to be within this of the full image's (at 95% confidence), 0.005 reads about 38k pixels
+		float MaxShareError = 0.0f;
+	};
+
+	struct Swatch {
+		glm::vec4 Color = glm::vec4(0.0f);		// normalized like a picked color, opaque
+		glm::vec3 Lab	= glm::vec3(0.0f);		// oklab of the cluster center
+		float	  Share = 0.0f;					// fraction of the counted pixels closest to it
+	};
+
+	struct Result {
+		std::vector<Swatch> Swatches;		// most common first, fewer than asked for if the image has fewer distinct colors
+		uint64_t CountedPixels = 0;			// pixels read, those with alpha under one half are left out
+		float	 ShareError	   = 0.0f;		// bound on the error of the shares from sampling, 0 when every pixel was read
+	};
+
+	// any thread, blocks until done (the caller works on it with the pool), 16 bit and float pixels are clamped to 0..1
+	Result Extract(const Renderer::PixelStore& pixels, const Options& options = {});
+
+}
@@ -0,0 +1,493 @@
+
+
+#include "PixelKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#define PIXEL_KERNELS_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace PixelKernels {
+
+	// rgba in every format
+	static constexpr uint32_t Channels = 4;
+
+	// running per channel sums of a region, in 0..255 units
+	struct ChannelTotals {
+		uint64_t Sum[Channels]	 = {};
+		uint64_t SumSq[Channels] = {};
+		uint8_t	 Min[Channels]	 = { 255, 255, 255, 255 };
+		uint8_t	 Max[Channels]	 = {};
+	};
+
+	static void AccumulateScalar(const uint8_t* pixel, uint32_t count, ChannelTotals& totals) {
+		for (uint32_t i = 0; i < count; ++i, pixel += Channels) {
+			for (uint32_t c = 0; c < Channels; ++c) {
+				uint8_t value = pixel[c];
+				totals.Sum[c]	+= value;
+				totals.SumSq[c] += (uint32_t)value * value;
+				totals.Min[c]	 = std::min(totals.Min[c], value);
+				totals.Max[c]	 = std::max(totals.Max[c], value);
+			}
+		}
+	}
+
+#ifdef PIXEL_KERNELS_SSE2
+
+	// 32 bit lanes of the square sums overflow after 66051 pixels per lane, flushing well before that
+	static constexpr uint32_t FlushPixels = 32768;
+
+	static void AccumulateRow(const uint8_t* pixel, uint32_t count, ChannelTotals& totals) {
+		const __m128i zero = _mm_setzero_si128();
+
+		__m128i minValues = _mm_set1_epi8((char)0xFF);
+		__m128i maxValues = _mm_setzero_si128();
+
+		uint32_t done = 0;
+		while (count - done >= 4) {
+			uint32_t chunk = std::min((count - done) & ~3u, FlushPixels);
+
+			// lanes hold r, g, b, a
+			__m128i sums	= _mm_setzero_si128();
+			__m128i squares = _mm_setzero_si128();
+
+			for (uint32_t i = 0; i < chunk; i += 4, pixel += 4 * Channels) {
+				__m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixel));
+
+				minValues = _mm_min_epu8(minValues, values);
+				maxValues = _mm_max_epu8(maxValues, values);
+
+				// widening 4 pixels to two registers of 2 pixels each
+				__m128i low	 = _mm_unpacklo_epi8(values, zero);
+				__m128i high = _mm_unpackhi_epi8(values, zero);
+
+				__m128i pairSum = _mm_add_epi16(low, high);
+				sums = _mm_add_epi32(sums, _mm_add_epi32(_mm_unpacklo_epi16(pairSum, zero), _mm_unpackhi_epi16(pairSum, zero)));
+
+				// 255 * 255 still fits in 16 bits
+				__m128i lowSq  = _mm_mullo_epi16(low, low);
+				__m128i highSq = _mm_mullo_epi16(high, high);
+				squares = _mm_add_epi32(squares, _mm_add_epi32(_mm_unpacklo_epi16(lowSq, zero), _mm_unpackhi_epi16(lowSq, zero)));
+				squares = _mm_add_epi32(squares, _mm_add_epi32(_mm_unpacklo_epi16(highSq, zero), _mm_unpackhi_epi16(highSq, zero)));
+			}
+
+			alignas(16) uint32_t sumLanes[4], squareLanes[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(sumLanes), sums);
+			_mm_store_si128(reinterpret_cast<__m128i*>(squareLanes), squares);
+
+			for (uint32_t c = 0; c < Channels; ++c) {
+				totals.Sum[c]	+= sumLanes[c];
+				totals.SumSq[c] += squareLanes[c];
+			}
+
+			done += chunk;
+		}
+
+		// folding the 4 pixels of the min/max registers down to one
+		minValues = _mm_min_epu8(minValues, _mm_srli_si128(minValues, 8));
+		minValues = _mm_min_epu8(minValues, _mm_srli_si128(minValues, 4));
+		maxValues = _mm_max_epu8(maxValues, _mm_srli_si128(maxValues, 8));
+		maxValues = _mm_max_epu8(maxValues, _mm_srli_si128(maxValues, 4));
+
+		if (done != 0) {
+			uint32_t minLanes = (uint32_t)_mm_cvtsi128_si32(minValues);
+			uint32_t maxLanes = (uint32_t)_mm_cvtsi128_si32(maxValues);
+
+			for (uint32_t c = 0; c < Channels; ++c) {
+				totals.Min[c] = std::min(totals.Min[c], (uint8_t)(minLanes >> (8 * c)));
+				totals.Max[c] = std::max(totals.Max[c], (uint8_t)(maxLanes >> (8 * c)));
+			}
+		}
+
+		AccumulateScalar(pixel, count - done, totals);
+	}
+
+	static void GatherPixel(const uint8_t* pixel, float* outColor) {
+		const __m128i zero = _mm_setzero_si128();
+
+		int32_t packed;
+		memcpy(&packed, pixel, sizeof(packed));
+
+		__m128i values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+		_mm_storeu_ps(outColor, _mm_mul_ps(_mm_cvtepi32_ps(values), _mm_set1_ps(1.0f / 255.0f)));
+	}
+
+	static void GatherPixel16(const uint8_t* pixel, float* outColor) {
+		__m128i values = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixel)), _mm_setzero_si128());
+		_mm_storeu_ps(outColor, _mm_mul_ps(_mm_cvtepi32_ps(values), _mm_set1_ps(1.0f / 65535.0f)));
+	}
+
+	// the expansions return how many pixels they did, the scalar loop finishes the rest
+	// loads never reach past the end of the source, which is why the rgb loops stop a few pixels early
+
+	static size_t Expand8(const uint8_t* source, uint32_t channels, uint8_t* destination, size_t count) {
+		const __m128i alpha = _mm_set1_epi32((int)0xFF000000);
+		__m128i* out = reinterpret_cast<__m128i*>(destination);
+		size_t i = 0;
+
+		if (channels == 1) {
+			// 16 grey values, doubled twice to fill r, g and b
+			for (; i + 16 <= count; i += 16, out += 4) {
+				__m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+				__m128i low	 = _mm_unpacklo_epi8(grey, grey);
+				__m128i high = _mm_unpackhi_epi8(grey, grey);
+
+				_mm_storeu_si128(out + 0, _mm_or_si128(_mm_unpacklo_epi16(low,  low),  alpha));
+				_mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi16(low,  low),  alpha));
+				_mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi16(high, high), alpha));
+				_mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi16(high, high), alpha));
+			}
+		}
+		else if (channels == 2) {
+			// 8 grey and alpha pairs, a pair widened to 32 bits and shifted up puts grey in b and alpha on top
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i greyMask = _mm_set1_epi32(0xFF);
+
+			for (; i + 8 <= count; i += 8, out += 2) {
+				__m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+
+				for (int half = 0; half < 2; ++half) {
+					__m128i pair = half == 0 ? _mm_unpacklo_epi16(pairs, zero) : _mm_unpackhi_epi16(pairs, zero);
+					__m128i grey = _mm_and_si128(pair, greyMask);
+					_mm_storeu_si128(out + half, _mm_or_si128(_mm_or_si128(grey, _mm_slli_epi32(grey, 8)), _mm_slli_epi32(pair, 16)));
+				}
+			}
+		}
+		else if (channels == 3) {
+			// 4 pixels sit at byte offsets 0, 3, 6 and 9 of a load, the byte after each one becomes alpha
+			const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+
+			for (; i + 6 <= count; i += 4, ++out) {
+				__m128i rgb	  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+				__m128i first = _mm_unpacklo_epi32(rgb, _mm_srli_si128(rgb, 3));
+				__m128i last  = _mm_unpacklo_epi32(_mm_srli_si128(rgb, 6), _mm_srli_si128(rgb, 9));
+
+				_mm_storeu_si128(out, _mm_or_si128(_mm_and_si128(_mm_unpacklo_epi64(first, last), rgbMask), alpha));
+			}
+		}
+
+		return i;
+	}
+
+	static size_t Expand16(const uint16_t* source, uint32_t channels, uint16_t* destination, size_t count) {
+		const __m128i alpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		__m128i* out = reinterpret_cast<__m128i*>(destination);
+		size_t i = 0;
+
+		if (channels == 1) {
+			for (; i + 8 <= count; i += 8, out += 4) {
+				__m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+				__m128i low	 = _mm_unpacklo_epi16(grey, grey);
+				__m128i high = _mm_unpackhi_epi16(grey, grey);
+
+				_mm_storeu_si128(out + 0, _mm_or_si128(_mm_unpacklo_epi32(low,  low),  alpha));
+				_mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi32(low,  low),  alpha));
+				_mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi32(high, high), alpha));
+				_mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi32(high, high), alpha));
+			}
+		}
+		else if (channels == 2) {
+			// a doubled pair holds grey, alpha, grey, alpha, the word shuffles make that grey, grey, grey, alpha
+			for (; i + 4 <= count; i += 4, out += 2) {
+				__m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 2));
+				__m128i low	  = _mm_unpacklo_epi32(pairs, pairs);
+				__m128i high  = _mm_unpackhi_epi32(pairs, pairs);
+
+				_mm_storeu_si128(out + 0, _mm_shufflehi_epi16(_mm_shufflelo_epi16(low,  _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(1, 0, 0, 0)));
+				_mm_storeu_si128(out + 1, _mm_shufflehi_epi16(_mm_shufflelo_epi16(high, _MM_SHUFFLE(1, 0, 0, 0)), _MM_SHUFFLE(1, 0, 0, 0)));
+			}
+		}
+		else if (channels == 3) {
+			// 2 pixels per load, at word offsets 0 and 3
+			const __m128i rgbMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+
+			for (; i + 3 <= count; i += 2, ++out) {
+				__m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+				_mm_storeu_si128(out, _mm_or_si128(_mm_and_si128(_mm_unpacklo_epi64(rgb, _mm_srli_si128(rgb, 6)), rgbMask), alpha));
+			}
+		}
+
+		return i;
+	}
+
+	static size_t ExpandFloat(const float* source, uint32_t channels, float* destination, size_t count) {
+		const __m128 one = _mm_set1_ps(1.0f);
+		size_t i = 0;
+
+		if (channels == 1) {
+			for (; i < count; ++i, destination += 4) {
+				__m128 grey = _mm_set1_ps(source[i]);
+				_mm_storeu_ps(destination, _mm_shuffle_ps(grey, _mm_unpacklo_ps(grey, one), _MM_SHUFFLE(1, 0, 0, 0)));
+			}
+		}
+		else if (channels == 2) {
+			for (; i < count; ++i, destination += 4) {
+				__m128 pair = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(source + i * 2)));
+				_mm_storeu_ps(destination, _mm_shuffle_ps(pair, pair, _MM_SHUFFLE(1, 0, 0, 0)));
+			}
+		}
+		else if (channels == 3) {
+			// the load takes the red of the next pixel along, alpha replaces it
+			for (; i + 2 <= count; ++i, destination += 4) {
+				__m128 rgb = _mm_loadu_ps(source + i * 3);
+				_mm_storeu_ps(destination, _mm_shuffle_ps(rgb, _mm_unpackhi_ps(rgb, one), _MM_SHUFFLE(1, 0, 1, 0)));
+			}
+		}
+
+		return i;
+	}
+
+#else
+
+	static void AccumulateRow(const uint8_t* pixel, uint32_t count, ChannelTotals& totals) {
+		AccumulateScalar(pixel, count, totals);
+	}
+
+	static void GatherPixel(const uint8_t* pixel, float* outColor) {
+		for (uint32_t c = 0; c < Channels; ++c)
+			outColor[c] = pixel[c] / 255.0f;
+	}
+
+	static void GatherPixel16(const uint8_t* pixel, float* outColor) {
+		uint16_t values[Channels];
+		memcpy(values, pixel, sizeof(values));
+
+		for (uint32_t c = 0; c < Channels; ++c)
+			outColor[c] = values[c] / 65535.0f;
+	}
+
+	static size_t Expand8(const uint8_t*, uint32_t, uint8_t*, size_t) {
+		return 0;
+	}
+
+	static size_t Expand16(const uint16_t*, uint32_t, uint16_t*, size_t) {
+		return 0;
+	}
+
+	static size_t ExpandFloat(const float*, uint32_t, float*, size_t) {
+		return 0;
+	}
+
+#endif
+
+	template<typename T>
+	static void ExpandScalar(const T* source, uint32_t channels, T* destination, size_t count, T opaque) {
+		for (size_t i = 0; i < count; ++i, source += channels, destination += Channels) {
+			T alpha = channels == 2 ? source[1] : opaque;
+			T red	= source[0];
+			T green = channels >= 3 ? source[1] : red;
+			T blue	= channels >= 3 ? source[2] : red;
+
+			destination[0] = red;
+			destination[1] = green;
+			destination[2] = blue;
+			destination[3] = alpha;
+		}
+	}
+
+	template<typename T>
+	static void Expand(const T* source, uint32_t channels, T* destination, size_t count, T opaque, size_t (*expandSimd)(const T*, uint32_t, T*, size_t)) {
+		size_t done = expandSimd(source, channels, destination, count);
+		ExpandScalar(source + done * channels, channels, destination + done * Channels, count - done, opaque);
+	}
+
+	void ExpandToRGBA(const void* source, uint32_t channels, Renderer::PixelFormat format, void* destination, size_t count) {
+		if (channels == Channels) {
+			memcpy(destination, source, count * Renderer::GetBytesPerPixel(format));
+			return;
+		}
+
+		switch (format) {
+			case Renderer::PixelFormat::RGBA16:
+				Expand(static_cast<const uint16_t*>(source), channels, static_cast<uint16_t*>(destination), count, (uint16_t)0xFFFF, Expand16);
+				break;
+
+			case Renderer::PixelFormat::RGBA32F:
+				Expand(static_cast<const float*>(source), channels, static_cast<float*>(destination), count, 1.0f, ExpandFloat);
+				break;
+
+			default:
+				Expand(static_cast<const uint8_t*>(source), channels, static_cast<uint8_t*>(destination), count, (uint8_t)0xFF, Expand8);
+				break;
+		}
+	}
+
+	void GatherPixels(const Renderer::PixelStore& pixels, std::span<const glm::ivec2> points, std::span<glm::vec4> outColors) {
+		size_t count = std::min(points.size(), outColors.size());
+
+		for (size_t i = 0; i < count; ++i) {
+			const glm::ivec2& point = points[i];
+
+			if (point.x < 0 || point.y < 0 || (uint32_t)point.x >= pixels.GetWidth() || (uint32_t)point.y >= pixels.GetHeight()) {
+				outColors[i] = glm::vec4(0.0f);
+				continue;
+			}
+
+			const uint8_t* pixel = pixels.GetPixel(point.x, pixels.GetHeight() - 1 - point.y);
+
+			switch (pixels.GetFormat()) {
+				case Renderer::PixelFormat::RGBA16:  GatherPixel16(pixel, &outColors[i].x); break;
+				case Renderer::PixelFormat::RGBA32F: memcpy(&outColors[i].x, pixel, sizeof(glm::vec4)); break;
+				default:							 GatherPixel(pixel, &outColors[i].x); break;
+			}
+		}
+	}
+
+	// 16 bit and float stores, whoever picks those wants every bit so this sums in doubles without simd
+	template<typename T>
+	static RegionStats ComputeWideStats(const Renderer::PixelStore& pixels, uint32_t x, uint32_t firstRow, uint32_t width, uint32_t height, bool withMedian) {
+		// 16 bit values normalize like the gl unorm formats, floats already are colors
+		constexpr double scale = std::is_same_v<T, uint16_t> ? 1.0 / 65535.0 : 1.0;
+		constexpr bool histogramMedian = std::is_same_v<T, uint16_t>;
+
+		double sum[Channels] = {}, sumSq[Channels] = {};
+		double minValue[Channels], maxValue[Channels];
+		std::fill(minValue, minValue + Channels, std::numeric_limits<double>::max());
+		std::fill(maxValue, maxValue + Channels, std::numeric_limits<double>::lowest());
+
+		uint64_t count = static_cast<uint64_t>(width) * height;
+
+		// 16 bit medians come out of a histogram like the 8 bit ones, float medians need the values themselves
+		std::vector<uint32_t> histogram;
+		std::vector<T> values[Channels];
+
+		if (withMedian) {
+			if (histogramMedian)
+				histogram.assign(Channels * 65536, 0);
+			else
+				for (std::vector<T>& channelValues : values)
+					channelValues.reserve(count);
+		}
+
+		for (uint32_t y = firstRow; y < firstRow + height; ++y) {
+			T row[Channels];
+			const uint8_t* pixel = pixels.GetPixel(x, y);
+
+			for (uint32_t i = 0; i < width; ++i, pixel += sizeof(row)) {
+				memcpy(row, pixel, sizeof(row));
+
+				for (uint32_t c = 0; c < Channels; ++c) {
+					double value = row[c];
+					sum[c]	   += value;
+					sumSq[c]   += value * value;
+					minValue[c] = std::min(minValue[c], value);
+					maxValue[c] = std::max(maxValue[c], value);
+
+					if (!withMedian)
+						continue;
+
+					if constexpr (histogramMedian)
+						++histogram[c * 65536 + row[c]];
+					else
+						values[c].push_back(row[c]);
+				}
+			}
+		}
+
+		RegionStats stats;
+		stats.PixelCount = count;
+
+		for (uint32_t c = 0; c < Channels; ++c) {
+			double mean		= sum[c] / count;
+			double variance = std::max(sumSq[c] / count - mean * mean, 0.0);
+
+			stats.Mean[c]	= (float)(mean * scale);
+			stats.StdDev[c] = (float)(std::sqrt(variance) * scale);
+			stats.Min[c]	= (float)(minValue[c] * scale);
+			stats.Max[c]	= (float)(maxValue[c] * scale);
+
+			if (!withMedian)
+				continue;
+
+			// lower median, the same element the 8 bit histogram walk stops at
+			uint64_t half = (count + 1) / 2;
+
+			if constexpr (histogramMedian) {
+				const uint32_t* channelHistogram = histogram.data() + c * 65536;
+				uint64_t seen = 0;
+				uint32_t value = 0;
+
+				while (value < 65535 && (seen += channelHistogram[value]) < half)
+					++value;
+
+				stats.Median[c] = (float)(value * scale);
+			}
+			else {
+				std::nth_element(values[c].begin(), values[c].begin() + (half - 1), values[c].end());
+				stats.Median[c] = (float)values[c][half - 1];
+			}
+		}
+
+		return stats;
+	}
+
+	RegionStats ComputeRegionStats(const Renderer::PixelStore& pixels, const PixelRect& rect, bool withMedian) {
+		RegionStats stats;
+
+		if (!pixels.IsValid() || rect.X >= pixels.GetWidth() || rect.Y >= pixels.GetHeight())
+			return stats;
+
+		uint32_t width	= std::min(rect.Width,	pixels.GetWidth()  - rect.X);
+		uint32_t height = std::min(rect.Height, pixels.GetHeight() - rect.Y);
+		if (width == 0 || height == 0)
+			return stats;
+
+		// rows of the rect in the store, which counts them from the top
+		uint32_t firstRow = pixels.GetHeight() - rect.Y - height;
+
+		switch (pixels.GetFormat()) {
+			case Renderer::PixelFormat::RGBA16:  return ComputeWideStats<uint16_t>(pixels, rect.X, firstRow, width, height, withMedian);
+			case Renderer::PixelFormat::RGBA32F: return ComputeWideStats<float>(pixels, rect.X, firstRow, width, height, withMedian);
+			default:							 break;
+		}
+
+		ChannelTotals totals;
+		uint32_t histogram[Channels][256] = {};
+
+		for (uint32_t y = firstRow; y < firstRow + height; ++y) {
+			const uint8_t* row = pixels.GetPixel(rect.X, y);
+			AccumulateRow(row, width, totals);
+
+			// the row is still in cache, so the histogram does not cost another trip to memory
+			if (withMedian) {
+				for (uint32_t x = 0; x < width; ++x, row += Channels) {
+					for (uint32_t c = 0; c < Channels; ++c)
+						++histogram[c][row[c]];
+				}
+			}
+		}
+
+		uint64_t count = static_cast<uint64_t>(width) * height;
+		stats.PixelCount = count;
+
+		for (uint32_t c = 0; c < Channels; ++c) {
+			double mean		= (double)totals.Sum[c] / count;
+			double variance = std::max((double)totals.SumSq[c] / count - mean * mean, 0.0);
+
+			stats.Mean[c]	= (float)(mean / 255.0);
+			stats.StdDev[c] = (float)(std::sqrt(variance) / 255.0);
+			stats.Min[c]	= totals.Min[c] / 255.0f;
+			stats.Max[c]	= totals.Max[c] / 255.0f;
+
+			if (withMedian) {
+				uint64_t half = (count + 1) / 2, seen = 0;
+				uint32_t value = 0;
+
+				while (value < 255 && (seen += histogram[c][value]) < half)
+					++value;
+
+				stats.Median[c] = value / 255.0f;
+			}
+		}
+
+		return stats;
+	}
+
+}
@@ -0,0 +1,45 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+
+#include "glm/glm.hpp"
+
+#include <span>
+
+// cpu kernels running over the pixels of a PixelStore, sse2 when available with a scalar fallback
+// region statistics are only vectorized for rgba8, the 16 bit and float formats are summed in doubles
+namespace PixelKernels {
+
+	// rect in source image pixels, origin at the bottom left like picks (the pixel store holds the top row first)
+	struct PixelRect {
+		uint32_t X		= 0;
+		uint32_t Y		= 0;
+		uint32_t Width	= 0;
+		uint32_t Height = 0;
+	};
+
+	// per channel statistics, normalized to 0..1 like a picked color (hdr values may go past 1)
+	struct RegionStats {
+		uint64_t  PixelCount = 0;
+		glm::vec4 Mean	 = glm::vec4(0.0f);
+		glm::vec4 Min	 = glm::vec4(0.0f);
+		glm::vec4 Max	 = glm::vec4(0.0f);
+		glm::vec4 Median = glm::vec4(0.0f);		// lower median, only filled when asked for
+		glm::vec4 StdDev = glm::vec4(0.0f);
+	};
+
+	// reads the normalized color of every point (origin at the bottom left), points outside the image read as transparent black
+	// outColors must hold at least as many elements as points
+	void GatherPixels(const Renderer::PixelStore& pixels, std::span<const glm::ivec2> points, std::span<glm::vec4> outColors);
+
+	// statistics of the rect (clipped to the image) in a single pass over its rows
+	// the median needs a histogram next to the simd sums, so it is optional
+	RegionStats ComputeRegionStats(const Renderer::PixelStore& pixels, const PixelRect& rect, bool withMedian = true);
+
+	// widens count pixels of 1 (grey), 2 (grey and alpha), 3 (rgb) or 4 channels to rgba, opaque where the source has no alpha
+	// source channels are uint8_t, uint16_t or float to match the format, destination takes count * GetBytesPerPixel(format) bytes
+	void ExpandToRGBA(const void* source, uint32_t channels, Renderer::PixelFormat format, void* destination, size_t count);
+
+}
@@ -0,0 +1,73 @@
+
+
+#include "PixelStore.h"
+
+#include <new>
+#include <utility>
+
+namespace Renderer {
+
+	PixelStore::PixelStore(uint32_t width, uint32_t height, PixelFormat format) :
+		m_Width(width),
+		m_Height(height),
+		m_Format(format)
+	{
+		size_t size = GetSizeInBytes();
+		if (size == 0) {
+			m_Width = m_Height = 0;
+			return;
+		}
+
+		m_Data = static_cast<uint8_t*>(::operator new(size, std::align_val_t(Alignment), std::nothrow));
+		if (m_Data == nullptr) {
+			m_Width = m_Height = 0;
+			return;
+		}
+
+		m_Memory = std::shared_ptr<uint8_t>(m_Data, [](uint8_t* data) { ::operator delete(data, std::align_val_t(Alignment)); });
+	}
+
+	PixelStore::~PixelStore() {
+		Release();
+	}
+
+	PixelStore::PixelStore(PixelStore&& other) noexcept :
+		m_Memory(std::move(other.m_Memory)),
+		m_Data(std::exchange(other.m_Data, nullptr)),
+		m_Width(std::exchange(other.m_Width, 0)),
+		m_Height(std::exchange(other.m_Height, 0)),
+		m_Format(std::exchange(other.m_Format, PixelFormat::RGBA8))
+	{}
+
+	PixelStore& PixelStore::operator=(PixelStore&& other) noexcept {
+		if (this != &other) {
+			Release();
+			m_Memory = std::move(other.m_Memory);
+			m_Data	 = std::exchange(other.m_Data, nullptr);
+			m_Width  = std::exchange(other.m_Width, 0);
+			m_Height = std::exchange(other.m_Height, 0);
+			m_Format = std::exchange(other.m_Format, PixelFormat::RGBA8);
+		}
+
+		return *this;
+	}
+
+	void PixelStore::Release() {
+		m_Memory.reset();
+		m_Data	 = nullptr;
+		m_Width  = 0;
+		m_Height = 0;
+		m_Format = PixelFormat::RGBA8;
+	}
+
+	PixelStore PixelStore::Share() const {
+		PixelStore shared;
+		shared.m_Memory = m_Memory;
+		shared.m_Data	= m_Data;
+		shared.m_Width	= m_Width;
+		shared.m_Height = m_Height;
+		shared.m_Format = m_Format;
+		return shared;
+	}
+
+}
@@ -0,0 +1,74 @@
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+namespace Renderer {
+
+	// layout of a decoded pixel, always four channels in rgba order
+	enum class PixelFormat : uint8_t {
+		RGBA8,		// 8 bit unorm, what most files decode to
+		RGBA16,		// 16 bit unorm, 16 bit pngs keep every bit
+		RGBA32F		// linear float, radiance hdr (held as half floats on the gpu)
+	};
+
+	inline uint32_t GetBytesPerPixel(PixelFormat format) {
+		switch (format) {
+			case PixelFormat::RGBA16:  return 8;
+			case PixelFormat::RGBA32F: return 16;
+			default:				   return 4;
+		}
+	}
+
+	// owned copy of the decoded image kept on the cpu for picking, in the format the file decoded to
+	// base address is cache line aligned and rows are tightly packed, top row first (file order, same as the gl texture)
+	class PixelStore {
+	public:
+		static constexpr size_t Alignment = 64;
+
+		PixelStore() = default;
+		PixelStore(uint32_t width, uint32_t height, PixelFormat format = PixelFormat::RGBA8);
+		~PixelStore();
+
+		PixelStore(const PixelStore&) = delete;
+		PixelStore& operator=(const PixelStore&) = delete;
+
+		PixelStore(PixelStore&& other) noexcept;
+		PixelStore& operator=(PixelStore&& other) noexcept;
+
+		// frees the pixel memory (once no other store shares it), store becomes invalid
+		void Release();
+
+		// another store of the same pixels without copying them, for a job that reads them while this store is handed on
+		// the memory is freed with the last store sharing it, shared pixels are only read
+		PixelStore Share() const;
+
+		bool IsValid() const { return m_Data != nullptr; }
+
+		uint32_t	GetWidth()	const { return m_Width;  }
+		uint32_t	GetHeight() const { return m_Height; }
+		PixelFormat GetFormat() const { return m_Format; }
+		uint32_t	GetBytesPerPixel() const { return Renderer::GetBytesPerPixel(m_Format); }
+		size_t	 GetRowStride()   const { return static_cast<size_t>(m_Width) * GetBytesPerPixel(); }
+		size_t	 GetSizeInBytes() const { return GetRowStride() * m_Height; }
+
+		uint8_t*	   GetData()	   { return m_Data; }
+		const uint8_t* GetData() const { return m_Data; }
+
+		// no bounds checking, caller must make sure x < width and y < height
+		const uint8_t* GetPixel(uint32_t x, uint32_t y) const {
+			return m_Data + y * GetRowStride() + static_cast<size_t>(x) * GetBytesPerPixel();
+		}
+
+	private:
+		std::shared_ptr<uint8_t> m_Memory;		// owns m_Data
+		uint8_t* m_Data	  = nullptr;
+		uint32_t m_Width  = 0;
+		uint32_t m_Height = 0;
+		PixelFormat m_Format = PixelFormat::RGBA8;
+	};
+
+}
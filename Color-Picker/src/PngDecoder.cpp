@@ -0,0 +1,214 @@
+
+
+#ifdef USE_LIBPNG
+
+#include "ImageDecoder.h"
+#include "ImageLoader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <png.h>
+
+namespace ImageLoader {
+
+	// rows handed to libpng between progress updates and cancel checks of a full decode
+	static constexpr uint32_t RowsPerRead = 64;
+
+	// libpng pulls the file through a read callback, this one serves it out of memory
+	struct PngSource {
+		const uint8_t* Data	  = nullptr;
+		size_t		   Size	  = 0;
+		size_t		   Offset = 0;
+	};
+
+	static void ReadPngData(png_structp png, png_bytep outData, png_size_t count) {
+		PngSource* source = static_cast<PngSource*>(png_get_io_ptr(png));
+		if (count > source->Size - source->Offset)
+			png_error(png, "unexpected end of file");
+
+		memcpy(outData, source->Data + source->Offset, count);
+		source->Offset += count;
+	}
+
+	// libpng reports errors through the error callback, jumping back out of the decode instead of aborting
+	static void OnPngError(png_structp png, png_const_charp message) {
+		std::cout << "libpng: " << message;
+		png_longjmp(png, 1);
+	}
+
+	static void OnPngWarning(png_structp, png_const_charp) {}
+
+	static bool CreateRead(png_structp& png, png_infop& info, PngSource& source) {
+		png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, OnPngError, OnPngWarning);
+		if (png == nullptr)
+			return false;
+
+		info = png_create_info_struct(png);
+		if (info == nullptr) {
+			png_destroy_read_struct(&png, nullptr, nullptr);
+			return false;
+		}
+
+		png_set_read_fn(png, &source, ReadPngData);
+		return true;
+	}
+
+	// reads the header and sets up the conversion to rgba8 or rgba16, returns the number of interlace passes
+	// only locals without destructors may live between the setjmp of the callers and a longjmp out of libpng
+	static int SetupTransforms(png_structp png, png_infop info) {
+		png_read_info(png, info);
+
+		int bitDepth  = png_get_bit_depth(png, info);
+		int colorType = png_get_color_type(png, info);
+
+		// palette to rgb, low bit grey to 8 bits and transparency chunks to an alpha channel
+		png_set_expand(png);
+
+		if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA)
+			png_set_gray_to_rgb(png);
+
+		if (!(colorType & PNG_COLOR_MASK_ALPHA) && !png_get_valid(png, info, PNG_INFO_tRNS))
+			png_set_filler(png, bitDepth == 16 ? 0xFFFF : 0xFF, PNG_FILLER_AFTER);
+
+		// png stores 16 bit samples big endian, the pixel store holds them in native (little endian) order
+		if (bitDepth == 16)
+			png_set_swap(png);
+
+		int passes = png_set_interlace_handling(png);
+		png_read_update_info(png, info);
+		return passes;
+	}
+
+	static Renderer::PixelFormat GetPngFormat(png_structp png, png_infop info) {
+		return png_get_bit_depth(png, info) == 16 ? Renderer::PixelFormat::RGBA16 : Renderer::PixelFormat::RGBA8;
+	}
+
+	static bool SniffPng(const uint8_t* data, size_t size) {
+		return size >= 8 && png_sig_cmp(data, 0, 8) == 0;
+	}
+
+	static bool ReadPngInfo(const uint8_t* data, size_t size, ImageInfo& outInfo) {
+		PngSource source = { data, size, 0 };
+		png_structp png;
+		png_infop info;
+
+		if (!CreateRead(png, info, source))
+			return false;
+
+		if (setjmp(png_jmpbuf(png))) {
+			png_destroy_read_struct(&png, &info, nullptr);
+			return false;
+		}
+
+		png_read_info(png, info);
+
+		outInfo.Width  = png_get_image_width(png, info);
+		outInfo.Height = png_get_image_height(png, info);
+		outInfo.Format = GetPngFormat(png, info);
+
+		png_destroy_read_struct(&png, &info, nullptr);
+		return true;
+	}
+
+	static bool DecodePng(const uint8_t* data, size_t size, const ImageInfo& imageInfo, uint32_t, uint8_t* outPixels, LoadTask* task) {
+		PngSource source = { data, size, 0 };
+		png_structp png;
+		png_infop info;
+
+		if (!CreateRead(png, info, source))
+			return false;
+
+		if (setjmp(png_jmpbuf(png))) {
+			png_destroy_read_struct(&png, &info, nullptr);
+			return false;
+		}
+
+		int passes = SetupTransforms(png, info);
+		size_t rowStride = static_cast<size_t>(imageInfo.Width) * Renderer::GetBytesPerPixel(imageInfo.Format);
+
+		if (png_get_rowbytes(png, info) != rowStride) {
+			png_destroy_read_struct(&png, &info, nullptr);
+			return false;
+		}
+
+		// interlaced files fill every row once per pass, libpng merges each pass into the rows already there
+		uint64_t totalRows = static_cast<uint64_t>(passes) * imageInfo.Height, doneRows = 0;
+
+		for (int pass = 0; pass < passes; ++pass) {
+			for (uint32_t y = 0; y < imageInfo.Height; ++y, ++doneRows) {
+				if (y % RowsPerRead == 0 && task != nullptr) {
+					if (task->Cancelled.load(std::memory_order_relaxed)) {
+						png_destroy_read_struct(&png, &info, nullptr);
+						return false;
+					}
+
+					task->Progress.store((float)doneRows / totalRows, std::memory_order_relaxed);
+				}
+
+				png_read_row(png, outPixels + y * rowStride, nullptr);
+			}
+		}
+
+		png_read_end(png, nullptr);
+		png_destroy_read_struct(&png, &info, nullptr);
+		return true;
+	}
+
+	static bool ReadPngStripes(const uint8_t* data, size_t size, const ImageInfo& imageInfo, uint8_t* stripe, uint32_t stripeRows, RowSink sink, void* user, LoadTask* task) {
+		PngSource source = { data, size, 0 };
+		png_structp png;
+		png_infop info;
+
+		if (!CreateRead(png, info, source))
+			return false;
+
+		if (setjmp(png_jmpbuf(png))) {
+			png_destroy_read_struct(&png, &info, nullptr);
+			return false;
+		}
+
+		// an interlaced file only has its final rows after the last pass, it can not be streamed
+		size_t rowStride = static_cast<size_t>(imageInfo.Width) * Renderer::GetBytesPerPixel(imageInfo.Format);
+		if (SetupTransforms(png, info) != 1 || png_get_rowbytes(png, info) != rowStride) {
+			png_destroy_read_struct(&png, &info, nullptr);
+			return false;
+		}
+
+		for (uint32_t firstRow = 0; firstRow < imageInfo.Height; firstRow += stripeRows) {
+			if (task != nullptr && task->Cancelled.load(std::memory_order_relaxed)) {
+				png_destroy_read_struct(&png, &info, nullptr);
+				return false;
+			}
+
+			uint32_t rows = std::min(stripeRows, imageInfo.Height - firstRow);
+			for (uint32_t i = 0; i < rows; ++i)
+				png_read_row(png, stripe + i * rowStride, nullptr);
+
+			if (!sink(user, firstRow, rows, stripe)) {
+				png_destroy_read_struct(&png, &info, nullptr);
+				return false;
+			}
+
+			if (task != nullptr)
+				task->Progress.store((float)(firstRow + rows) / imageInfo.Height, std::memory_order_relaxed);
+		}
+
+		png_read_end(png, nullptr);
+		png_destroy_read_struct(&png, &info, nullptr);
+		return true;
+	}
+
+	static bool DecodePngStripes(const uint8_t* data, size_t size, const ImageInfo& imageInfo, uint32_t stripeRows, RowSink sink, void* user, LoadTask* task) {
+		// the only allocation of a streamed decode, one stripe of rows reused for the whole image
+		std::vector<uint8_t> stripe(static_cast<size_t>(imageInfo.Width) * Renderer::GetBytesPerPixel(imageInfo.Format) * stripeRows);
+		return ReadPngStripes(data, size, imageInfo, stripe.data(), stripeRows, sink, user, task);
+	}
+
+	const Decoder LibPngDecoder = { "libpng", 1, SniffPng, ReadPngInfo, DecodePng, DecodePngStripes };
+
+}
+
+#endif
@@ -1,369 +1,1305 @@
 
 #include "glad/glad.h"
-#include "stb_image.h"
 
 #include "Renderer.h"
+#include "ImageLoader.h"
+#include "StagingRing.h"
+#include "FileWatcher.h"
+#include "ImageCache.h"
+#include "ImageDirectory.h"
+#include "ThreadPool.h"
+#include "SimilarPixels.h"
 
 #include <iostream>
-#include <fstream>
-#include <filesystem>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <atomic>
 
 namespace Renderer {
 
-	// framebuffer properties
+	// size of the ui area the image is shown in
 	static uint32_t targetWidth  = 0;
 	static uint32_t targetHeight = 0;
-	static uint32_t frameBuffer  = 0;
-	static uint32_t frameColorBuffer  = 0;
 
-	// image and projection of the image
+	// image and the quads showing it this frame
 	static Image	   image;
 	static std::string imagePath;
-	static glm::mat4   projectionMat;
+	static ImageFrame  frame;
+
+	// cache keys of the shown image and of the image being loaded
+	static ImageCache::Key imageKey;
+	static ImageCache::Key loadKey;
+
+	// fitted image in world units, the target spans (-aspect, -1) to (aspect, 1) at zoom 1
+	static glm::vec2 imageMin = { 0.0f, 0.0f };
+	static glm::vec2 imageMax = { 0.0f, 0.0f };
+
+	// navigation, zoom is relative to the fitted image and center is the world point in the middle of the target
+	static float	 viewZoom	= 1.0f;
+	static glm::vec2 viewCenter = { 0.0f, 0.0f };
+
+	// most target pixels a single source pixel may cover
+	static constexpr float MaxPixelsPerTexel = 64.0f;
+
+	// limit for the cpu pixel store of a single image (0 = no limit)
+	static size_t pixelStoreBudget = 0;
+
+	// image being decoded on the thread pool and then uploaded a few rows per frame
+	static ImageLoader::LoadHandle	 loadTask;
+	static bool refining	   = false;		// loadTask decodes the shown image at full resolution
+	static bool refineFailed   = false;		// so a file that only decodes reduced is not tried every frame
+	static ImageLoader::DecodedImage pendingPixels;
+	static Image	pendingImage;
+	static uint32_t pendingUploadRow = 0;
+
+	// images around the shown one in its directory, decoded on the thread pool and kept in the image cache
+	struct Prefetch {
+		ImageCache::Key			Key;
+		ImageLoader::LoadHandle Task;
+	};
+
+	static std::vector<Prefetch>		prefetches;		// running
+	static std::vector<ImageCache::Key> prefetchQueue;	// waiting to start, nearest first
+	static uint32_t prefetchDepth = 2;
+	static NavigationStats navigationStats;
+
+	// upload budget per frame for images that did not fit the staging ring, keeps them from stalling a single frame
+	static constexpr size_t UploadBytesPerFrame = 16 * 1024 * 1024;
+
+	// size of the persistently mapped upload ring, fits a 50 MP rgba image with room for the next decode
+	static constexpr size_t StagingRingSize = 256 * 1024 * 1024;
+
+	// shown in place of the image while it is loading
+	static uint32_t placeholderTexture = 0;
+
+	// ring of pixel pack buffers so hovered pixels are read back without waiting on the gpu
+	struct PixelReadback {
+		uint32_t Buffer = 0;
+		GLsync	 Fence  = nullptr;
+		uint64_t RequestFrame = 0;
+	};
+
+	static constexpr uint32_t ReadbackRingSize = 3;
+	static PixelReadback readbackRing[ReadbackRingSize];
+	static uint32_t readbackNext   = 0;		// slot the next request writes to
+	static uint32_t readbackOldest = 0;		// oldest slot that may still be in flight (slots finish in order)
+	static uint64_t readbackFrame  = 0;
+
+	// histograms of the whole image and of its visible part, with what they were counted from
+	struct HistogramState {
+		bool			 Valid	 = false;
+		ImageCache::Key	 Key;
+		uint32_t		 ImageId = 0;
+		uint32_t		 Width	 = 0;
+		uint32_t		 Height	 = 0;
+		HistogramBackend Backend = HistogramBackend::Cpu;
+		PixelKernels::PixelRect Rect;
+		Histogram::Counts		Counts;
+	};
+
+	static HistogramState histograms[2];
+
+	// work on the shown image's pixels done on the thread pool, the render thread collects the result once State is Done
+	struct PixelJob {
+		enum : uint8_t { Queued, Running, Done, Dropped };
+		std::atomic<uint8_t> State = Queued;
+
+		// the shown image's pixel store, FreeImage and SetImagePath stop the job before freeing or moving it
+		const PixelStore* Pixels = nullptr;
+		ImageCache::Key	  Key;
+		uint32_t		  ImageId = 0;
+	};
+
+	// a mask of the shown image
+	struct SimilarMaskJob : PixelJob {
+		glm::vec3		  TargetLab = glm::vec3(0.0f);
+		float			  Threshold = 0.0f;
+		bool			  NewTarget = true;		// measures the distances, else only compares the ones handed in
+
+		SimilarPixels::DistanceMap Distances;
+		std::vector<uint8_t>	   Mask;
+		uint64_t PixelCount = 0;
+		float	 UpdateMs	= 0.0f;
+	};
+
+	// cpu mask of the pixels similar to a picked color, the texture keeps the previous mask while a job makes the next one
+	struct SimilarMaskState {
+		bool			Valid	= false;
+		ImageCache::Key Key;
+		uint32_t		ImageId = 0;
+		glm::vec3		TargetLab = glm::vec3(0.0f);
+		float			Threshold = 0.0f;
+		uint64_t		PixelCount = 0;
+		float			UpdateMs   = 0.0f;
+
+		// handed to the job while it runs
+		SimilarPixels::DistanceMap Distances;
+		std::vector<uint8_t>	   Mask;
+
+		uint32_t Texture = 0;
+		uint32_t TextureWidth  = 0;
+		uint32_t TextureHeight = 0;
+
+		std::shared_ptr<SimilarMaskJob> Job;
+	};
+
+	static SimilarMaskState similarMask;
+
+	// summed-area tables of the shown image
+	struct SummedAreaJob : PixelJob {
+		bool			  WithSquares = true;
+		SummedArea::Table Table;		// empty if its memory could not be allocated
+		float			  BuildMs = 0.0f;
+	};
+
+	// summed-area tables of the shown image for region means, rects are summed directly while a job builds them
+	struct SummedAreaState {
+		bool			  Valid	  = false;		// a build for Key and ImageId has finished, Table is empty if it ran out of memory
+		ImageCache::Key	  Key;
+		uint32_t		  ImageId = 0;
+		uint32_t		  Width	  = 0;
+		uint32_t		  Height  = 0;
+		bool			  WithSquares = true;
+		SummedArea::Table Table;
+		float			  BuildMs = 0.0f;
+
+		std::shared_ptr<SummedAreaJob> Job;
+	};
+
+	static SummedAreaState summedArea;
+	static bool summedAreaEnabled = true;
+	static bool summedAreaSquares = true;
+
+	// most memory the tables may take, a pixel store budget lower than that limits them too
+	static constexpr size_t MaxSummedAreaBytes = 1024ull * 1024 * 1024;
+
+	// latest resolved hover pick
+	static glm::vec4 hoverColor(0.0f);
+	static uint32_t  hoverLatency = 0;
+	static bool		 hoverValid	  = false;
+
+	TextureFormat GetTextureFormat(PixelFormat format) {
+		switch (format) {
+			case PixelFormat::RGBA16:  return { GL_RGBA16,  GL_UNSIGNED_SHORT, 8 };
+			case PixelFormat::RGBA32F: return { GL_RGBA16F, GL_FLOAT,		   8 };
+			default:				   return { GL_RGBA8,	GL_UNSIGNED_BYTE,  4 };
+		}
+	}
 
-	// renderer primitives for quad
-	static uint32_t vertexBuffer = 0;
-	static uint32_t indexBuffer  = 0;
-	static uint32_t vertexArray  = 0;
-	static uint32_t quadShader	 = 0;
-	static QuadVertex vertexData[4];
+	static uint32_t CreateImageTexture(uint32_t width, uint32_t height, PixelFormat format) {
+		uint32_t textureId = 0;
+		glCreateTextures(GL_TEXTURE_2D, 1, &textureId);
+		glTextureStorage2D(textureId, 1, GetTextureFormat(format).InternalFormat, width, height);
 
-	void CreateFrameBuffer(int width, int height, uint32_t& rendererId, uint32_t& frameColorBuffer) {
-		glGenFramebuffers(1, &rendererId);
-		glBindFramebuffer(GL_FRAMEBUFFER, rendererId);
+		// nearest when magnified so zoomed in pixels stay crisp
+		glTextureParameteri(textureId, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(textureId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-		glCreateTextures(GL_TEXTURE_2D, 1, &frameColorBuffer);
-		glBindTexture(GL_TEXTURE_2D, frameColorBuffer);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		// the ui samples the texture directly, edges must not blend with the opposite side
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(textureId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return textureId;
+	}
 
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	// drops the cpu copy of the pixels if it is over the budget
+	static void ApplyPixelStoreBudget(Image& image) {
+		// tiles stream out of the pixel store, a tiled image always keeps it
+		if (image.Tiles != nullptr)
+			return;
 
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frameColorBuffer, 0);
+		if (pixelStoreBudget != 0 && image.Pixels.GetSizeInBytes() > pixelStoreBudget)
+			image.Pixels.Release();
+	}
 
-		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) 
-			std::cout << "Uncomplete FrameBuffer!";
+	// uploads rows [firstRow, firstRow + rows) from the staging ring if the decoder wrote there, else from the mapped
+	// disk cache entry or the pixel store
+	static void UploadRows(const Image& target, ImageLoader::DecodedImage& decoded, uint32_t firstRow, uint32_t rows) {
+		size_t rowOffset = static_cast<size_t>(firstRow) * decoded.Width * GetBytesPerPixel(decoded.Format);
+		uint32_t type	 = GetTextureFormat(decoded.Format).Type;
+
+		if (decoded.Staging.IsValid()) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, StagingRing::GetBufferId());
+			glTextureSubImage2D(target.ImageId, 0, 0, firstRow, target.Width, rows, GL_RGBA, type, (const void*)(decoded.Staging.Offset + rowOffset));
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			// region goes back to the ring once the gpu has copied it
+			if (firstRow + rows == decoded.Height) {
+				StagingRing::Submit(decoded.Staging);
+				decoded.Staging = {};
+			}
+		}
+		else if (decoded.Cached.Pixels != nullptr) {
+			const DiskCache::Entry& cached = decoded.Cached;
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, (int)(cached.RowStride / GetBytesPerPixel(decoded.Format)));
+			glTextureSubImage2D(target.ImageId, 0, 0, firstRow, target.Width, rows, GL_RGBA, type, cached.Pixels + firstRow * cached.RowStride);
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		}
+		else {
+			glTextureSubImage2D(target.ImageId, 0, 0, firstRow, target.Width, rows, GL_RGBA, type, decoded.Pixels.GetData() + rowOffset);
+		}
+	}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// tiles are uploaded on demand while drawing, nothing to upload up front
+	static void CreateTiledFromDecoded(Image& target, ImageLoader::DecodedImage& decoded) {
+		target.Tiles = std::make_unique<TiledImage>();
+		target.Tiles->MipLevels = std::move(decoded.MipLevels);
+		target.Pixels  = std::move(decoded.Pixels);
+		target.ImageId = CreateTiledImage(*target.Tiles, target.Pixels);
 	}
 
-	void InvalidateFrameBuffers(uint32_t frameBuffer, uint32_t frameColorBuffer) {
-		glDeleteTextures(1, &frameColorBuffer);
-		glDeleteFramebuffers(1, &frameBuffer);
+	// creates and uploads the whole image at once
+	static Image CreateFromDecoded(ImageLoader::DecodedImage& decoded) {
+		Image newImage = {};
+		newImage.Width		= decoded.Width;
+		newImage.Height		= decoded.Height;
+		newImage.ScaleDenom = decoded.ScaleDenom;
+		newImage.Format		= decoded.Format;
+
+		if (decoded.Tiled) {
+			CreateTiledFromDecoded(newImage, decoded);
+			return newImage;
+		}
+
+		newImage.ImageId = CreateImageTexture(decoded.Width, decoded.Height, decoded.Format);
+		UploadRows(newImage, decoded, 0, decoded.Height);
+
+		newImage.Pixels = std::move(decoded.Pixels);
+		ApplyPixelStoreBudget(newImage);
+
+		return newImage;
 	}
 
 	Image LoadImage(const std::string& filePath) {
-		Image newImage = {};
+		ImageLoader::DecodedImage decoded;
+		if (!ImageLoader::Decode(filePath, decoded))
+			return {};
 
-		int width, height, channels;
+		return CreateFromDecoded(decoded);
+	}
 
-		stbi_set_flip_vertically_on_load(1);
-		unsigned char* data = stbi_load(filePath.c_str(), &width, &height, &channels, 0);
-		newImage.Width = width;
-		newImage.Height = height;
+	// true if the job may run, false if it was dropped before it started
+	static bool StartPixelJob(PixelJob& job) {
+		uint8_t queued = PixelJob::Queued;
+		return job.State.compare_exchange_strong(queued, PixelJob::Running);
+	}
 
-		GLenum internalFormat = 0, dataFormat = 0;
-		if (channels == 4) {
-			internalFormat = GL_RGBA8;
-			dataFormat = GL_RGBA;
-		}
-		else if (channels == 3) {
-			internalFormat = GL_RGB8;
-			dataFormat = GL_RGB;
-		}
+	static void FinishPixelJob(PixelJob& job) {
+		job.State = PixelJob::Done;
+		job.State.notify_all();
+	}
 
-		glCreateTextures(GL_TEXTURE_2D, 1, &newImage.ImageId);
-		glTextureStorage2D(newImage.ImageId, 1, internalFormat, width, height);
+	// a job reading pixels that are about to be freed or moved is dropped if it has not started yet, else waited for,
+	// returns false if the job does not read them
+	static bool StopPixelJob(PixelJob* job, const PixelStore& pixels) {
+		if (job == nullptr || job->Pixels != &pixels)
+			return false;
 
-		glTexParameteri(newImage.ImageId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(newImage.ImageId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		uint8_t queued = PixelJob::Queued;
+		if (!job->State.compare_exchange_strong(queued, PixelJob::Dropped))
+			job->State.wait(PixelJob::Running);
 
-		glTextureSubImage2D(newImage.ImageId, 0, 0, 0, width, height, dataFormat, GL_UNSIGNED_BYTE, data);
-		stbi_image_free(data);
+		return true;
+	}
 
-		return newImage;
+	// what the jobs made of these pixels is dropped with them
+	static void StopPixelJobs(const PixelStore& pixels) {
+		if (StopPixelJob(similarMask.Job.get(), pixels)) {
+			similarMask.Valid = false;
+			similarMask.Job.reset();
+		}
+
+		if (StopPixelJob(summedArea.Job.get(), pixels))
+			summedArea.Job.reset();
 	}
 
 	void FreeImage(Image& image) {
-		glDeleteTextures(1, &image.ImageId);
+		StopPixelJobs(image.Pixels);
+
+		if (image.Tiles != nullptr) {
+			FreeTiledImage(*image.Tiles);
+			image.Tiles.reset();
+		}
+		else {
+			glDeleteTextures(1, &image.ImageId);
+		}
+
+		image.ImageId = 0;
+		image.Pixels.Release();
 	}
 
-	int ShaderTypeFromString(const std::string& type) {
-		if (type == "vertex" || type == "Vertex") {
-			return 0;
+	void SetPixelStoreBudget(size_t bytes) {
+		pixelStoreBudget = bytes;
+	}
+
+	size_t GetPixelStoreBudget() {
+		return pixelStoreBudget;
+	}
+
+	void InitRenderer() {
+		image	  = {};
+		imagePath.clear();
+		FileWatcher::Init();
+
+		// grey checker board shown while an image loads
+		uint32_t checker[8 * 8];
+		for (uint32_t y = 0; y < 8; ++y) {
+			for (uint32_t x = 0; x < 8; ++x)
+				checker[y * 8 + x] = ((x + y) & 1) ? 0xFF505050 : 0xFF303030;
+		}
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &placeholderTexture);
+		glTextureStorage2D(placeholderTexture, 1, GL_RGBA8, 8, 8);
+		glTextureParameteri(placeholderTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(placeholderTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureSubImage2D(placeholderTexture, 0, 0, 0, 8, 8, GL_RGBA, GL_UNSIGNED_BYTE, checker);
+
+		StagingRing::Init(StagingRingSize);
+		InitTiledImages();
+		Histogram::InitGpu();
+		SimilarPixels::InitGpu();
+
+		for (PixelReadback& readback : readbackRing) {
+			glCreateBuffers(1, &readback.Buffer);
+			glNamedBufferData(readback.Buffer, sizeof(glm::vec4), nullptr, GL_STREAM_READ);
 		}
+	}
+
+	void TerminateRenderer() {	
+		CancelLoad();
+		CancelPrefetch();
+		FileWatcher::Shutdown();
+		ImageCache::Clear();
+		FreeImage(image);
+		glDeleteTextures(1, &placeholderTexture);
+		StagingRing::Shutdown();
+		Histogram::ShutdownGpu();
+		SimilarPixels::ShutdownGpu();
+
+		for (HistogramState& histogram : histograms)
+			histogram = {};
+
+		glDeleteTextures(1, &similarMask.Texture);
+		similarMask = {};
+		summedArea	= {};
 
-		if (type == "fragment" || type == "Fragment" || type == "pixel" || type == "Pixel") {
-			return 1;
+		for (PixelReadback& readback : readbackRing) {
+			if (readback.Fence != nullptr)
+				glDeleteSync(readback.Fence);
+
+			glDeleteBuffers(1, &readback.Buffer);
+			readback = {};
 		}
+	}
 
-		std::cout << "Invalid shader type specified";
-		return -1;
+	// half the size of the target in world units at zoom 1
+	static glm::vec2 GetViewExtent() {
+		return { static_cast<float>(targetWidth) / static_cast<float>(targetHeight), 1.0f };
 	}
 
-	unsigned int CompileShader(unsigned int glType, const char* source) {
-		unsigned int shader = glCreateShader(glType);
+	static glm::vec2 TargetToWorld(const glm::vec2& targetPos) {
+		glm::vec2 ndc = { targetPos.x / targetWidth * 2.0f - 1.0f, targetPos.y / targetHeight * 2.0f - 1.0f };
+		return viewCenter + ndc * GetViewExtent() / viewZoom;
+	}
 
-		glShaderSource(shader, 1, &source, 0);
-		glCompileShader(shader);
+	static glm::vec2 WorldToTarget(const glm::vec2& world) {
+		glm::vec2 ndc = (world - viewCenter) * viewZoom / GetViewExtent();
+		return { (ndc.x + 1.0f) * 0.5f * targetWidth, (ndc.y + 1.0f) * 0.5f * targetHeight };
+	}
 
-		GLint isCompiled = 0;
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+	// largest rect with the aspect ratio of the image that fits in the target, centered on it
+	static void FitImage() {
+		float targetAspect = static_cast<float>(targetWidth) / static_cast<float>(targetHeight);
+		float imageAspect  = static_cast<float>(image.Width) / static_cast<float>(image.Height);
 
-		if (isCompiled == GL_FALSE) {
-			GLint maxLength = 0;
-			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+		// a wider image spans the width of the target, a taller one its height
+		glm::vec2 halfSize = imageAspect > targetAspect ? glm::vec2(targetAspect, targetAspect / imageAspect) : glm::vec2(imageAspect, 1.0f);
+		imageMin = -halfSize;
+		imageMax = halfSize;
+	}
 
-			// The maxLength includes the NULL character
-			std::vector<GLchar> infoLog(maxLength);
-			glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
+	// keeps the view center on the image so it can not be panned out of sight
+	static void ClampViewCenter() {
+		viewCenter.x = glm::clamp(viewCenter.x, imageMin.x, imageMax.x);
+		viewCenter.y = glm::clamp(viewCenter.y, imageMin.y, imageMax.y);
+	}
 
-			// We don't need the shader anymore.
-			glDeleteShader(shader);
+	void ZoomView(float factor, const glm::vec2& anchor) {
+		if (image.ImageId == 0 || targetWidth == 0 || targetHeight == 0)
+			return;
 
-			std::cout << infoLog.data();
-			std::cout << "Vertex shader compilation failure!";
-			return 0;
+		// zoom that makes one source pixel cover MaxPixelsPerTexel target pixels, counted in pixels of the file for reduced decodes
+		float fitPixelsPerTexel = (imageMax.x - imageMin.x) * targetHeight * 0.5f / (image.Width * image.ScaleDenom);
+		float maxZoom = std::max(1.0f, MaxPixelsPerTexel / fitPixelsPerTexel);
+
+		// the world point under the anchor stays under it
+		glm::vec2 anchorWorld = TargetToWorld(anchor);
+		glm::vec2 anchorNdc	  = (anchorWorld - viewCenter) * viewZoom / GetViewExtent();
+
+		viewZoom   = glm::clamp(viewZoom * factor, 1.0f, maxZoom);
+		viewCenter = anchorWorld - anchorNdc * GetViewExtent() / viewZoom;
+		ClampViewCenter();
+	}
+
+	void PanView(const glm::vec2& delta) {
+		if (targetHeight == 0)
+			return;
+
+		viewCenter = viewCenter - delta / (targetHeight * 0.5f * viewZoom);
+		ClampViewCenter();
+	}
+
+	void ResetView() {
+		viewZoom   = 1.0f;
+		viewCenter = { 0.0f, 0.0f };
+	}
+
+	float GetViewZoom() {
+		return viewZoom;
+	}
+
+	void CancelLoad() {
+		ImageLoader::Cancel(loadTask);
+		loadTask.reset();
+		refining	 = false;
+		refineFailed = false;
+
+		FreeImage(pendingImage);
+		StagingRing::Free(pendingPixels.Staging);
+		pendingImage	 = {};
+		pendingPixels	 = {};
+		pendingUploadRow = 0;
+	}
+
+	LoadProgress GetLoadProgress() {
+		LoadProgress progress;
+		if (loadTask == nullptr)
+			return progress;
+
+		progress.Loading  = true;
+		progress.Refining = refining;
+		progress.Decoded = loadTask->Progress.load(std::memory_order_relaxed);
+
+		if (pendingImage.Height != 0)
+			progress.Uploaded = (float)pendingUploadRow / pendingImage.Height;
+
+		return progress;
+	}
+
+	// uploads the next rows of the pending image, returns true when the whole image is on the gpu
+	static bool ContinueUpload() {
+		uint32_t rows = pendingImage.Height - pendingUploadRow;
+
+		// a staged image is a single async copy on the gpu side, only client memory uploads are split over frames
+		if (!pendingPixels.Staging.IsValid()) {
+			size_t rowBytes = static_cast<size_t>(pendingImage.Width) * GetBytesPerPixel(pendingImage.Format);
+			rows = std::min(rows, (uint32_t)std::max<size_t>(UploadBytesPerFrame / rowBytes, 1));
 		}
 
-		return shader;
+		UploadRows(pendingImage, pendingPixels, pendingUploadRow, rows);
+		pendingUploadRow += rows;
+
+		return pendingUploadRow == pendingImage.Height;
 	}
 
-	uint32_t CreateShader(const std::string shaderSourcesArray[], uint8_t size) {
-		GLuint shader[2] = { 0 };
-		shader[0] = CompileShader(GL_VERTEX_SHADER, shaderSourcesArray[0].c_str());
-		shader[1] = CompileShader(GL_FRAGMENT_SHADER, shaderSourcesArray[1].c_str());
+	// makes the pending image the shown one once all of it is on the gpu
+	static void ShowPendingImage() {
+		FreeImage(image);
+		image		 = std::move(pendingImage);
+		imageKey	 = loadKey;
+		pendingImage = {};
+		pendingPixels	 = {};
+		pendingUploadRow = 0;
+
+		loadTask.reset();
+	}
 
-		GLuint program = glCreateProgram();
+	// an image too large to hold decoded, its stripes are uploaded as the decoder finishes them
+	static bool UpdateStreamedLoad() {
+		// read before taking the stripes, a Ready task has queued all of them by then
+		ImageLoader::LoadStatus status = loadTask->Status.load();
+
+		if (status == ImageLoader::LoadStatus::Failed || status == ImageLoader::LoadStatus::Cancelled) {
+			FreeImage(pendingImage);
+			pendingImage	 = {};
+			pendingUploadRow = 0;
+			loadTask.reset();
+			return true;
+		}
 
-		// Attach our shaders to our program
-		for (uint8_t i = 0; i < size; ++i) {
-			if (shader[i] != 0)
-				glAttachShader(program, shader[i]);
+		if (pendingImage.ImageId == 0) {
+			const ImageLoader::StreamHeader& header = loadTask->Header;
+			pendingImage.Width		= header.Width;
+			pendingImage.Height		= header.Height;
+			pendingImage.ScaleDenom = header.ScaleDenom;
+			pendingImage.Format		= header.Format;
+			pendingImage.Streamed	= true;
+			pendingImage.ImageId	= CreateImageTexture(header.Width, header.Height, header.Format);
+			pendingUploadRow		= 0;
 		}
-		// Link our program
-		glLinkProgram(program);
 
-		// Note the different functions here: glGetProgram* instead of glGetShader*.
-		GLint isLinked = 0;
-		glGetProgramiv(program, GL_LINK_STATUS, (int*)&isLinked);
-		if (isLinked == GL_FALSE)
-		{
-			GLint maxLength = 0;
-			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+		std::vector<ImageLoader::StreamedStripe> stripes;
+		ImageLoader::TakeStripes(loadTask, stripes);
 
-			// The maxLength includes the NULL character
-			std::vector<GLchar> infoLog(maxLength);
-			glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+		uint32_t type = GetTextureFormat(pendingImage.Format).Type;
 
-			// We don't need the program anymore.
-			glDeleteProgram(program);
-			// Don't leak shaders either.
-			for (uint8_t i = 0; i < size; ++i) {
-				if (shader[i] != 0)
-					glDeleteShader(shader[i]);
+		for (ImageLoader::StreamedStripe& stripe : stripes) {
+			if (stripe.Staging.IsValid()) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, StagingRing::GetBufferId());
+				glTextureSubImage2D(pendingImage.ImageId, 0, 0, stripe.FirstRow, pendingImage.Width, stripe.Rows, GL_RGBA, type, (const void*)stripe.Staging.Offset);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				StagingRing::Submit(stripe.Staging);
+			}
+			else {
+				glTextureSubImage2D(pendingImage.ImageId, 0, 0, stripe.FirstRow, pendingImage.Width, stripe.Rows, GL_RGBA, type, stripe.Pixels.GetData());
 			}
 
-			std::cout << infoLog.data();
-			std::cout << "Shader link failure!";
-			return -1;
+			pendingUploadRow += stripe.Rows;
 		}
 
-		// Always detach shaders after a successful link.
-		for (uint8_t i = 0; i < size; ++i) {
-			if (shader[i] != 0)
-				glDetachShader(program, shader[i]);
+		if (status != ImageLoader::LoadStatus::Ready || pendingUploadRow < pendingImage.Height)
+			return false;
+
+		// the result carries no pixels, the texture is all there is of a streamed image
+		ImageLoader::TakeResult(loadTask, pendingPixels);
+		ShowPendingImage();
+		return true;
+	}
+
+	// advances the running load, returns false while the image is not ready to be drawn
+	static bool UpdateLoad() {
+		if (loadTask->Streaming.load())
+			return UpdateStreamedLoad();
+
+		if (pendingImage.ImageId == 0) {
+			switch (loadTask->Status.load()) {
+				case ImageLoader::LoadStatus::Pending:
+					return false;
+
+				case ImageLoader::LoadStatus::Ready:
+					if (!ImageLoader::TakeResult(loadTask, pendingPixels))
+						return false;
+
+					if (pendingPixels.Tiled) {
+						FreeImage(image);
+						image.Width		 = pendingPixels.Width;
+						image.Height	 = pendingPixels.Height;
+						image.ScaleDenom = pendingPixels.ScaleDenom;
+						image.Format	 = pendingPixels.Format;
+						image.Streamed	 = false;
+						CreateTiledFromDecoded(image, pendingPixels);
+						imageKey = loadKey;
+
+						pendingPixels = {};
+						loadTask.reset();
+						return true;
+					}
+
+					pendingImage.Width		= pendingPixels.Width;
+					pendingImage.Height		= pendingPixels.Height;
+					pendingImage.ScaleDenom = pendingPixels.ScaleDenom;
+					pendingImage.Format		= pendingPixels.Format;
+					pendingImage.ImageId	= CreateImageTexture(pendingPixels.Width, pendingPixels.Height, pendingPixels.Format);
+					pendingUploadRow		= 0;
+					break;
+
+				case ImageLoader::LoadStatus::Failed:
+				case ImageLoader::LoadStatus::Cancelled:
+					refineFailed = refining;
+					loadTask.reset();
+					return true;
+			}
 		}
 
-		return program;
+		if (!ContinueUpload())
+			return false;
+
+		// upload finished, the pending image becomes the shown image
+		pendingImage.Pixels = std::move(pendingPixels.Pixels);
+		ApplyPixelStoreBudget(pendingImage);
+
+		ShowPendingImage();
+		return true;
 	}
 
-	uint32_t LoadShader(const std::string& filePath) {
-		std::string source;
-		std::ifstream in(filePath, std::ios::in | std::ios::binary);
+	// starts over from the shown image, running prefetches that are still wanted are kept and the others cancelled
+	static void PlanPrefetch() {
+		std::vector<Prefetch> running = std::move(prefetches);
+		prefetches.clear();
+		prefetchQueue.clear();
+
+		// nearest first, alternating between the next and the previous images
+		for (uint32_t distance = 1; distance <= prefetchDepth; ++distance) {
+			for (int offset : { (int)distance, -(int)distance }) {
+				std::string neighbour;
+				ImageCache::Key key;
+				if (!ImageDirectory::GetNeighbour(imagePath, offset, neighbour) || !ImageCache::MakeKey(neighbour, key) || ImageCache::Contains(key))
+					continue;
+
+				// a small directory wraps around onto images already planned
+				auto isKey = [&](const auto& other) { return other == key; };
+				if (std::any_of(prefetchQueue.begin(), prefetchQueue.end(), isKey) ||
+					std::any_of(prefetches.begin(), prefetches.end(), [&](const Prefetch& prefetch) { return prefetch.Key == key; }))
+					continue;
+
+				auto it = std::find_if(running.begin(), running.end(), [&](const Prefetch& prefetch) { return prefetch.Key == key; });
+				if (it != running.end()) {
+					prefetches.push_back(std::move(*it));
+					running.erase(it);
+				}
+				else {
+					prefetchQueue.push_back(key);
+				}
+			}
+		}
+
+		for (Prefetch& prefetch : running)
+			ImageLoader::Cancel(prefetch.Task);
+	}
 
-		if (in) {
-			in.seekg(0, std::ios::end);
-			size_t size = in.tellg();
+	// moves finished prefetches to the image cache and starts queued ones once the shown image is loaded
+	static void UpdatePrefetch() {
+		// one upload per frame, a burst of finished prefetches does not stall a frame
+		bool uploaded = false;
 
-			if (size != -1) {
-				source.resize(size);
-				in.seekg(0, std::ios::beg);
-				in.read(&source[0], size);
+		for (auto it = prefetches.begin(); it != prefetches.end();) {
+			ImageLoader::LoadStatus status = it->Task->Status.load();
+
+			// images too large to hold decoded are streamed into a texture, those are only loaded when opened
+			if (it->Task->Streaming.load()) {
+				ImageLoader::Cancel(it->Task);
+				it = prefetches.erase(it);
+				continue;
 			}
-			else {
-				std::cout << "Could not read from file " << filePath;
+
+			if (status == ImageLoader::LoadStatus::Pending || (status == ImageLoader::LoadStatus::Ready && uploaded)) {
+				++it;
+				continue;
 			}
+
+			ImageLoader::DecodedImage decoded;
+			if (ImageLoader::TakeResult(it->Task, decoded)) {
+				ImageCache::Insert(it->Key, CreateFromDecoded(decoded), true);
+				uploaded = true;
+			}
+
+			it = prefetches.erase(it);
+		}
+
+		// the pool runs jobs in order, a worker is left free for the next image opened
+		uint32_t maxRunning = std::max(ThreadPool::GetThreadCount(), 2u) - 1;
+
+		while (loadTask == nullptr && !prefetchQueue.empty() && prefetches.size() < maxRunning &&
+			   ImageCache::GetStats().PrefetchBytes < ImageCache::GetPrefetchBudget()) {
+			const ImageCache::Key& key = prefetchQueue.front();
+			prefetches.push_back({ key, ImageLoader::LoadAsync(key.Path, key.FileSize, key.WriteTime, targetWidth, targetHeight) });
+			prefetchQueue.erase(prefetchQueue.begin());
+		}
+	}
+
+	void CancelPrefetch() {
+		for (Prefetch& prefetch : prefetches)
+			ImageLoader::Cancel(prefetch.Task);
+
+		prefetches.clear();
+		prefetchQueue.clear();
+	}
+
+	void SetPrefetchDepth(uint32_t depth) {
+		prefetchDepth = depth;
+		if (!imageKey.Path.empty())
+			PlanPrefetch();
+	}
+
+	uint32_t GetPrefetchDepth() {
+		return prefetchDepth;
+	}
+
+	NavigationStats GetNavigationStats() {
+		NavigationStats stats = navigationStats;
+		stats.Prefetching = (uint32_t)(prefetches.size() + prefetchQueue.size());
+		return stats;
+	}
+
+	void SetImagePath(const std::string& filePath) {
+		imagePath = filePath;
+
+		// a new path cancels the running load, the shown image moves to the cache
+		CancelLoad();
+		StopPixelJobs(image.Pixels);
+
+		if (image.ImageId != 0 && !imageKey.Path.empty())
+			ImageCache::Insert(imageKey, std::move(image));
+		else
+			FreeImage(image);
+
+		image	 = {};
+		imageKey = {};
+		ResetView();
+
+		// the only file system checks for this path, later changes come from the watcher
+		if (!FileWatcher::Watch(imagePath) || !ImageCache::MakeKey(imagePath, loadKey))
+			return;
+
+		if (ImageCache::Take(loadKey, image)) {
+			imageKey = loadKey;
 		}
 		else {
-			std::cout << "Could not read from file " << filePath;
+			// a prefetch of this image that has not finished yet becomes the load
+			auto it = std::find_if(prefetches.begin(), prefetches.end(), [](const Prefetch& prefetch) { return prefetch.Key == loadKey; });
+			if (it != prefetches.end()) {
+				loadTask = std::move(it->Task);
+				prefetches.erase(it);
+			}
+			else {
+				// sized for the last target, a reduced decode shows up sooner and is refined when needed
+				loadTask = ImageLoader::LoadAsync(imagePath, loadKey.FileSize, loadKey.WriteTime, targetWidth, targetHeight);
+			}
 		}
 
-		// array of all types of sahders present in the source file
-		std::string shaderSources[2];
+		PlanPrefetch();
+	}
+
+	std::string StepImage(int offset) {
+		std::string neighbour;
+		if (imagePath.empty() || !ImageDirectory::GetNeighbour(imagePath, offset, neighbour))
+			return {};
 
-		const char* typeToken = "#type";
-		size_t typeTokenLength = strlen(typeToken);
-		size_t pos = source.find(typeToken);
+		SetImagePath(neighbour);
 
-		while (pos != std::string::npos) {
-			size_t begin = source.find_first_not_of(" \t\n\r", pos + typeTokenLength + 1);
-			if(begin == std::string::npos) std::cout << "Syntax error in the shader!";
+		++navigationStats.Steps;
+		if (image.ImageId != 0)
+			++navigationStats.ReadySteps;
 
-			size_t end = source.find_first_of(" \t\n\r", begin);
-			if(end == std::string::npos) std::cout << "Empty shader source provided!";
+		return neighbour;
+	}
+
+	// decodes the shown image again at full resolution in the background, the reduced one stays up until it is uploaded
+	static void RequestFullResolution() {
+		if (image.ScaleDenom == 1 || image.Streamed || loadTask != nullptr || refineFailed || imageKey.Path.empty())
+			return;
+
+		loadKey	 = imageKey;
+		loadTask = ImageLoader::LoadAsync(imagePath, loadKey.FileSize, loadKey.WriteTime);
+		refining = true;
+	}
 
-			std::string type = source.substr(begin, end - begin);
-			uint8_t shaderType = ShaderTypeFromString(type);
+	const ImageFrame& RenderImage(uint32_t width, uint32_t height) {
+		StagingRing::Retire();
 
-			size_t shaderStart = source.find_first_of("#version", end);
-			if(shaderStart == std::string::npos) std::cout << "Syntax error";
+		// file written or created on disk, reloading it in the background while the old image stays up
+		// a full resolution image reloads at full resolution, anything else sized for the target again
+		// a file that is gone or unreadable at this point keeps the old image until the watcher reports it again
+		ImageCache::Key changedKey;
+		if (FileWatcher::ConsumeChanged() && ImageCache::MakeKey(imagePath, changedKey)) {
+			bool fullResolution = image.ImageId != 0 && image.ScaleDenom == 1;
+
+			CancelLoad();
+			loadKey	 = changedKey;
+			loadTask = fullResolution ? ImageLoader::LoadAsync(imagePath, loadKey.FileSize, loadKey.WriteTime, 0, 0, true)
+									  : ImageLoader::LoadAsync(imagePath, loadKey.FileSize, loadKey.WriteTime, targetWidth, targetHeight, true);
+		}
+
+		bool loaded = loadTask == nullptr || UpdateLoad();
+		UpdatePrefetch();
+
+		targetWidth  = width;
+		targetHeight = height;
+
+		frame.Quads.clear();
+		frame.ImageMin	  = frame.ImageMax = { 0.0f, 0.0f };
+		frame.ImageWidth  = 0;
+		frame.ImageHeight = 0;
+		frame.ImageScaleDenom = 1;
+		frame.ImageFormat	  = PixelFormat::RGBA8;
+		frame.ImageFiltered	  = false;
+
+		if (width == 0 || height == 0)
+			return frame;
+
+		glm::vec2 targetSize((float)width, (float)height);
+
+		if (image.ImageId == 0) {
+			if (!loaded) {
+				// checker squares of 16 target pixels, the placeholder repeats
+				ImageQuad placeholder;
+				placeholder.TextureId = placeholderTexture;
+				placeholder.Max		  = targetSize;
+				placeholder.UVMax	  = targetSize / 128.0f;
+				frame.Quads.push_back(placeholder);
+			}
+
+			return frame;
+		}
 
-			pos = source.find(typeToken, shaderStart);
-			shaderSources[shaderType] = (pos == std::string::npos) ? source.substr(shaderStart) : source.substr(shaderStart, pos - shaderStart);
+		FitImage();
+		ClampViewCenter();
+
+		// navigation only moves where the image lands in the target, the texture is sampled as it is
+		frame.ImageMin	  = WorldToTarget(imageMin);
+		frame.ImageMax	  = WorldToTarget(imageMax);
+		frame.ImageWidth  = image.Width;
+		frame.ImageHeight = image.Height;
+		frame.ImageScaleDenom = image.ScaleDenom;
+		frame.ImageFormat	  = image.Format;
+		frame.ImageFiltered	  = image.Streamed && image.ScaleDenom > 1;
+
+		// a decoded pixel covers more than one target pixel (zoomed in or a larger target), the file has the detail
+		if (image.ScaleDenom > 1 && frame.ImageMax.x - frame.ImageMin.x > (float)image.Width)
+			RequestFullResolution();
+
+		glm::vec2 visibleMin = glm::max(frame.ImageMin, glm::vec2(0.0f));
+		glm::vec2 visibleMax = glm::min(frame.ImageMax, targetSize);
+		if (visibleMin.x >= visibleMax.x || visibleMin.y >= visibleMax.y)
+			return frame;
+
+		if (image.Tiles != nullptr) {
+			TileView view;
+			view.ImageMin	= frame.ImageMin;
+			view.ImageMax	= frame.ImageMax;
+			view.VisibleMin = visibleMin;
+			view.VisibleMax = visibleMax;
+
+			CollectTiles(*image.Tiles, image.Pixels, view, frame.Quads);
+			return frame;
 		}
 
-		return CreateShader(shaderSources, 2);
+		// only the visible part of the image is drawn, its uvs follow from where it lands in the target
+		// the texture holds the top row first, flipping v here replaces flipping the pixels on load
+		glm::vec2 imageSize = frame.ImageMax - frame.ImageMin;
+		glm::vec2 uvMin		= (visibleMin - frame.ImageMin) / imageSize;
+		glm::vec2 uvMax		= (visibleMax - frame.ImageMin) / imageSize;
+
+		ImageQuad quad;
+		quad.TextureId = image.ImageId;
+		quad.Min	   = visibleMin;
+		quad.Max	   = visibleMax;
+		quad.UVMin	   = { uvMin.x, 1.0f - uvMin.y };
+		quad.UVMax	   = { uvMax.x, 1.0f - uvMax.y };
+		frame.Quads.push_back(quad);
+
+		return frame;
 	}
 
-	void InitRenderer() {
-		image	  = {};
-		imagePath = "Image Path";
-		imagePath.resize(512);
+	// x and y are pixels of the shown decode, origin at the bottom left
+	static bool ReadStorePixel(uint32_t x, uint32_t y, glm::vec4& outColor) {
+		const PixelStore& pixels = image.Pixels;
+		if (!pixels.IsValid() || x >= pixels.GetWidth() || y >= pixels.GetHeight())
+			return false;
 
-		glCreateVertexArrays(1, &vertexArray);
-		glBindVertexArray(vertexArray);
+		glm::ivec2 point(x, y);
+		PixelKernels::GatherPixels(pixels, { &point, 1 }, { &outColor, 1 });
+		return true;
+	}
 
-		int size   = 4 * sizeof(QuadVertex);
-		int offset = 0;
+	// the source pixel reads are in pixels of the file, a reduced decode can not answer them
+	static bool HasSourcePixels() {
+		RequestFullResolution();
+		return image.ScaleDenom == 1;
+	}
 
-		glCreateBuffers(1, &vertexBuffer);
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	bool ReadImagePixel(uint32_t x, uint32_t y, glm::vec4& outColor) {
+		return HasSourcePixels() && ReadStorePixel(x, y, outColor);
+	}
 
-		// position (glm::vec3)
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (const void*)(uint64_t)offset);
-		offset += sizeof(glm::vec3);
+	bool ReadPixels(std::span<const glm::ivec2> points, std::span<glm::vec4> outColors) {
+		if (!HasSourcePixels() || !image.Pixels.IsValid())
+			return false;
 
-		// TextureCoords (glm::vec2)
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), (const void*)(uint64_t)offset);
+		PixelKernels::GatherPixels(image.Pixels, points, outColors);
+		return true;
+	}
 
-		uint32_t quadIndices[] = {
-			0,1,2,
-			2,3,0
-		};
+	bool ReadRegion(const PixelKernels::PixelRect& rect, PixelKernels::RegionStats& outStats, bool withMedian) {
+		if (!HasSourcePixels())
+			return false;
 
-		glCreateBuffers(1, &indexBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint32_t), quadIndices, GL_STATIC_DRAW);
+		outStats = PixelKernels::ComputeRegionStats(image.Pixels, rect, withMedian);
+		return outStats.PixelCount != 0;
+	}
 
-		quadShader = LoadShader("assets/Shaders/Quad.glsl");
+	// the rect summed pixel by pixel, while the tables are off, over their budget or not built yet
+	static bool SumRegionMean(const PixelKernels::PixelRect& rect, SummedArea::RectStats& outStats) {
+		PixelKernels::RegionStats stats = PixelKernels::ComputeRegionStats(image.Pixels, rect, false);
 
-		// required to be done only once
-		vertexData[0].TextureCoords = { 0.0f, 0.0f };
-		vertexData[1].TextureCoords = { 1.0f, 0.0f };
-		vertexData[2].TextureCoords = { 1.0f, 1.0f };
-		vertexData[3].TextureCoords = { 0.0f, 1.0f };
+		outStats.PixelCount = stats.PixelCount;
+		outStats.Mean		= glm::vec3(stats.Mean);
+		outStats.StdDev		= glm::vec3(stats.StdDev);
+		outStats.Variance	= outStats.StdDev * outStats.StdDev;
+		return outStats.PixelCount != 0;
+	}
 
-		// created temporary frameBuffer
-		CreateFrameBuffer(1200, 800, frameBuffer, frameColorBuffer);
+	static size_t GetSummedAreaBudget() {
+		return pixelStoreBudget != 0 ? std::min(pixelStoreBudget, MaxSummedAreaBytes) : MaxSummedAreaBytes;
 	}
 
-	void TerminateRenderer() {	
-		FreeImage(image);
-		InvalidateFrameBuffers(frameBuffer, frameColorBuffer);
+	// the tables of the shown image with the current settings have been built (or ran out of memory)
+	static bool HasCurrentSummedArea() {
+		const SummedAreaState& state = summedArea;
+		return state.Valid && state.Key == imageKey && state.ImageId == image.ImageId && state.Width == image.Pixels.GetWidth() && state.Height == image.Pixels.GetHeight() && state.WithSquares == summedAreaSquares;
+	}
+
+	static void BuildSummedArea(SummedAreaJob& job) {
+		if (!StartPixelJob(job))
+			return;
+
+		auto start = std::chrono::steady_clock::now();
+		SummedArea::Build(*job.Pixels, job.WithSquares, job.Table);
+		job.BuildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-		glDeleteProgram(quadShader);
-		glDeleteBuffers(1, &vertexBuffer);
-		glDeleteBuffers(1, &indexBuffer);
-		glDeleteVertexArrays(1, &vertexArray);
+		FinishPixelJob(job);
 	}
 
-	int RenderImage(uint32_t width, uint32_t height, const std::string& filePath) {
-		if (!std::filesystem::exists(filePath)) {
-			return -1;
-		}
+	// collects a finished build and starts one for the shown image if its tables are missing and fit the budget
+	static void UpdateSummedArea() {
+		SummedAreaState& state = summedArea;
+
+		if (state.Job != nullptr && state.Job->State == PixelJob::Done) {
+			SummedAreaJob& job = *state.Job;
+
+			// tables turned off meanwhile are dropped
+			if (summedAreaEnabled) {
+				state.Valid		  = true;
+				state.Key		  = job.Key;
+				state.ImageId	  = job.ImageId;
+				state.Width		  = job.Pixels->GetWidth();
+				state.Height	  = job.Pixels->GetHeight();
+				state.WithSquares = job.WithSquares;
+				state.Table		  = std::move(job.Table);
+				state.BuildMs	  = job.BuildMs;
+			}
 
-		// if the file path is same and there is no change in width and height of the target
-		// no need to render the image again
-		if (filePath == imagePath && (targetWidth == width && targetHeight == height)) {
-			return frameColorBuffer;
+			state.Job.reset();
 		}
 
-		imagePath = filePath;
+		if (!summedAreaEnabled || state.Job != nullptr || HasCurrentSummedArea())
+			return;
+
+		if (SummedArea::EstimateBytes(image.Pixels.GetWidth(), image.Pixels.GetHeight(), image.Pixels.GetFormat(), summedAreaSquares) > GetSummedAreaBudget())
+			return;
 
-		if (targetWidth != width || targetHeight != height) {
-			targetWidth  = width;
-			targetHeight = height;
+		// the tables of the previous image go first, both would not fit where memory is short
+		state.Valid = false;
+		state.Table = {};
+
+		state.Job = std::make_shared<SummedAreaJob>();
+		SummedAreaJob& job = *state.Job;
+		job.Pixels		= &image.Pixels;
+		job.Key			= imageKey;
+		job.ImageId		= image.ImageId;
+		job.WithSquares = summedAreaSquares;
+
+		ThreadPool::Submit([handle = state.Job] { BuildSummedArea(*handle); });
+	}
 
-			// deleting previous buffer and creating a new one
-			InvalidateFrameBuffers(frameBuffer, frameColorBuffer);
-			CreateFrameBuffer(targetWidth, targetHeight, frameBuffer, frameColorBuffer);
-			glViewport(0, 0, targetWidth, targetHeight);
+	bool ReadRegionMean(const PixelKernels::PixelRect& rect, SummedArea::RectStats& outStats) {
+		outStats = {};
+		if (image.ImageId == 0 || !image.Pixels.IsValid())
+			return false;
+
+		UpdateSummedArea();
+		if (!summedAreaEnabled || !HasCurrentSummedArea() || !summedArea.Table.IsValid())
+			return SumRegionMean(rect, outStats);
+
+		outStats = SummedArea::Query(summedArea.Table, rect);
+		return outStats.PixelCount != 0;
+	}
+
+	void SetSummedAreaTables(bool enabled, bool withSquares) {
+		summedAreaEnabled = enabled;
+		summedAreaSquares = withSquares;
+
+		// a running build keeps reading the pixels, it stays in the state until the next read drops it
+		if (!enabled) {
+			summedArea.Valid = false;
+			summedArea.Table = {};
 		}
+	}
 
-		float aspectRatio = static_cast<float>(width) / static_cast<float>(height);
-		projectionMat	  = glm::ortho(-aspectRatio, aspectRatio, -1.0f, 1.0f, -1.0f, 1.0f);
+	SummedAreaStats GetSummedAreaStats() {
+		SummedAreaStats stats;
+		stats.Enabled = summedAreaEnabled;
+		stats.Budget  = GetSummedAreaBudget();
 
-		// free the last image
-		FreeImage(image);
-		image = LoadImage(filePath);
+		if (image.ImageId == 0 || !image.Pixels.IsValid())
+			return stats;
 
-		float widthBegin, widthEnd;
-		float heightBegin, heightEnd;
+		stats.EstimatedBytes = SummedArea::EstimateBytes(image.Pixels.GetWidth(), image.Pixels.GetHeight(), image.Pixels.GetFormat(), summedAreaSquares);
+		stats.OverBudget	 = stats.EstimatedBytes > stats.Budget;
 
-		// decide whether to draw image with max width or max height
-		if (image.Width > image.Height) {
-			widthBegin  = -aspectRatio;
-			widthEnd    = aspectRatio;
-			heightBegin = -1.0f;			// TO DO: correct the calculation according to the width		
-			heightEnd   = 1.0f;				// TO DO: correct the calculation according to the width
+		if (HasCurrentSummedArea()) {
+			stats.Built		 = summedArea.Table.IsValid();
+			stats.OutOfMemory = !stats.Built;
+			stats.Bytes		 = summedArea.Table.GetSizeInBytes();
+			stats.BuildMs	 = summedArea.BuildMs;
 		}
 		else {
-			widthBegin  = -aspectRatio;	// TO DO: correct the calculation according to the height		
-			widthEnd    = aspectRatio;	// TO DO: correct the calculation according to the height		
-			heightBegin = -1.0f;
-			heightEnd   = 1.0f;
+			stats.Building = summedArea.Job != nullptr;
+		}
+
+		return stats;
+	}
+
+	bool ExtractPalette(const Palette::Options& options, Palette::Result& outResult) {
+		if (image.ImageId == 0 || !image.Pixels.IsValid())
+			return false;
+
+		outResult = Palette::Extract(image.Pixels, options);
+		return true;
+	}
+
+	// decoded pixels inside the target, origin at the bottom left of the image
+	static PixelKernels::PixelRect GetVisibleRect() {
+		if (targetWidth == 0 || targetHeight == 0)
+			return {};
+
+		glm::vec2 size = imageMax - imageMin;
+		glm::vec2 low  = (TargetToWorld({ 0.0f, 0.0f }) - imageMin) / size;
+		glm::vec2 high = (TargetToWorld({ (float)targetWidth, (float)targetHeight }) - imageMin) / size;
+
+		uint32_t minX = (uint32_t)(std::clamp(low.x, 0.0f, 1.0f) * image.Width);
+		uint32_t minY = (uint32_t)(std::clamp(low.y, 0.0f, 1.0f) * image.Height);
+		uint32_t maxX = (uint32_t)std::ceil(std::clamp(high.x, 0.0f, 1.0f) * image.Width);
+		uint32_t maxY = (uint32_t)std::ceil(std::clamp(high.y, 0.0f, 1.0f) * image.Height);
+
+		return { minX, minY, maxX - minX, maxY - minY };
+	}
+
+	const Histogram::Counts* GetHistogram(bool visibleOnly, HistogramBackend backend) {
+		if (image.ImageId == 0 || image.Width == 0 || image.Height == 0)
+			return nullptr;
+
+		if (image.Tiles != nullptr || !Histogram::IsGpuAvailable())
+			backend = HistogramBackend::Cpu;
+		else if (!image.Pixels.IsValid())
+			backend = HistogramBackend::Gpu;
+
+		if (backend == HistogramBackend::Cpu && !image.Pixels.IsValid())
+			return nullptr;
+
+		HistogramState&			histogram = histograms[visibleOnly ? 1 : 0];
+		PixelKernels::PixelRect rect	  = visibleOnly ? GetVisibleRect() : PixelKernels::PixelRect{ 0, 0, image.Width, image.Height };
+
+		bool sameImage = histogram.Valid && histogram.Key == imageKey && histogram.ImageId == image.ImageId && histogram.Width == image.Width && histogram.Height == image.Height;
+		bool sameRect  = histogram.Rect.X == rect.X && histogram.Rect.Y == rect.Y && histogram.Rect.Width == rect.Width && histogram.Rect.Height == rect.Height;
+
+		if (sameImage && sameRect && histogram.Backend == backend)
+			return &histogram.Counts;
+
+		if (backend == HistogramBackend::Gpu)
+			Histogram::ComputeGpu(image.ImageId, image.Width, image.Height, rect, histogram.Counts);
+		else if (sameImage && histogram.Backend == HistogramBackend::Cpu)
+			Histogram::MoveCpu(image.Pixels, histogram.Rect, rect, histogram.Counts);
+		else
+			histogram.Counts = Histogram::ComputeCpu(image.Pixels, rect);
+
+		histogram.Valid	  = true;
+		histogram.Key	  = imageKey;
+		histogram.ImageId = image.ImageId;
+		histogram.Width	  = image.Width;
+		histogram.Height  = image.Height;
+		histogram.Backend = backend;
+		histogram.Rect	  = rect;
+		return &histogram.Counts;
+	}
+
+	static void RunSimilarMaskJob(SimilarMaskJob& job) {
+		if (!StartPixelJob(job))
+			return;
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (job.NewTarget)
+			SimilarPixels::ComputeDistances(*job.Pixels, job.TargetLab, job.Distances);
+
+		job.PixelCount = SimilarPixels::ComputeMask(job.Distances, job.Threshold, job.Mask);
+		job.UpdateMs   = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		FinishPixelJob(job);
+	}
+
+	// uploads the mask of a finished job and keeps its distances for the next threshold
+	static void CollectSimilarMaskJob() {
+		SimilarMaskState& state = similarMask;
+		SimilarMaskJob& job = *state.Job;
+
+		state.Distances	 = std::move(job.Distances);
+		state.Mask		 = std::move(job.Mask);
+		state.PixelCount = job.PixelCount;
+		state.UpdateMs	 = job.UpdateMs;
+
+		if (state.Texture == 0 || state.TextureWidth != state.Distances.Width || state.TextureHeight != state.Distances.Height) {
+			glDeleteTextures(1, &state.Texture);
+			glCreateTextures(GL_TEXTURE_2D, 1, &state.Texture);
+			glTextureStorage2D(state.Texture, 1, GL_R8, state.Distances.Width, state.Distances.Height);
+
+			// the overlay samples it at display resolution, each mask pixel stays a hard edged square
+			glTextureParameteri(state.Texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTextureParameteri(state.Texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTextureParameteri(state.Texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(state.Texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			state.TextureWidth	= state.Distances.Width;
+			state.TextureHeight = state.Distances.Height;
 		}
 
-		vertexData[0].Position = { widthBegin, heightBegin, 0.0f };
-		vertexData[1].Position = { widthEnd,   heightBegin, 0.0f };
-		vertexData[2].Position = { widthEnd,   heightEnd,   0.0f };
-		vertexData[3].Position = { widthBegin, heightEnd,   0.0f };
+		// rows of one byte pixels are not 4 byte aligned
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTextureSubImage2D(state.Texture, 0, 0, 0, state.TextureWidth, state.TextureHeight, GL_RED, GL_UNSIGNED_BYTE, state.Mask.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		state.Valid		= true;
+		state.Key		= job.Key;
+		state.ImageId	= job.ImageId;
+		state.TargetLab = job.TargetLab;
+		state.Threshold = job.Threshold;
+
+		state.Job.reset();
+	}
+
+	SimilarPixelMask GetSimilarPixelMask(const glm::vec3& targetLab, float threshold) {
+		if (image.ImageId == 0 || image.Tiles != nullptr || !image.Pixels.IsValid())
+			return {};
+
+		SimilarMaskState& state = similarMask;
+		if (state.Job != nullptr && state.Job->State == PixelJob::Done)
+			CollectSimilarMaskJob();
+
+		bool sameImage	= state.Valid && state.Key == imageKey && state.ImageId == image.ImageId && state.TextureWidth == image.Pixels.GetWidth() && state.TextureHeight == image.Pixels.GetHeight();
+		bool sameTarget = sameImage && state.TargetLab.x == targetLab.x && state.TargetLab.y == targetLab.y && state.TargetLab.z == targetLab.z;
+
+		// one job at a time, a color or threshold that changed meanwhile is started once the running job is collected
+		if (!(sameTarget && state.Threshold == threshold) && state.Job == nullptr) {
+			state.Job = std::make_shared<SimilarMaskJob>();
+			SimilarMaskJob& job = *state.Job;
+			job.Pixels	  = &image.Pixels;
+			job.Key		  = imageKey;
+			job.ImageId	  = image.ImageId;
+			job.TargetLab = targetLab;
+			job.Threshold = threshold;
+			job.NewTarget = !sameTarget;
+
+			// the buffers are reused, only the mask is compared again for a new threshold
+			job.Distances = std::move(state.Distances);
+			job.Mask	  = std::move(state.Mask);
+
+			ThreadPool::Submit([handle = state.Job] { RunSimilarMaskJob(*handle); });
+		}
 
-		glBindVertexArray(vertexArray);
+		SimilarPixelMask mask;
+		mask.Pending = state.Job != nullptr;
 
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, 4 * sizeof(QuadVertex), vertexData);
+		if (sameImage) {
+			mask.Texture	= state.Texture;
+			mask.PixelCount = state.PixelCount;
+			mask.UpdateMs	= state.UpdateMs;
+		}
 
-		// slot for image texture
-		int texSlot = 0;
+		return mask;
+	}
 
-		glUseProgram(quadShader);
-		glUniformMatrix4fv(glGetUniformLocation(quadShader, "u_ViewProjection"), 1, GL_FALSE, glm::value_ptr(projectionMat));
-		glUniform1iv(glGetUniformLocation(quadShader, "u_ImageTexSlot"), 1, &texSlot);	
+	// maps a pixel of the target through the drawn quad to a pixel of the source image
+	static bool TargetToImage(int x, int y, uint32_t& outX, uint32_t& outY) {
+		if (targetWidth == 0 || targetHeight == 0 || image.Width == 0 || image.Height == 0)
+			return false;
 
-		glBindTextureUnit(texSlot, image.ImageId);
+		glm::vec2 world = TargetToWorld({ (float)x + 0.5f, (float)y + 0.5f });
 
-		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		float u = (world.x - imageMin.x) / (imageMax.x - imageMin.x);
+		float v = (world.y - imageMin.y) / (imageMax.y - imageMin.y);
 
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (u < 0.0f || v < 0.0f || u >= 1.0f || v >= 1.0f)
+			return false;
 
-		// return the color buffer id of the framebuffer
-		return frameColorBuffer;
+		outX = (uint32_t)(u * image.Width);
+		outY = (uint32_t)(v * image.Height);
+		return true;
 	}
 
 	glm::vec4 ReadPixel(int x, int y) {
-		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
-		glReadBuffer(GL_COLOR_ATTACHMENT0);
-		GLubyte pixels[4];
-		glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		return { (float)pixels[0] / 255, (float)pixels[1] / 255, (float)pixels[2] / 255, (float)pixels[3] / 255 };
+		// nothing drawn yet (loading or failed) and points outside the drawn image read as transparent black
+		glm::vec4 color(0.0f);
+		uint32_t imageX, imageY;
+
+		if (image.ImageId == 0 || !TargetToImage(x, y, imageX, imageY))
+			return color;
+
+		// a pick wants the pixels of the file, the reduced decode answers until they have arrived
+		RequestFullResolution();
+
+		if (ReadStorePixel(imageX, imageY, color))
+			return color;
+
+		// no cpu copy of the image (over budget or streamed), reading the texel back from the texture as floats so no format loses bits
+		// a streamed image filtered down has only the averaged texels
+		glGetTextureSubImage(image.ImageId, 0, imageX, image.Height - 1 - imageY, 0, 1, 1, 1, GL_RGBA, GL_FLOAT, sizeof(color), &color.x);
+		return color;
+	}
+
+	void UpdatePixelReadbacks() {
+		++readbackFrame;
+
+		// retiring finished reads in request order, stopping at the first one still in flight
+		for (uint32_t i = 0; i < ReadbackRingSize; ++i) {
+			PixelReadback& readback = readbackRing[readbackOldest];
+			if (readback.Fence == nullptr)
+				break;
+
+			GLenum status = glClientWaitSync(readback.Fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+				break;
+
+			glGetNamedBufferSubData(readback.Buffer, 0, sizeof(hoverColor), &hoverColor.x);
+			glDeleteSync(readback.Fence);
+			readback.Fence = nullptr;
+
+			hoverLatency = (uint32_t)(readbackFrame - readback.RequestFrame);
+			hoverValid	 = true;
+
+			readbackOldest = (readbackOldest + 1) % ReadbackRingSize;
+		}
+	}
+
+	void RequestHoverPixel(int x, int y) {
+		if (image.ImageId == 0)
+			return;
+
+		// with a cpu copy there is nothing to wait for
+		if (image.Pixels.IsValid()) {
+			hoverColor	 = ReadPixel(x, y);
+			hoverLatency = 0;
+			hoverValid	 = true;
+			return;
+		}
+
+		uint32_t imageX, imageY;
+		if (!TargetToImage(x, y, imageX, imageY))
+			return;
+
+		RequestFullResolution();
+
+		// every slot is still in flight, dropping this request instead of stalling
+		PixelReadback& readback = readbackRing[readbackNext];
+		if (readback.Fence != nullptr)
+			return;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.Buffer);
+		glGetTextureSubImage(image.ImageId, 0, imageX, image.Height - 1 - imageY, 0, 1, 1, 1, GL_RGBA, GL_FLOAT, sizeof(glm::vec4), nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		readback.Fence		  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		readback.RequestFrame = readbackFrame;
+		readbackNext = (readbackNext + 1) % ReadbackRingSize;
+	}
+
+	bool GetHoverPixel(glm::vec4& outColor, uint32_t& outLatencyFrames) {
+		if (!hoverValid)
+			return false;
+
+		outColor		 = hoverColor;
+		outLatencyFrames = hoverLatency;
+		return true;
 	}
 
 }
@@ -6,24 +6,118 @@
 #include "glm/ext.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include "PixelStore.h"
+#include "PixelKernels.h"
+#include "Palette.h"
+#include "Histogram.h"
+#include "SummedArea.h"
+#include "TiledImage.h"
+
+#include <memory>
+#include <span>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace Renderer {
 
 	struct Image {
 		uint32_t Width = 0;
 		uint32_t Height = 0;
-		uint32_t ImageId = 0;
+		uint32_t ImageId = 0;		// gl texture, a texture array of resident tiles for tiled images
+		uint32_t ScaleDenom = 1;	// decoded at 1/ScaleDenom of the file's width and height, 1 is full resolution
+		PixelFormat Format = PixelFormat::RGBA8;
+		bool Streamed = false;		// decoded in stripes straight into the texture, there is no full resolution decode to refine to
+
+		// cpu copy of the pixels, empty if the image did not fit in the pixel store budget
+		PixelStore Pixels;
+
+		// set for images too large for a single texture
+		std::unique_ptr<TiledImage> Tiles;
 	};
 
-	struct QuadVertex {
-		glm::vec3 Position;
-		glm::vec2 TextureCoords;
+	// gl texture format for the pixels of a format, float images are stored as half floats on the gpu
+	struct TextureFormat {
+		uint32_t InternalFormat = 0;
+		uint32_t Type			= 0;		// of the pixels uploaded from a PixelStore
+		uint32_t BytesPerPixel	= 0;		// in vram
+	};
+
+	TextureFormat GetTextureFormat(PixelFormat format);
+
+	struct LoadProgress {
+		bool  Loading  = false;
+		float Decoded  = 0.0f;		// fraction of the file read by the decoder
+		float Uploaded = 0.0f;		// fraction of the rows uploaded to the texture
+		bool  Refining = false;		// full resolution decode of the shown image, which stays up meanwhile
 	};
 
+	// steps through the directory of the image and how many of them found it decoded and uploaded already
+	struct NavigationStats {
+		uint64_t Steps		 = 0;
+		uint64_t ReadySteps	 = 0;
+		uint32_t Prefetching = 0;		// decodes of neighbouring images running or waiting to start
+	};
+
+	// memory and build time of the summed-area tables behind ReadRegionMean
+	struct SummedAreaStats {
+		bool   Enabled		  = false;
+		bool   Built		  = false;		// for the shown image
+		bool   Building		  = false;		// on the thread pool, rects are summed directly meanwhile
+		bool   OverBudget	  = false;		// the shown image's tables would take more than Budget and are not built
+		bool   OutOfMemory	  = false;		// the build could not allocate the tables
+		size_t Bytes		  = 0;			// of the built tables
+		size_t EstimatedBytes = 0;			// what tables of the shown image would take with the current settings
+		size_t Budget		  = 0;
+		float  BuildMs		  = 0.0f;
+	};
+
+	// cpu mask of the pixels similar to a picked color, see GetSimilarPixelMask
+	struct SimilarPixelMask {
+		uint32_t Texture	= 0;		// r8, 0 until a mask of the shown image is done
+		uint64_t PixelCount = 0;
+		float	 UpdateMs	= 0.0f;		// time the thread pool took for the mask in Texture
+		bool	 Pending	= false;	// a mask of a newer color or threshold is being made, Texture still holds the previous one
+	};
+
+	enum class HistogramBackend {
+		Cpu,
+		Gpu
+	};
+
+	// textured rect for the ui to draw, the ui samples the source textures directly
+	struct ImageQuad {
+		uint32_t  TextureId = 0;
+		glm::vec2 Min		= { 0.0f, 0.0f };		// target pixels, origin at the bottom left
+		glm::vec2 Max		= { 0.0f, 0.0f };
+		glm::vec2 UVMin		= { 0.0f, 0.0f };		// uvs at the Min and Max corners, image textures hold the top row first
+		glm::vec2 UVMax		= { 0.0f, 0.0f };		// so their v runs downwards (UVMin.y > UVMax.y)
+	};
+
+	// what to show in the target this frame
+	struct ImageFrame {
+		std::vector<ImageQuad> Quads;		// drawn in order, empty if there is nothing to show
+
+		// the whole image in target pixels (may reach outside the target), empty while a placeholder is shown
+		glm::vec2 ImageMin	  = { 0.0f, 0.0f };
+		glm::vec2 ImageMax	  = { 0.0f, 0.0f };
+		uint32_t  ImageWidth  = 0;		// decoded pixels, the file has ImageScaleDenom times as many per side
+		uint32_t  ImageHeight = 0;
+		uint32_t  ImageScaleDenom = 1;
+		PixelFormat ImageFormat	  = PixelFormat::RGBA8;
+
+		// streamed and box filtered down by ImageScaleDenom, there is no full resolution decode to refine to
+		// and picks read the average of ImageScaleDenom x ImageScaleDenom file pixels
+		bool ImageFiltered = false;
+	};
+
+	// decodes and uploads the image on the calling thread
 	Image LoadImage(const std::string& filePath);
 	
+	// compiles a shader file holding "#type" separated vertex and fragment sources, or a single compute one
+	// returns 0 (no gl program) if the file can not be read, parsed, compiled or linked
+	uint32_t LoadShader(const std::string& filePath);
+
 	// explicitly use this to free the image data
 	void FreeImage(Image& image);
 
@@ -33,9 +127,104 @@ namespace Renderer {
 	// must call this after the end of renderer use
 	void TerminateRenderer();
 
-	// returns the id (in the gpu) of the drawn image
-	int RenderImage(uint32_t imageWidth, uint32_t imageHeight, const std::string& filePath);
+	// call only when the path changes, checks the file once and starts loading it in the background
+	// the file is then watched and reloaded when it changes on disk
+	// the images next to it in its directory are prefetched into the image cache (see SetPrefetchDepth)
+	void SetImagePath(const std::string& filePath);
 
+	// opens the image offset files away in the directory of the current one (1 next, -1 previous, file name order
+	// wrapping around), returns its path or an empty string if the directory holds no other image
+	std::string StepImage(int offset);
+
+	// how many images after and before the shown one are decoded ahead, up to the image cache's prefetch budget
+	void SetPrefetchDepth(uint32_t depth);
+	uint32_t GetPrefetchDepth();
+
+	// stops every prefetch, call before the thread pool is shut down
+	void CancelPrefetch();
+
+	NavigationStats GetNavigationStats();
+
+	// fits the image into a target of the given size and returns the quads showing it, nothing is drawn here
+	// a placeholder quad is returned while a new image is loading, no file system access is done here
+	// jpegs are first decoded at the smallest 1/2, 1/4 or 1/8 scale that covers the target and refined to
+	// full resolution in the background once the view magnifies the decoded pixels
+	const ImageFrame& RenderImage(uint32_t targetWidth, uint32_t targetHeight);
+
+	// navigation of the drawn image, only changes the view transform (no decode or upload)
+	// factor multiplies the zoom (clamped between the fitted image and 64 target pixels per source pixel),
+	// anchor and delta are in target pixels with the origin at the bottom left
+	void ZoomView(float factor, const glm::vec2& anchor);
+	void PanView(const glm::vec2& delta);
+	void ResetView();
+	float GetViewZoom();
+
+	// progress of the image started by RenderImage
+	LoadProgress GetLoadProgress();
+
+	// stops the image load started by RenderImage, if any
+	void CancelLoad();
+
+	// max bytes a single image may keep in its cpu pixel store, 0 means no limit
+	void SetPixelStoreBudget(size_t bytes);
+	size_t GetPixelStoreBudget();
+
+	// x and y are in the drawn image space (origin at bottom left of the target),
+	// mapped to the source pixel under them so the color is exact at any zoom, 16 bit and hdr images keep their precision
+	// picking a reduced decode starts the full resolution one, its pixels answer until that has arrived
+	// except on streamed images filtered down to fit a texture (ImageFrame::ImageFiltered), their picks stay averages
 	glm::vec4 ReadPixel(int x, int y);
 
+	// call once per frame, collects hover reads that the gpu has finished
+	void UpdatePixelReadbacks();
+
+	// queues a read of the pixel under the cursor (target space) without blocking on the gpu,
+	// the result shows up in GetHoverPixel a frame or two later (immediately if the image has a cpu pixel store)
+	void RequestHoverPixel(int x, int y);
+
+	// latest finished hover read and how many frames it took, false until one has arrived
+	bool GetHoverPixel(glm::vec4& outColor, uint32_t& outLatencyFrames);
+
+	// x and y are in source image pixels (origin at bottom left of the image), needs no gl context
+	// returns false if the point is outside the image or the image has no cpu pixel store, and while
+	// a reduced decode is shown (the full resolution one is started, the same holds for the batch reads below)
+	bool ReadImagePixel(uint32_t x, uint32_t y, glm::vec4& outColor);
+
+	// batch version of ReadImagePixel, outColors gets one color per point (transparent black outside the image)
+	// returns false if the image has no cpu pixel store
+	bool ReadPixels(std::span<const glm::ivec2> points, std::span<glm::vec4> outColors);
+
+	// mean, min, max, median and standard deviation of a rect of source pixels, clipped to the image
+	// returns false if the image has no cpu pixel store or the rect misses the image
+	bool ReadRegion(const PixelKernels::PixelRect& rect, PixelKernels::RegionStats& outStats, bool withMedian = true);
+
+	// rgb mean and variance of a rect of the decoded pixels (origin at the bottom left, clipped to the image) in constant time
+	// from summed-area tables, the first read of a newly shown image starts building them on the thread pool (see SummedArea)
+	// the rect is summed directly while they are building, with the tables off, and for images whose tables would take
+	// more than 1 GB (or the pixel store budget if that is lower) or could not be allocated
+	// returns false if the image has no cpu pixel store or the rect misses it
+	bool ReadRegionMean(const PixelKernels::PixelRect& rect, SummedArea::RectStats& outStats);
+
+	// off frees the tables and leaves ReadRegionMean summing each rect, without squares the tables take about half
+	// the memory and give no variance
+	void SetSummedAreaTables(bool enabled, bool withSquares);
+	SummedAreaStats GetSummedAreaStats();
+
+	// dominant colors of the shown image, blocks while the thread pool helps (see Palette::Extract)
+	// a reduced decode is used as it is, its colors are those of the file, returns false if the image has no cpu pixel store
+	bool ExtractPalette(const Palette::Options& options, Palette::Result& outResult);
+
+	// red, green, blue and luma histograms of the shown image in the pixels it was decoded to, all of it or the part inside the target
+	// kept between frames and only counted again when the image, the view (for the visible part) or the backend changes,
+	// a pan with the cpu backend only counts the pixels that scrolled in and out
+	// tiled images (no single texture) always use the cpu backend and images without a cpu pixel store the gpu one, nullptr without an image
+	const Histogram::Counts* GetHistogram(bool visibleOnly, HistogramBackend backend);
+
+	// r8 texture the size of the decoded image marking its pixels within threshold delta e of targetLab, made on the cpu
+	// (see SimilarPixels) by a thread pool job, the previous mask is returned until the job is done and uploaded
+	// the distances are kept while the image and targetLab stay the same so a new threshold only compares them
+	// no texture for images without a cpu pixel store and tiled ones (too large for a single texture)
+	// call before the texture is handed to a draw, a mask of another size replaces the previous texture
+	SimilarPixelMask GetSimilarPixelMask(const glm::vec3& targetLab, float threshold);
+
 }
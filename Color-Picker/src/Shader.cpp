@@ -0,0 +1,179 @@
+
+
+#include "glad/glad.h"
+
+#include "Renderer.h"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+// shader files are read and built apart from the rest of the renderer, the benchmark builds them without it
+namespace Renderer {
+
+	int ShaderTypeFromString(const std::string& type) {
+		if (type == "vertex" || type == "Vertex") {
+			return 0;
+		}
+
+		if (type == "fragment" || type == "Fragment" || type == "pixel" || type == "Pixel") {
+			return 1;
+		}
+
+		if (type == "compute" || type == "Compute") {
+			return 2;
+		}
+
+		std::cout << "Invalid shader type specified";
+		return -1;
+	}
+
+	unsigned int CompileShader(unsigned int glType, const char* source) {
+		unsigned int shader = glCreateShader(glType);
+
+		glShaderSource(shader, 1, &source, 0);
+		glCompileShader(shader);
+
+		GLint isCompiled = 0;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+
+		if (isCompiled == GL_FALSE) {
+			GLint maxLength = 0;
+			glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+
+			// The maxLength includes the NULL character
+			std::vector<GLchar> infoLog(maxLength);
+			glGetShaderInfoLog(shader, maxLength, &maxLength, &infoLog[0]);
+
+			// We don't need the shader anymore.
+			glDeleteShader(shader);
+
+			const char* stage = glType == GL_VERTEX_SHADER ? "Vertex" : glType == GL_FRAGMENT_SHADER ? "Fragment" : "Compute";
+			std::cout << infoLog.data();
+			std::cout << stage << " shader compilation failure!";
+			return 0;
+		}
+
+		return shader;
+	}
+
+	uint32_t CreateShader(const std::string shaderSourcesArray[], uint8_t size) {
+		// indexed by ShaderTypeFromString, a compute shader file holds no vertex or fragment source
+		const GLenum glTypes[3] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER };
+		GLuint shader[3] = { 0 };
+
+		for (uint8_t i = 0; i < size; ++i) {
+			if (!shaderSourcesArray[i].empty())
+				shader[i] = CompileShader(glTypes[i], shaderSourcesArray[i].c_str());
+		}
+
+		GLuint program = glCreateProgram();
+
+		// Attach our shaders to our program
+		for (uint8_t i = 0; i < size; ++i) {
+			if (shader[i] != 0)
+				glAttachShader(program, shader[i]);
+		}
+		// Link our program
+		glLinkProgram(program);
+
+		// Note the different functions here: glGetProgram* instead of glGetShader*.
+		GLint isLinked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, (int*)&isLinked);
+		if (isLinked == GL_FALSE)
+		{
+			GLint maxLength = 0;
+			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
+
+			// The maxLength includes the NULL character
+			std::vector<GLchar> infoLog(maxLength);
+			glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
+
+			// We don't need the program anymore.
+			glDeleteProgram(program);
+			// Don't leak shaders either.
+			for (uint8_t i = 0; i < size; ++i) {
+				if (shader[i] != 0)
+					glDeleteShader(shader[i]);
+			}
+
+			std::cout << infoLog.data();
+			std::cout << "Shader link failure!";
+			return 0;
+		}
+
+		// Always detach shaders after a successful link.
+		for (uint8_t i = 0; i < size; ++i) {
+			if (shader[i] != 0)
+				glDetachShader(program, shader[i]);
+		}
+
+		return program;
+	}
+
+	uint32_t LoadShader(const std::string& filePath) {
+		std::string source;
+		std::ifstream in(filePath, std::ios::in | std::ios::binary);
+
+		if (in) {
+			in.seekg(0, std::ios::end);
+			std::streamoff size = in.tellg();
+
+			if (size != -1) {
+				source.resize(size);
+				in.seekg(0, std::ios::beg);
+				in.read(&source[0], size);
+			}
+			else {
+				std::cout << "Could not read from file " << filePath;
+				return 0;
+			}
+		}
+		else {
+			std::cout << "Could not read from file " << filePath;
+			return 0;
+		}
+
+		// array of all types of sahders present in the source file
+		std::string shaderSources[3];
+
+		const char* typeToken = "#type";
+		size_t typeTokenLength = strlen(typeToken);
+		size_t pos = source.find(typeToken);
+
+		while (pos != std::string::npos) {
+			size_t begin = source.find_first_not_of(" \t\n\r", pos + typeTokenLength + 1);
+			if (begin == std::string::npos) {
+				std::cout << "Syntax error in the shader!";
+				return 0;
+			}
+
+			size_t end = source.find_first_of(" \t\n\r", begin);
+			if (end == std::string::npos) {
+				std::cout << "Empty shader source provided!";
+				return 0;
+			}
+
+			std::string type = source.substr(begin, end - begin);
+			int shaderType = ShaderTypeFromString(type);
+
+			// an unknown type would index past shaderSources, the file is rejected like one that does not link
+			if (shaderType < 0) {
+				std::cout << " \"" << type << "\" in " << filePath;
+				return 0;
+			}
+
+			size_t shaderStart = source.find_first_of("#version", end);
+			if (shaderStart == std::string::npos) {
+				std::cout << "Syntax error";
+				return 0;
+			}
+
+			pos = source.find(typeToken, shaderStart);
+			shaderSources[shaderType] = (pos == std::string::npos) ? source.substr(shaderStart) : source.substr(shaderStart, pos - shaderStart);
+		}
+
+		return CreateShader(shaderSources, 3);
+	}
+
+}
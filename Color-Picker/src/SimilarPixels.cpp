@@ -0,0 +1,273 @@
+
+
+#include "glad/glad.h"
+
+#include "SimilarPixels.h"
+#include "ColorSpace.h"
+#include "ThreadPool.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#define SIMILAR_PIXELS_SSE2
+	#include <emmintrin.h>
+#endif
+
+namespace SimilarPixels {
+
+	// pixels converted at once, the planes of a segment stay in the l1 cache between the conversion steps
+	static constexpr uint32_t SegmentPixels = 1024;
+
+	// fewest pixels a thread pool chunk works on
+	static constexpr uint32_t ChunkPixels = 1 << 16;
+
+	// one quad of the frame as the overlay draws it
+	struct QuadDraw {
+		uint32_t  TextureId = 0;
+		glm::vec4 Rect;			// min and max corner in imgui display coordinates
+		glm::vec4 TexRect;		// uvs at those corners
+	};
+
+	static uint32_t program = 0;
+
+	// what the draw callback of this frame draws, render thread only
+	static std::vector<QuadDraw> quadDraws;
+	static Overlay	 currentOverlay;
+	static glm::vec4 imageRect;
+	static glm::vec2 displayPos	 = { 0.0f, 0.0f };
+	static glm::vec2 displaySize = { 1.0f, 1.0f };
+	static int		 imageSource = 0;
+
+	// a segment of a row to planar linear rgb
+	static void LoadSegment(const Renderer::PixelStore& pixels, uint32_t x, uint32_t row, uint32_t count, float* r, float* g, float* b) {
+		const uint8_t* pixel = pixels.GetPixel(x, row);
+
+		switch (pixels.GetFormat()) {
+			case Renderer::PixelFormat::RGBA16:
+				ColorSpace::DecodeSrgb16(reinterpret_cast<const uint16_t*>(pixel), r, g, b, count);
+				break;
+
+			case Renderer::PixelFormat::RGBA32F: {
+				const float* channels = reinterpret_cast<const float*>(pixel);
+				for (uint32_t i = 0; i < count; ++i, channels += 4) {
+					r[i] = channels[0];
+					g[i] = channels[1];
+					b[i] = channels[2];
+				}
+
+				break;
+			}
+
+			default:
+				ColorSpace::DecodeSrgb8(pixel, r, g, b, count);
+				break;
+		}
+	}
+
+	// distances of count lab colors to the target, rounded to hundredths and saturated to 16 bits
+	static void StoreDistances(const float* l, const float* a, const float* b, const glm::vec3& targetLab, uint16_t* outValues, uint32_t count) {
+		uint32_t i = 0;
+
+#ifdef SIMILAR_PIXELS_SSE2
+		const __m128 targetL = _mm_set1_ps(targetLab.x), targetA = _mm_set1_ps(targetLab.y), targetB = _mm_set1_ps(targetLab.z);
+		const __m128 scale = _mm_set1_ps(DistanceScale), half = _mm_set1_ps(0.5f), max = _mm_set1_ps(65535.0f);
+		const __m128i bias = _mm_set1_epi32(32768);
+
+		for (; i + 8 <= count; i += 8) {
+			__m128i halves[2];
+
+			for (int h = 0; h < 2; ++h) {
+				__m128 dL = _mm_sub_ps(_mm_loadu_ps(l + i + h * 4), targetL);
+				__m128 dA = _mm_sub_ps(_mm_loadu_ps(a + i + h * 4), targetA);
+				__m128 dB = _mm_sub_ps(_mm_loadu_ps(b + i + h * 4), targetB);
+
+				__m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dL, dL), _mm_mul_ps(dA, dA)), _mm_mul_ps(dB, dB)));
+				distance = _mm_min_ps(_mm_add_ps(_mm_mul_ps(distance, scale), half), max);
+
+				// sse2 only packs to signed 16 bits, shifted down into that range and back up after
+				halves[h] = _mm_sub_epi32(_mm_cvttps_epi32(distance), bias);
+			}
+
+			__m128i packed = _mm_xor_si128(_mm_packs_epi32(halves[0], halves[1]), _mm_set1_epi16((short)0x8000));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(outValues + i), packed);
+		}
+#endif
+
+		for (; i < count; ++i) {
+			float dL = l[i] - targetLab.x, dA = a[i] - targetLab.y, dB = b[i] - targetLab.z;
+			float distance = std::sqrt(dL * dL + dA * dA + dB * dB) * DistanceScale + 0.5f;
+
+			// also sends nan to 65535
+			outValues[i] = distance < 65535.0f ? (uint16_t)distance : 65535;
+		}
+	}
+
+	void ComputeDistances(const Renderer::PixelStore& pixels, const glm::vec3& targetLab, DistanceMap& outMap) {
+		outMap.Width  = pixels.IsValid() ? pixels.GetWidth()  : 0;
+		outMap.Height = pixels.IsValid() ? pixels.GetHeight() : 0;
+		outMap.Values.resize((size_t)outMap.Width * outMap.Height);
+
+		if (outMap.Values.empty())
+			return;
+
+		uint32_t rowsPerChunk = std::max(1u, ChunkPixels / outMap.Width);
+
+		ThreadPool::ParallelFor(outMap.Height, rowsPerChunk, [&](uint32_t firstRow, uint32_t endRow) {
+			float l[SegmentPixels], a[SegmentPixels], b[SegmentPixels];
+
+			for (uint32_t row = firstRow; row < endRow; ++row) {
+				uint16_t* values = outMap.Values.data() + (size_t)row * outMap.Width;
+
+				for (uint32_t x = 0; x < outMap.Width; x += SegmentPixels) {
+					uint32_t count = std::min(SegmentPixels, outMap.Width - x);
+
+					LoadSegment(pixels, x, row, count, l, a, b);
+					ColorSpace::LinearToXyz(l, a, b, l, a, b, count);
+					ColorSpace::XyzToLab(l, a, b, l, a, b, count);
+					StoreDistances(l, a, b, targetLab, values + x, count);
+				}
+			}
+		});
+	}
+
+	// a row of the mask, returns how many pixels are in
+	static uint32_t MaskRow(const uint16_t* values, uint16_t limit, uint8_t* outMask, uint32_t count) {
+		uint32_t i = 0, inside = 0;
+
+#ifdef SIMILAR_PIXELS_SSE2
+		// unsigned compare as signed with the top bit flipped on both sides
+		const __m128i flip	 = _mm_set1_epi16((short)0x8000);
+		const __m128i bound	 = _mm_xor_si128(_mm_set1_epi16((short)limit), flip);
+		const __m128i ones	 = _mm_set1_epi8(1);
+		__m128i		  counts = _mm_setzero_si128();
+
+		for (; i + 16 <= count; i += 16) {
+			__m128i low	 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i)), flip);
+			__m128i high = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i + 8)), flip);
+
+			// 0xffff where the value is not over the limit, packed to bytes of 0xff
+			__m128i mask = _mm_packs_epi16(_mm_andnot_si128(_mm_cmpgt_epi16(low, bound), _mm_set1_epi16(-1)),
+										   _mm_andnot_si128(_mm_cmpgt_epi16(high, bound), _mm_set1_epi16(-1)));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(outMask + i), mask);
+			counts = _mm_add_epi64(counts, _mm_sad_epu8(_mm_and_si128(mask, ones), _mm_setzero_si128()));
+		}
+
+		inside = (uint32_t)(_mm_cvtsi128_si32(counts) + _mm_cvtsi128_si32(_mm_srli_si128(counts, 8)));
+#endif
+
+		for (; i < count; ++i) {
+			outMask[i] = values[i] <= limit ? 255 : 0;
+			inside	  += values[i] <= limit;
+		}
+
+		return inside;
+	}
+
+	uint64_t ComputeMask(const DistanceMap& map, float threshold, std::vector<uint8_t>& outMask) {
+		outMask.resize(map.Values.size());
+		if (outMask.empty())
+			return 0;
+
+		// also sends nan to an empty mask
+		if (!(threshold >= 0.0f)) {
+			std::fill(outMask.begin(), outMask.end(), 0);
+			return 0;
+		}
+
+		uint16_t limit = (uint16_t)std::min(threshold * DistanceScale + 0.5f, 65535.0f);
+		uint32_t rowsPerChunk = std::max(1u, ChunkPixels * 4 / map.Width);
+		std::atomic<uint64_t> inside = 0;
+
+		// the rows of a chunk follow each other in both the map and the mask
+		ThreadPool::ParallelFor(map.Height, rowsPerChunk, [&](uint32_t firstRow, uint32_t endRow) {
+			size_t offset = (size_t)firstRow * map.Width;
+			inside += MaskRow(map.Values.data() + offset, limit, outMask.data() + offset, (endRow - firstRow) * map.Width);
+		});
+
+		return inside;
+	}
+
+	uint64_t ComputeMask(const Renderer::PixelStore& pixels, const glm::vec3& targetLab, float threshold, std::vector<uint8_t>& outMask) {
+		DistanceMap map;
+		ComputeDistances(pixels, targetLab, map);
+		return ComputeMask(map, threshold, outMask);
+	}
+
+	void InitGpu() {
+		program = Renderer::LoadShader("assets/Shaders/SimilarPixels.glsl");
+	}
+
+	void ShutdownGpu() {
+		glDeleteProgram(program);
+		program = 0;
+	}
+
+	bool IsGpuAvailable() {
+		return program != 0;
+	}
+
+	static void DrawQuads(const ImDrawList*, const ImDrawCmd* command) {
+		// the backend has set the viewport to the framebuffer of the viewport being drawn
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glm::vec2 scale = { viewport[2] / displaySize.x, viewport[3] / displaySize.y };
+
+		// callbacks are not clipped by the backend, the clip rect is in display coordinates with y down
+		const ImVec4& clip = command->ClipRect;
+		glEnable(GL_SCISSOR_TEST);
+		glScissor((GLint)((clip.x - displayPos.x) * scale.x), (GLint)((displayPos.y + displaySize.y - clip.w) * scale.y),
+				  (GLsizei)((clip.z - clip.x) * scale.x), (GLsizei)((clip.w - clip.y) * scale.y));
+
+		// no vertex attributes are read, the backend's vertex array stays bound, its blending mixes in the highlight
+		glUseProgram(program);
+		glUniform2f(0, displayPos.x, displayPos.y);
+		glUniform2f(1, displaySize.x, displaySize.y);
+		glUniform4f(4, imageRect.x, imageRect.y, imageRect.z, imageRect.w);
+		glUniform3f(5, currentOverlay.TargetLab.x, currentOverlay.TargetLab.y, currentOverlay.TargetLab.z);
+		glUniform1f(6, currentOverlay.Threshold);
+		glUniform4f(7, currentOverlay.Highlight.x, currentOverlay.Highlight.y, currentOverlay.Highlight.z, currentOverlay.Highlight.w);
+		glUniform1i(8, imageSource);
+		glBindTextureUnit(1, currentOverlay.MaskTexture);
+
+		for (const QuadDraw& quad : quadDraws) {
+			glUniform4f(2, quad.Rect.x, quad.Rect.y, quad.Rect.z, quad.Rect.w);
+			glUniform4f(3, quad.TexRect.x, quad.TexRect.y, quad.TexRect.z, quad.TexRect.w);
+			glBindTextureUnit(0, quad.TextureId);
+
+			glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+		}
+	}
+
+	void DrawOverlay(ImDrawList* drawList, const ImVec2& targetPos, const ImVec2& targetSize, const Renderer::ImageFrame& frame, const Overlay& overlay) {
+		// nothing while a placeholder is shown
+		if (program == 0 || frame.Quads.empty() || frame.ImageWidth == 0)
+			return;
+
+		const ImGuiViewport* viewport = ImGui::GetWindowViewport();
+		displayPos	= { viewport->Pos.x, viewport->Pos.y };
+		displaySize = { viewport->Size.x, viewport->Size.y };
+
+		currentOverlay = overlay;
+		imageSource	   = overlay.MaskTexture != 0 ? 2 : frame.ImageFormat == Renderer::PixelFormat::RGBA32F ? 1 : 0;
+
+		// quads have their origin at the bottom left of the target, imgui at the top left
+		imageRect = { targetPos.x + frame.ImageMin.x, targetPos.y + targetSize.y - frame.ImageMax.y, targetPos.x + frame.ImageMax.x, targetPos.y + targetSize.y - frame.ImageMin.y };
+
+		quadDraws.clear();
+		for (const Renderer::ImageQuad& quad : frame.Quads) {
+			QuadDraw& draw = quadDraws.emplace_back();
+			draw.TextureId = quad.TextureId;
+			draw.Rect	   = { targetPos.x + quad.Min.x, targetPos.y + targetSize.y - quad.Max.y, targetPos.x + quad.Max.x, targetPos.y + targetSize.y - quad.Min.y };
+			draw.TexRect   = { quad.UVMin.x, quad.UVMax.y, quad.UVMax.x, quad.UVMin.y };
+		}
+
+		drawList->AddCallback(DrawQuads, nullptr);
+		drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+	}
+
+}
@@ -0,0 +1,59 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+#include "Renderer.h"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct ImDrawList;
+struct ImVec2;
+
+// pixels within a delta e (1976, euclidean in lab) of a picked color, shown as an overlay on the image
+// the cpu path first measures every pixel's distance to the picked color (rows split over the thread pool, sse2
+// through the ColorSpace batch kernels) and keeps it, moving the threshold then only compares the kept distances
+// the gpu path is a fragment shader over the image textures that measures the distance of each drawn pixel
+namespace SimilarPixels {
+
+	// distances are kept in hundredths of a delta e, saturating at 655.35 (far beyond the whole lab gamut of srgb)
+	static constexpr float DistanceScale = 100.0f;
+
+	// delta e of every pixel, top row first like the pixel store
+	struct DistanceMap {
+		uint32_t Width	= 0;
+		uint32_t Height = 0;
+		std::vector<uint16_t> Values;
+	};
+
+	// any thread, rgba8 and 16 bit pixels are srgb encoded, float ones linear
+	void ComputeDistances(const Renderer::PixelStore& pixels, const glm::vec3& targetLab, DistanceMap& outMap);
+
+	// any thread, 255 where the distance is at most threshold and 0 elsewhere, returns how many pixels are in
+	uint64_t ComputeMask(const DistanceMap& map, float threshold, std::vector<uint8_t>& outMask);
+
+	// both steps for a single threshold
+	uint64_t ComputeMask(const Renderer::PixelStore& pixels, const glm::vec3& targetLab, float threshold, std::vector<uint8_t>& outMask);
+
+	struct Overlay {
+		glm::vec3 TargetLab	  = glm::vec3(0.0f);
+		float	  Threshold	  = 5.0f;
+		glm::vec4 Highlight	  = { 1.0f, 0.0f, 1.0f, 0.6f };		// blended over the pixels within threshold
+
+		// r8 texture of a cpu mask of the whole decoded image, 0 measures the distances in the shader instead
+		uint32_t MaskTexture = 0;
+	};
+
+	// render thread, builds assets/Shaders/SimilarPixels.glsl, the overlay is not drawn if that fails
+	void InitGpu();
+	void ShutdownGpu();
+	bool IsGpuAvailable();
+
+	// draws the overlay over the quads of frame into drawList, targetPos and targetSize are where the target
+	// of RenderImage lies in imgui's display coordinates, call after adding the images of the quads
+	void DrawOverlay(ImDrawList* drawList, const ImVec2& targetPos, const ImVec2& targetSize, const Renderer::ImageFrame& frame, const Overlay& overlay);
+
+}
@@ -0,0 +1,165 @@
+
+
+#include "glad/glad.h"
+
+#include "StagingRing.h"
+
+#include <deque>
+#include <mutex>
+
+namespace StagingRing {
+
+	enum class RegionState : uint8_t {
+		Writing,	// handed out, cpu is filling it
+		InFlight,	// uploads issued, waiting on the fence
+		Done		// can be recycled
+	};
+
+	struct Region {
+		size_t		Offset = 0;
+		size_t		Size   = 0;
+		GLsync		Fence  = nullptr;
+		RegionState State  = RegionState::Writing;
+	};
+
+	// offsets handed out are aligned for any pixel type and for the driver's copy engine
+	static constexpr size_t RegionAlignment = 256;
+
+	static uint32_t			  buffer	 = 0;
+	static uint8_t*			  mappedData = nullptr;
+	static size_t			  capacity	 = 0;
+	static std::deque<Region> regions;		// in allocation order, oldest first
+	static std::mutex		  regionsMutex;
+
+	void Init(size_t size) {
+		capacity = size;
+
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glCreateBuffers(1, &buffer);
+		glNamedBufferStorage(buffer, capacity, nullptr, flags);
+		mappedData = static_cast<uint8_t*>(glMapNamedBufferRange(buffer, 0, capacity, flags));
+	}
+
+	void Shutdown() {
+		std::lock_guard<std::mutex> lock(regionsMutex);
+
+		for (Region& region : regions) {
+			if (region.Fence != nullptr)
+				glDeleteSync(region.Fence);
+		}
+
+		regions.clear();
+
+		if (buffer != 0) {
+			glUnmapNamedBuffer(buffer);
+			glDeleteBuffers(1, &buffer);
+		}
+
+		buffer	   = 0;
+		mappedData = nullptr;
+		capacity   = 0;
+	}
+
+	uint32_t GetBufferId() {
+		return buffer;
+	}
+
+	size_t GetCapacity() {
+		return capacity;
+	}
+
+	Allocation Allocate(size_t size) {
+		std::lock_guard<std::mutex> lock(regionsMutex);
+
+		size_t alignedSize = (size + RegionAlignment - 1) & ~(RegionAlignment - 1);
+		if (mappedData == nullptr || alignedSize == 0 || alignedSize > capacity)
+			return {};
+
+		size_t offset = 0;
+
+		if (!regions.empty()) {
+			size_t liveBegin = regions.front().Offset;
+			size_t liveEnd	 = regions.back().Offset + regions.back().Size;
+
+			if (liveEnd > liveBegin) {
+				// live data is one block, free space on both sides of it
+				if (capacity - liveEnd >= alignedSize)
+					offset = liveEnd;
+				else if (liveBegin >= alignedSize)
+					offset = 0;
+				else
+					return {};
+			}
+			else {
+				// live data wraps around the end, free space is the gap in between
+				if (liveBegin - liveEnd >= alignedSize)
+					offset = liveEnd;
+				else
+					return {};
+			}
+		}
+
+		regions.push_back({ offset, alignedSize, nullptr, RegionState::Writing });
+		return { offset, size, mappedData + offset };
+	}
+
+	static Region* FindRegion(const Allocation& allocation) {
+		for (Region& region : regions) {
+			if (region.Offset == allocation.Offset && region.State != RegionState::Done)
+				return &region;
+		}
+
+		return nullptr;
+	}
+
+	void Free(const Allocation& allocation) {
+		if (!allocation.IsValid())
+			return;
+
+		std::lock_guard<std::mutex> lock(regionsMutex);
+
+		if (Region* region = FindRegion(allocation)) {
+			if (region->Fence != nullptr)
+				glDeleteSync(region->Fence);
+
+			region->Fence = nullptr;
+			region->State = RegionState::Done;
+		}
+	}
+
+	void Submit(const Allocation& allocation) {
+		if (!allocation.IsValid())
+			return;
+
+		std::lock_guard<std::mutex> lock(regionsMutex);
+
+		if (Region* region = FindRegion(allocation)) {
+			region->Fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			region->State = RegionState::InFlight;
+		}
+	}
+
+	void Retire() {
+		std::lock_guard<std::mutex> lock(regionsMutex);
+
+		// regions are recycled in order, a region still being written blocks the ones behind it
+		while (!regions.empty()) {
+			Region& region = regions.front();
+
+			if (region.State == RegionState::Writing)
+				break;
+
+			if (region.State == RegionState::InFlight) {
+				GLenum status = glClientWaitSync(region.Fence, 0, 0);
+				if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+					break;
+
+				glDeleteSync(region.Fence);
+			}
+
+			regions.pop_front();
+		}
+	}
+
+}
@@ -0,0 +1,39 @@
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// persistently mapped pixel unpack buffer, decoders write pixels straight into it and the
+// render thread uploads textures from it, regions are recycled once the gpu has read them
+namespace StagingRing {
+
+	struct Allocation {
+		size_t	 Offset = 0;
+		size_t	 Size	= 0;
+		uint8_t* Data	= nullptr;
+
+		bool IsValid() const { return Data != nullptr; }
+	};
+
+	// render thread, needs a gl 4.4+ context
+	void Init(size_t capacity);
+	void Shutdown();
+
+	uint32_t GetBufferId();
+	size_t	 GetCapacity();
+
+	// any thread, returns an invalid allocation if the ring is not initialized or has no room
+	Allocation Allocate(size_t size);
+
+	// any thread, gives the region back without uploading from it
+	void Free(const Allocation& allocation);
+
+	// render thread, call after issuing the uploads that read from the allocation
+	void Submit(const Allocation& allocation);
+
+	// render thread, call once per frame to recycle regions the gpu is done with
+	void Retire();
+
+}
@@ -0,0 +1,252 @@
+
+
+#include "SummedArea.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <new>
+#include <vector>
+
+namespace SummedArea {
+
+	// red, green and blue of the rgba pixels are summed
+	static constexpr uint32_t Channels = 3;
+	static constexpr uint32_t PixelChannels = 4;
+
+	// fewest pixels a thread pool chunk of the row pass works on
+	static constexpr uint32_t ChunkPixels = 1 << 16;
+
+	// bands of rows per thread the tables are built in
+	static constexpr uint32_t BandsPerThread = 2;
+
+	static size_t GetEntrySize(Accumulator type) {
+		return type == Accumulator::UInt32 ? sizeof(uint32_t) : sizeof(uint64_t);
+	}
+
+	// a table only needs to hold the sum over the whole image, smaller sums are differences of its entries
+	// 64 bit squares of 16 bit values would overflow past 2^32 pixels, which no decoded image comes near
+	static Accumulator GetAccumulator(uint32_t width, uint32_t height, Renderer::PixelFormat format, bool squared) {
+		if (format == Renderer::PixelFormat::RGBA32F)
+			return Accumulator::Double;
+
+		uint64_t maxValue = format == Renderer::PixelFormat::RGBA16 ? 65535 : 255;
+		if (squared)
+			maxValue *= maxValue;
+
+		uint64_t count = static_cast<uint64_t>(width) * height;
+		return count <= std::numeric_limits<uint32_t>::max() / maxValue ? Accumulator::UInt32 : Accumulator::UInt64;
+	}
+
+	static size_t GetWordCount(uint32_t width, uint32_t height, Accumulator type) {
+		size_t entries = (static_cast<size_t>(width) + 1) * (static_cast<size_t>(height) + 1) * Channels;
+		return (entries * GetEntrySize(type) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+	}
+
+	size_t EstimateBytes(uint32_t width, uint32_t height, Renderer::PixelFormat format, bool withSquares) {
+		if (width == 0 || height == 0)
+			return 0;
+
+		size_t words = GetWordCount(width, height, GetAccumulator(width, height, format, false));
+		if (withSquares)
+			words += GetWordCount(width, height, GetAccumulator(width, height, format, true));
+
+		return words * sizeof(uint64_t);
+	}
+
+	// one table of sums or of squared sums, every entry is written once
+	// the rows are split into bands, the totals of each band are summed up first (reading pixels only) so every band
+	// then knows the entries above it and writes its own final entries in a single pass
+	template<typename Value, typename Entry, bool Squared>
+	static void FillTable(const Renderer::PixelStore& pixels, Entry* entries) {
+		uint32_t width = pixels.GetWidth(), height = pixels.GetHeight();
+		size_t stride  = (static_cast<size_t>(width) + 1) * Channels;
+
+		// a few bands per thread evens out their run times, no band is smaller than a thread pool chunk
+		uint32_t bands	   = BandsPerThread * (ThreadPool::GetThreadCount() + 1);
+		uint32_t bandRows  = std::max(std::max(1u, ChunkPixels / width), (height + bands - 1) / bands);
+		uint32_t bandCount = (height + bandRows - 1) / bandRows;
+
+		// entries of the table row above each band, zero above the first
+		std::vector<Entry> carries(bandCount * stride, Entry(0));
+
+		auto Load = [&](const Value* values, uint32_t c) {
+			Entry value = static_cast<Entry>(values[c]);
+			return Squared ? value * value : value;
+		};
+
+		// column totals of every band but the last, turned into the entries they add to the rows below
+		ThreadPool::ParallelFor(bandCount - 1, 1, [&](uint32_t firstBand, uint32_t endBand) {
+			for (uint32_t band = firstBand; band < endBand; ++band) {
+				Entry* totals = carries.data() + (band + 1) * stride;
+				uint32_t endRow = std::min(height, (band + 1) * bandRows);
+
+				for (uint32_t y = band * bandRows; y < endRow; ++y) {
+					const Value* values = reinterpret_cast<const Value*>(pixels.GetPixel(0, y));
+
+					for (size_t i = Channels; i < stride; i += Channels, values += PixelChannels) {
+						for (uint32_t c = 0; c < Channels; ++c)
+							totals[i + c] += Load(values, c);
+					}
+				}
+
+				for (size_t i = 2 * Channels; i < stride; ++i)
+					totals[i] += totals[i - Channels];
+			}
+		});
+
+		for (uint32_t band = 2; band < bandCount; ++band) {
+			Entry* carry = carries.data() + band * stride;
+			const Entry* above = carry - stride;
+
+			for (size_t i = 0; i < stride; ++i)
+				carry[i] += above[i];
+		}
+
+		std::fill(entries, entries + stride, Entry(0));
+
+		// running sums along each row added to the entries above, store row y fills table row y + 1
+		ThreadPool::ParallelFor(bandCount, 1, [&](uint32_t firstBand, uint32_t endBand) {
+			for (uint32_t band = firstBand; band < endBand; ++band) {
+				const Entry* above = carries.data() + band * stride;
+				uint32_t endRow = std::min(height, (band + 1) * bandRows);
+
+				for (uint32_t y = band * bandRows; y < endRow; ++y) {
+					const Value* values = reinterpret_cast<const Value*>(pixels.GetPixel(0, y));
+					Entry* row = entries + (y + 1) * stride;
+					Entry running[Channels] = {};
+
+					for (uint32_t c = 0; c < Channels; ++c)
+						row[c] = Entry(0);
+
+					for (size_t i = Channels; i < stride; i += Channels, values += PixelChannels) {
+						for (uint32_t c = 0; c < Channels; ++c) {
+							running[c] += Load(values, c);
+							row[i + c] = above[i + c] + running[c];
+						}
+					}
+
+					above = row;
+				}
+			}
+		});
+	}
+
+	template<typename Value, bool Squared>
+	static void BuildTable(const Renderer::PixelStore& pixels, Accumulator type, uint64_t* words) {
+		switch (type) {
+			case Accumulator::UInt32: FillTable<Value, uint32_t, Squared>(pixels, reinterpret_cast<uint32_t*>(words)); break;
+			case Accumulator::UInt64: FillTable<Value, uint64_t, Squared>(pixels, words); break;
+			default:				  FillTable<Value, double,	Squared>(pixels, reinterpret_cast<double*>(words)); break;
+		}
+	}
+
+	template<typename Value>
+	static void BuildTables(const Renderer::PixelStore& pixels, Table& table) {
+		BuildTable<Value, false>(pixels, table.SumType, table.Sums.get());
+
+		if (table.HasSquares())
+			BuildTable<Value, true>(pixels, table.SquareType, table.Squares.get());
+	}
+
+	bool Build(const Renderer::PixelStore& pixels, bool withSquares, Table& outTable) {
+		outTable = {};
+		if (!pixels.IsValid() || pixels.GetWidth() == 0 || pixels.GetHeight() == 0)
+			return true;
+
+		outTable.Width		= pixels.GetWidth();
+		outTable.Height		= pixels.GetHeight();
+		outTable.Format		= pixels.GetFormat();
+		outTable.SumType	= GetAccumulator(outTable.Width, outTable.Height, outTable.Format, false);
+		outTable.SquareType = GetAccumulator(outTable.Width, outTable.Height, outTable.Format, true);
+
+		// every entry gets written, so the memory is not cleared first
+		// tables of large images run to gigabytes, an allocation that fails leaves the table empty instead of throwing
+		outTable.SumWords = GetWordCount(outTable.Width, outTable.Height, outTable.SumType);
+		outTable.Sums.reset(new (std::nothrow) uint64_t[outTable.SumWords]);
+
+		if (withSquares) {
+			outTable.SquareWords = GetWordCount(outTable.Width, outTable.Height, outTable.SquareType);
+			outTable.Squares.reset(new (std::nothrow) uint64_t[outTable.SquareWords]);
+		}
+
+		if (outTable.Sums == nullptr || (withSquares && outTable.Squares == nullptr)) {
+			outTable = {};
+			return false;
+		}
+
+		switch (outTable.Format) {
+			case Renderer::PixelFormat::RGBA16:  BuildTables<uint16_t>(pixels, outTable); break;
+			case Renderer::PixelFormat::RGBA32F: BuildTables<float>(pixels, outTable); break;
+			default:							 BuildTables<uint8_t>(pixels, outTable); break;
+		}
+
+		return true;
+	}
+
+	// sums of the entries between rows top and bottom and columns left and right of the table
+	template<typename Entry>
+	static void SumRect(const Entry* entries, size_t stride, uint32_t top, uint32_t bottom, uint32_t left, uint32_t right, double* outSums) {
+		const Entry* topRow	   = entries + top * stride;
+		const Entry* bottomRow = entries + bottom * stride;
+
+		for (uint32_t c = 0; c < Channels; ++c) {
+			Entry sum = (bottomRow[right * Channels + c] - topRow[right * Channels + c]) - (bottomRow[left * Channels + c] - topRow[left * Channels + c]);
+			outSums[c] = static_cast<double>(sum);
+		}
+	}
+
+	static void SumRect(const uint64_t* words, Accumulator type, size_t stride, uint32_t top, uint32_t bottom, uint32_t left, uint32_t right, double* outSums) {
+		switch (type) {
+			case Accumulator::UInt32: SumRect(reinterpret_cast<const uint32_t*>(words), stride, top, bottom, left, right, outSums); break;
+			case Accumulator::UInt64: SumRect(words, stride, top, bottom, left, right, outSums); break;
+			default:				  SumRect(reinterpret_cast<const double*>(words), stride, top, bottom, left, right, outSums); break;
+		}
+	}
+
+	RectStats Query(const Table& table, const PixelKernels::PixelRect& rect) {
+		RectStats stats;
+
+		if (!table.IsValid() || rect.X >= table.Width || rect.Y >= table.Height)
+			return stats;
+
+		uint32_t width	= std::min(rect.Width,	table.Width	 - rect.X);
+		uint32_t height = std::min(rect.Height, table.Height - rect.Y);
+		if (width == 0 || height == 0)
+			return stats;
+
+		// table rows count from the top like the store, one more of them leads
+		uint32_t top	= table.Height - rect.Y - height;
+		uint32_t bottom = top + height;
+		size_t	 stride = (static_cast<size_t>(table.Width) + 1) * Channels;
+
+		double sums[Channels], squares[Channels] = {};
+		SumRect(table.Sums.get(), table.SumType, stride, top, bottom, rect.X, rect.X + width, sums);
+
+		if (table.HasSquares())
+			SumRect(table.Squares.get(), table.SquareType, stride, top, bottom, rect.X, rect.X + width, squares);
+
+		// 16 bit values normalize like the gl unorm formats, floats already are colors
+		double scale = 1.0;
+		if (table.Format == Renderer::PixelFormat::RGBA8)
+			scale = 1.0 / 255.0;
+		else if (table.Format == Renderer::PixelFormat::RGBA16)
+			scale = 1.0 / 65535.0;
+
+		uint64_t count = static_cast<uint64_t>(width) * height;
+		stats.PixelCount = count;
+
+		for (uint32_t c = 0; c < Channels; ++c) {
+			double mean		= sums[c] / count;
+			double variance = table.HasSquares() ? std::max(squares[c] / count - mean * mean, 0.0) : 0.0;
+
+			stats.Mean[c]	  = (float)(mean * scale);
+			stats.Variance[c] = (float)(variance * scale * scale);
+			stats.StdDev[c]	  = (float)(std::sqrt(variance) * scale);
+		}
+
+		return stats;
+	}
+
+}
@@ -0,0 +1,64 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+#include "PixelKernels.h"
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <memory>
+
+// summed-area tables of a decoded image, the sum (and optionally the sum of squares) of red, green and blue over any rect
+// comes from four entries, so the mean and variance of a rect cost the same at any size
+// built in bands of rows split over the thread pool, each entry of the tables is written once
+namespace SummedArea {
+
+	// what the entries of a table are summed in, the narrowest one that can not overflow over the whole image
+	// unsigned sums may wrap in between, the differences of four entries still come out exact
+	enum class Accumulator : uint8_t {
+		UInt32,
+		UInt64,
+		Double		// float images
+	};
+
+	// (Width + 1) x (Height + 1) entries of three channels (alpha is left out), top row first like the pixel store,
+	// with a leading row and column of zeros, each entry sums the pixels above and left of it
+	struct Table {
+		uint32_t Width	= 0;
+		uint32_t Height = 0;
+		Renderer::PixelFormat Format = Renderer::PixelFormat::RGBA8;
+		Accumulator SumType	   = Accumulator::UInt32;
+		Accumulator SquareType = Accumulator::UInt64;
+
+		// entries of SumType and SquareType packed into 64 bit words, no Squares for tables built without
+		std::unique_ptr<uint64_t[]> Sums;
+		std::unique_ptr<uint64_t[]> Squares;
+		size_t SumWords	   = 0;
+		size_t SquareWords = 0;
+
+		bool   IsValid()	const { return Sums != nullptr; }
+		bool   HasSquares() const { return Squares != nullptr; }
+		size_t GetSizeInBytes() const { return (SumWords + SquareWords) * sizeof(uint64_t); }
+	};
+
+	// rgb statistics of a rect, normalized to 0..1 like a picked color (hdr values may go past 1)
+	struct RectStats {
+		uint64_t  PixelCount = 0;
+		glm::vec3 Mean	   = glm::vec3(0.0f);
+		glm::vec3 Variance = glm::vec3(0.0f);		// population variance, 0 for tables without squares
+		glm::vec3 StdDev   = glm::vec3(0.0f);
+	};
+
+	// what Build would allocate for an image, to decide before building whether it is worth the memory
+	size_t EstimateBytes(uint32_t width, uint32_t height, Renderer::PixelFormat format, bool withSquares);
+
+	// any thread, blocks while the thread pool helps, an invalid store gives an empty table
+	// returns false with an empty table if the memory for the tables could not be allocated
+	bool Build(const Renderer::PixelStore& pixels, bool withSquares, Table& outTable);
+
+	// rect in image pixels with the origin at the bottom left, clipped to the image, constant time
+	RectStats Query(const Table& table, const PixelKernels::PixelRect& rect);
+
+}
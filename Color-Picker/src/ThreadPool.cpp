@@ -0,0 +1,132 @@
+
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ThreadPool {
+
+	static std::vector<std::thread>			   workers;
+	static std::deque<std::function<void()>> jobs;
+	static std::mutex						   jobsMutex;
+	static std::condition_variable			   jobsCondition;
+	static bool								   stopping = false;
+
+	// chunks of a ParallelFor, helpers that start after the caller has returned find none left and leave
+	struct ParallelRange {
+		const std::function<void(uint32_t, uint32_t)>* Body = nullptr;
+		uint32_t Count	   = 0;
+		uint32_t GrainSize = 0;
+		uint32_t Chunks	   = 0;
+
+		std::atomic<uint32_t>	NextChunk  = 0;
+		std::atomic<uint32_t>	DoneChunks = 0;
+		std::mutex				DoneMutex;
+		std::condition_variable DoneCondition;
+	};
+
+	static void RunChunks(ParallelRange& range) {
+		uint32_t finished = 0;
+
+		for (uint32_t chunk = range.NextChunk++; chunk < range.Chunks; chunk = range.NextChunk++) {
+			uint32_t begin = chunk * range.GrainSize;
+			(*range.Body)(begin, std::min(begin + range.GrainSize, range.Count));
+			++finished;
+		}
+
+		if (finished != 0 && range.DoneChunks.fetch_add(finished) + finished == range.Chunks) {
+			std::lock_guard<std::mutex> lock(range.DoneMutex);
+			range.DoneCondition.notify_all();
+		}
+	}
+
+	static void WorkerLoop() {
+		while (true) {
+			std::function<void()> job;
+
+			{
+				std::unique_lock<std::mutex> lock(jobsMutex);
+				jobsCondition.wait(lock, [] { return stopping || !jobs.empty(); });
+
+				if (stopping)
+					return;
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			job();
+		}
+	}
+
+	void Init(uint32_t threadCount) {
+		if (threadCount == 0) {
+			uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		stopping = false;
+		workers.reserve(threadCount);
+
+		for (uint32_t i = 0; i < threadCount; ++i)
+			workers.emplace_back(WorkerLoop);
+	}
+
+	void Shutdown() {
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex);
+			stopping = true;
+			jobs.clear();
+		}
+
+		jobsCondition.notify_all();
+
+		for (std::thread& worker : workers)
+			worker.join();
+
+		workers.clear();
+	}
+
+	uint32_t GetThreadCount() {
+		return static_cast<uint32_t>(workers.size());
+	}
+
+	void Submit(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(jobsMutex);
+			jobs.push_back(std::move(job));
+		}
+
+		jobsCondition.notify_one();
+	}
+
+	void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& body) {
+		if (count == 0)
+			return;
+
+		grainSize = std::max(grainSize, 1u);
+
+		auto range = std::make_shared<ParallelRange>();
+		range->Body		 = &body;
+		range->Count	 = count;
+		range->GrainSize = grainSize;
+		range->Chunks	 = (count - 1) / grainSize + 1;
+
+		uint32_t helpers = std::min(GetThreadCount(), range->Chunks - 1);
+		for (uint32_t i = 0; i < helpers; ++i)
+			Submit([range]() { RunChunks(*range); });
+
+		RunChunks(*range);
+
+		std::unique_lock<std::mutex> lock(range->DoneMutex);
+		range->DoneCondition.wait(lock, [&range] { return range->DoneChunks.load() == range->Chunks; });
+	}
+
+}
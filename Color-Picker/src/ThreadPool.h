@@ -0,0 +1,25 @@
+
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+namespace ThreadPool {
+
+	// starts the worker threads, 0 uses one thread per hardware thread (minus the render thread)
+	void Init(uint32_t threadCount = 0);
+
+	// waits for the running jobs to finish, jobs that have not started yet are dropped
+	void Shutdown();
+
+	uint32_t GetThreadCount();
+
+	// queues a job to run on one of the worker threads
+	void Submit(std::function<void()> job);
+
+	// runs body over [0, count) in chunks of up to grainSize on the workers and the calling thread, returns once every chunk has run
+	// the caller works through the chunks too, so this finishes even while every worker is busy or when called from a job
+	void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& body);
+
+}
@@ -0,0 +1,349 @@
+
+
+#include "glad/glad.h"
+
+#include "ThumbnailGrid.h"
+#include "ImageDirectory.h"
+#include "ImageLoader.h"
+#include "Renderer.h"
+#include "ThreadPool.h"
+
+#include "imgui.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+namespace ThumbnailGrid {
+
+	// files the scan hands to the grid at once, the first screen fills in before a large folder is listed
+	static constexpr size_t ScanBatch = 256;
+
+	// finished thumbnails uploaded per frame, each one is a 64 KB copy
+	static constexpr size_t UploadsPerFrame = 64;
+
+	enum class ThumbnailState : uint8_t {
+		Waiting,
+		Decoding,
+		Decoded,		// uploaded, or waiting in decodedThumbnails to be
+		Failed
+	};
+
+	struct Thumbnail {
+		std::string	   Path;
+		ThumbnailState State = ThumbnailState::Waiting;
+	};
+
+	struct DecodedThumbnail {
+		uint32_t			 Index = 0;
+		Renderer::PixelStore Pixels;
+	};
+
+	// shared with the scan and decode jobs, guarded by gridMutex
+	// a new folder bumps the generation, jobs of the old one drop what they were doing
+	static std::mutex					 gridMutex;
+	static std::atomic<uint64_t>		 generation = 0;
+	static std::vector<Thumbnail>		 thumbnails;
+	static std::vector<uint32_t>		 wanted;			// indices to decode, most wanted first
+	static std::vector<DecodedThumbnail> decodedThumbnails;
+	static uint32_t runningJobs = 0;
+	static bool		scanning	= false;
+
+	// render thread only
+	struct Resident {
+		int32_t	  Layer		  = -1;
+		glm::vec2 UVMax		  = { 1.0f, 1.0f };		// part of the layer the thumbnail covers
+		uint64_t  LastVisible = 0;
+	};
+
+	// per instance data of the draw, std430 layout of the shader's Thumbnail
+	struct Instance {
+		glm::vec4 Rect;
+		glm::vec4 Texture;
+	};
+
+	static std::string			 folder;
+	static std::vector<Resident> residents;
+	static std::vector<int32_t>	 layerOwners;		// thumbnail held by each layer, -1 if free
+	static uint64_t				 frame = 0;
+
+	static uint32_t textureArray   = 0;
+	static uint32_t program		   = 0;
+	static uint32_t instanceBuffer = 0;
+
+	static std::vector<Instance> instances;
+	static glm::vec2 displayPos	 = { 0.0f, 0.0f };
+	static glm::vec2 displaySize = { 1.0f, 1.0f };
+
+	// files are added in the order the directory lists them, so indices stay put while the scan runs
+	static void ScanFolder(const std::string& directory, uint64_t scanGeneration) {
+		std::vector<Thumbnail> batch;
+
+		auto flush = [&]() {
+			std::lock_guard<std::mutex> lock(gridMutex);
+			if (generation.load() == scanGeneration)
+				thumbnails.insert(thumbnails.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+
+			batch.clear();
+		};
+
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			if (generation.load() != scanGeneration)
+				return;
+
+			if (entry.is_regular_file(error) && ImageDirectory::IsImageFile(entry.path().string())) {
+				batch.push_back({ entry.path().string() });
+				if (batch.size() == ScanBatch)
+					flush();
+			}
+		}
+
+		flush();
+
+		std::lock_guard<std::mutex> lock(gridMutex);
+		if (generation.load() == scanGeneration)
+			scanning = false;
+	}
+
+	// decodes the thumbnail wanted most at the time the job runs, so scrolling reorders the work right away
+	static void DecodeNext(uint64_t jobGeneration) {
+		uint32_t	index = 0;
+		std::string path;
+
+		{
+			std::lock_guard<std::mutex> lock(gridMutex);
+			if (generation.load() != jobGeneration)
+				return;
+
+			auto it = std::find_if(wanted.begin(), wanted.end(), [](uint32_t i) { return thumbnails[i].State == ThumbnailState::Waiting; });
+			if (it == wanted.end()) {
+				--runningJobs;
+				return;
+			}
+
+			index = *it;
+			path  = thumbnails[index].Path;
+			thumbnails[index].State = ThumbnailState::Decoding;
+		}
+
+		Renderer::PixelStore pixels;
+		bool decoded = ImageLoader::DecodeThumbnail(path, ThumbnailSize, pixels);
+
+		std::lock_guard<std::mutex> lock(gridMutex);
+		if (generation.load() != jobGeneration)
+			return;
+
+		--runningJobs;
+		thumbnails[index].State = decoded ? ThumbnailState::Decoded : ThumbnailState::Failed;
+		if (decoded)
+			decodedThumbnails.push_back({ index, std::move(pixels) });
+	}
+
+	// a free layer, else the one of the thumbnail scrolled out of view the longest, -1 if every layer is on screen
+	// caller holds gridMutex, the evicted thumbnail is decoded again when it comes back into view
+	static int32_t AcquireLayer() {
+		int32_t oldest = -1;
+
+		for (uint32_t layer = 0; layer < ResidentThumbnails; ++layer) {
+			int32_t owner = layerOwners[layer];
+			if (owner < 0)
+				return (int32_t)layer;
+
+			if (residents[owner].LastVisible != frame && (oldest < 0 || residents[owner].LastVisible < residents[layerOwners[oldest]].LastVisible))
+				oldest = (int32_t)layer;
+		}
+
+		if (oldest >= 0) {
+			int32_t owner = layerOwners[oldest];
+			residents[owner].Layer	= -1;
+			thumbnails[owner].State = ThumbnailState::Waiting;
+		}
+
+		return oldest;
+	}
+
+	static void DrawInstances(const ImDrawList*, const ImDrawCmd* command) {
+		// the backend has set the viewport to the framebuffer of the viewport being drawn
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glm::vec2 scale = { viewport[2] / displaySize.x, viewport[3] / displaySize.y };
+
+		// callbacks are not clipped by the backend, the clip rect is in display coordinates with y down
+		const ImVec4& clip = command->ClipRect;
+		glEnable(GL_SCISSOR_TEST);
+		glScissor((GLint)((clip.x - displayPos.x) * scale.x), (GLint)((displayPos.y + displaySize.y - clip.w) * scale.y),
+				  (GLsizei)((clip.z - clip.x) * scale.x), (GLsizei)((clip.w - clip.y) * scale.y));
+
+		glNamedBufferData(instanceBuffer, instances.size() * sizeof(Instance), instances.data(), GL_STREAM_DRAW);
+
+		// no vertex attributes are read, the backend's vertex array stays bound
+		glUseProgram(program);
+		glUniform2f(0, displayPos.x, displayPos.y);
+		glUniform2f(1, displaySize.x, displaySize.y);
+		glBindTextureUnit(0, textureArray);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instances.size());
+	}
+
+	void Init() {
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &textureArray);
+		glTextureStorage3D(textureArray, 1, GL_RGBA8, ThumbnailSize, ThumbnailSize, ResidentThumbnails);
+		glTextureParameteri(textureArray, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(textureArray, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(textureArray, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(textureArray, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glCreateBuffers(1, &instanceBuffer);
+		layerOwners.assign(ResidentThumbnails, -1);
+
+		program = Renderer::LoadShader("assets/Shaders/Thumbnails.glsl");
+	}
+
+	void Shutdown() {
+		SetFolder("");
+
+		glDeleteTextures(1, &textureArray);
+		glDeleteBuffers(1, &instanceBuffer);
+		glDeleteProgram(program);
+
+		textureArray = instanceBuffer = program = 0;
+	}
+
+	void SetFolder(const std::string& directory) {
+		uint64_t folderGeneration = ++generation;
+
+		{
+			std::lock_guard<std::mutex> lock(gridMutex);
+			thumbnails.clear();
+			wanted.clear();
+			decodedThumbnails.clear();
+			runningJobs = 0;
+			scanning	= !directory.empty();
+		}
+
+		folder = directory;
+		residents.clear();
+		layerOwners.assign(ResidentThumbnails, -1);
+
+		if (!directory.empty())
+			ThreadPool::Submit([directory, folderGeneration]() { ScanFolder(directory, folderGeneration); });
+	}
+
+	const std::string& GetFolder() {
+		return folder;
+	}
+
+	uint32_t GetCount() {
+		std::lock_guard<std::mutex> lock(gridMutex);
+		return (uint32_t)thumbnails.size();
+	}
+
+	bool IsScanning() {
+		std::lock_guard<std::mutex> lock(gridMutex);
+		return scanning;
+	}
+
+	std::string GetPath(uint32_t index) {
+		std::lock_guard<std::mutex> lock(gridMutex);
+		return index < thumbnails.size() ? thumbnails[index].Path : std::string();
+	}
+
+	void Update(uint32_t firstVisible, uint32_t visibleCount) {
+		++frame;
+		instances.clear();
+
+		std::vector<DecodedThumbnail> uploads;
+		std::vector<int32_t>		  uploadLayers;
+
+		{
+			std::lock_guard<std::mutex> lock(gridMutex);
+			uint32_t count = (uint32_t)thumbnails.size();
+			residents.resize(count);
+
+			firstVisible = std::min(firstVisible, count);
+			uint32_t lastVisible = std::min(firstVisible + visibleCount, count);
+
+			for (uint32_t i = firstVisible; i < lastVisible; ++i)
+				residents[i].LastVisible = frame;
+
+			// visible cells first, then the next screen and the one before it, so scrolling on finds them ready
+			wanted.clear();
+			auto want = [&](uint32_t first, uint32_t last) {
+				for (uint32_t i = first; i < last; ++i) {
+					if (thumbnails[i].State == ThumbnailState::Waiting)
+						wanted.push_back(i);
+				}
+			};
+
+			want(firstVisible, lastVisible);
+			want(lastVisible, std::min(lastVisible + visibleCount, count));
+			want(firstVisible - std::min(firstVisible, visibleCount), firstVisible);
+
+			// layers are taken here, the uploads themselves happen without holding the lock
+			size_t uploadCount = std::min(decodedThumbnails.size(), UploadsPerFrame);
+			for (size_t i = 0; i < uploadCount; ++i) {
+				DecodedThumbnail& decoded = decodedThumbnails[i];
+
+				int32_t layer = AcquireLayer();
+				if (layer < 0) {
+					thumbnails[decoded.Index].State = ThumbnailState::Waiting;
+					continue;
+				}
+
+				layerOwners[layer] = (int32_t)decoded.Index;
+				residents[decoded.Index].Layer = layer;
+				uploadLayers.push_back(layer);
+				uploads.push_back(std::move(decoded));
+			}
+
+			decodedThumbnails.erase(decodedThumbnails.begin(), decodedThumbnails.begin() + uploadCount);
+
+			// jobs are submitted one thumbnail at a time, a worker is left free for the image being opened
+			uint32_t maxJobs = std::max(ThreadPool::GetThreadCount(), 2u) - 1;
+			uint64_t jobGeneration = generation.load();
+
+			while (runningJobs < maxJobs && runningJobs < wanted.size()) {
+				++runningJobs;
+				ThreadPool::Submit([jobGeneration]() { DecodeNext(jobGeneration); });
+			}
+		}
+
+		for (size_t i = 0; i < uploads.size(); ++i) {
+			const Renderer::PixelStore& pixels = uploads[i].Pixels;
+
+			glTextureSubImage3D(textureArray, 0, 0, 0, uploadLayers[i], pixels.GetWidth(), pixels.GetHeight(), 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.GetData());
+			residents[uploads[i].Index].UVMax = { (float)pixels.GetWidth() / ThumbnailSize, (float)pixels.GetHeight() / ThumbnailSize };
+		}
+	}
+
+	bool AddCell(uint32_t index, const glm::vec2& min, const glm::vec2& max) {
+		if (index >= residents.size() || residents[index].Layer < 0)
+			return false;
+
+		// centered in the cell with the aspect ratio of the image
+		const Resident& resident = residents[index];
+		float	  fit  = std::min((max.x - min.x) / resident.UVMax.x, (max.y - min.y) / resident.UVMax.y) / ThumbnailSize;
+		glm::vec2 size = resident.UVMax * (float)ThumbnailSize * std::min(fit, 1.0f);
+		glm::vec2 rectMin = (min + max - size) * 0.5f;
+
+		instances.push_back({ { rectMin.x, rectMin.y, rectMin.x + size.x, rectMin.y + size.y }, { resident.UVMax.x, resident.UVMax.y, (float)resident.Layer, 0.0f } });
+		return true;
+	}
+
+	void Draw(ImDrawList* drawList) {
+		if (instances.empty() || program == 0)
+			return;
+
+		const ImGuiViewport* viewport = ImGui::GetWindowViewport();
+		displayPos	= { viewport->Pos.x, viewport->Pos.y };
+		displaySize = { viewport->Size.x, viewport->Size.y };
+
+		drawList->AddCallback(DrawInstances, nullptr);
+		drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+	}
+
+}
@@ -0,0 +1,46 @@
+
+
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include <cstdint>
+#include <string>
+
+struct ImDrawList;
+
+// thumbnails of every image in a folder, for the folder browser panel
+// the folder is scanned and the thumbnails decoded on the thread pool, visible ones first, into the layers
+// of one texture array that the whole grid is drawn from with a single instanced draw
+namespace ThumbnailGrid {
+
+	// side of a thumbnail in pixels, images are fitted into it keeping their aspect ratio
+	static constexpr uint32_t ThumbnailSize = 128;
+
+	// layers of the texture array (64 MB of rgba8), thumbnails scrolled out of view give theirs up when it runs out
+	static constexpr uint32_t ResidentThumbnails = 1024;
+
+	// render thread, needs the gl context, the shader is read from assets/Shaders
+	void Init();
+	void Shutdown();
+
+	// starts scanning the folder on the thread pool, the grid grows as image files are found
+	void SetFolder(const std::string& directory);
+	const std::string& GetFolder();
+
+	// images found so far and whether the scan is still running
+	uint32_t GetCount();
+	bool IsScanning();
+	std::string GetPath(uint32_t index);
+
+	// call once per frame before Draw with the range of cells on screen, thumbnails are decoded in this
+	// order (then the next screen ahead) and the finished ones uploaded
+	void Update(uint32_t firstVisible, uint32_t visibleCount);
+
+	// queues thumbnail index into the cell [min, max] (screen pixels) of this frame's draw, false if it is not decoded yet
+	bool AddCell(uint32_t index, const glm::vec2& min, const glm::vec2& max);
+
+	// adds the instanced draw of every cell added this frame to the draw list
+	void Draw(ImDrawList* drawList);
+
+}
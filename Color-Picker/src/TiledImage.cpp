@@ -0,0 +1,299 @@
+
+
+#include "glad/glad.h"
+
+#include "TiledImage.h"
+#include "Renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+namespace Renderer {
+
+	static constexpr uint32_t NoTile = UINT32_MAX;
+
+	// images over this size are tiled even if the gpu could hold them in one texture
+	static constexpr size_t TiledImageBytes = 256 * 1024 * 1024;
+
+	static int32_t maxTextureSize = 0;
+
+	// a tile and its border are gathered here before the upload, render thread only
+	static std::vector<uint8_t> tileScratch;
+
+	void InitTiledImages() {
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	}
+
+	uint32_t GetMaxTextureSize() {
+		return (uint32_t)maxTextureSize;
+	}
+
+	bool NeedsTiling(uint32_t width, uint32_t height, PixelFormat format) {
+		// not initialized yet (no gl context), nothing to decide against
+		if (maxTextureSize == 0)
+			return false;
+
+		size_t imageSize = static_cast<size_t>(width) * height * GetTextureFormat(format).BytesPerPixel;
+		return width > (uint32_t)maxTextureSize || height > (uint32_t)maxTextureSize || imageSize > TiledImageBytes;
+	}
+
+	// averages 2x2 blocks of the previous level, the last row and column repeat for odd sizes
+	template<typename T>
+	static void Downsample(const PixelStore& previous, PixelStore& level) {
+		uint32_t lastX = previous.GetWidth()  - 1;
+		uint32_t lastY = previous.GetHeight() - 1;
+
+		for (uint32_t y = 0; y < level.GetHeight(); ++y) {
+			T* dst = reinterpret_cast<T*>(level.GetData() + y * level.GetRowStride());
+
+			const T* row0 = reinterpret_cast<const T*>(previous.GetPixel(0, std::min(2 * y, lastY)));
+			const T* row1 = reinterpret_cast<const T*>(previous.GetPixel(0, std::min(2 * y + 1, lastY)));
+
+			for (uint32_t x = 0; x < level.GetWidth(); ++x, dst += 4) {
+				uint32_t x0 = std::min(2 * x, lastX) * 4;
+				uint32_t x1 = std::min(2 * x + 1, lastX) * 4;
+
+				for (uint32_t c = 0; c < 4; ++c) {
+					if constexpr (std::is_floating_point_v<T>)
+						dst[c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+					else
+						dst[c] = (T)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+				}
+			}
+		}
+	}
+
+	std::vector<PixelStore> BuildMipLevels(const PixelStore& source) {
+		std::vector<PixelStore> levels;
+
+		uint32_t width = source.GetWidth(), height = source.GetHeight();
+		while (width > TiledImage::TileSize || height > TiledImage::TileSize) {
+			const PixelStore& previous = levels.empty() ? source : levels.back();
+
+			width  = std::max(1u, (width  + 1) / 2);
+			height = std::max(1u, (height + 1) / 2);
+
+			PixelStore level(width, height, source.GetFormat());
+			if (!level.IsValid()) {
+				std::cout << "Out of memory for the mip levels of a tiled image";
+				break;
+			}
+
+			switch (source.GetFormat()) {
+				case PixelFormat::RGBA16:  Downsample<uint16_t>(previous, level); break;
+				case PixelFormat::RGBA32F: Downsample<float>(previous, level);	  break;
+				default:				   Downsample<uint8_t>(previous, level);  break;
+			}
+
+			levels.push_back(std::move(level));
+		}
+
+		return levels;
+	}
+
+	static bool MakeResident(TiledImage& tiled, const PixelStore& source, uint32_t levelIndex, uint32_t tileX, uint32_t tileY);
+
+	// the coarsest level is pinned and shows under everything else, it goes up with the image instead of waiting for upload budget
+	// (unless the mip levels could not be built and the coarsest level is the full size one)
+	static void UploadCoarsestLevel(TiledImage& tiled, const PixelStore& source) {
+		uint32_t coarsest = (uint32_t)tiled.Levels.size() - 1;
+		if (coarsest == 0)
+			return;
+
+		const TiledImage::Level& level = tiled.Levels[coarsest];
+		for (uint32_t tileY = 0; tileY < level.TilesY; ++tileY) {
+			for (uint32_t tileX = 0; tileX < level.TilesX; ++tileX)
+				MakeResident(tiled, source, coarsest, tileX, tileY);
+		}
+	}
+
+	uint32_t CreateTiledImage(TiledImage& tiled, const PixelStore& source) {
+		tiled.Levels.clear();
+		tiled.Tiles.clear();
+
+		uint32_t tileCount = 0;
+		for (size_t i = 0; i <= tiled.MipLevels.size(); ++i) {
+			const PixelStore& pixels = i == 0 ? source : tiled.MipLevels[i - 1];
+
+			TiledImage::Level level;
+			level.Width		= pixels.GetWidth();
+			level.Height	= pixels.GetHeight();
+			level.TilesX	= (level.Width  + TiledImage::TileSize - 1) / TiledImage::TileSize;
+			level.TilesY	= (level.Height + TiledImage::TileSize - 1) / TiledImage::TileSize;
+			level.FirstTile = tileCount;
+
+			tileCount += level.TilesX * level.TilesY;
+			tiled.Levels.push_back(level);
+		}
+
+		tiled.Tiles.assign(tileCount, {});
+		tiled.LayerOwners.assign(TiledImage::ResidentTiles, NoTile);
+		tiled.Frame = 0;
+
+		uint32_t internalFormat = GetTextureFormat(source.GetFormat()).InternalFormat;
+
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &tiled.TextureArray);
+		glTextureStorage3D(tiled.TextureArray, 1, internalFormat, TiledImage::LayerSize, TiledImage::LayerSize, TiledImage::ResidentTiles);
+
+		// the ui draws plain 2d textures, so every layer gets a view of its own sharing the array storage
+		tiled.LayerViews.assign(TiledImage::ResidentTiles, 0);
+		glGenTextures(TiledImage::ResidentTiles, tiled.LayerViews.data());
+
+		for (uint32_t layer = 0; layer < TiledImage::ResidentTiles; ++layer) {
+			uint32_t view = tiled.LayerViews[layer];
+			glTextureView(view, GL_TEXTURE_2D, tiled.TextureArray, internalFormat, 0, 1, layer, 1);
+
+			glTextureParameteri(view, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTextureParameteri(view, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTextureParameteri(view, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTextureParameteri(view, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+
+		UploadCoarsestLevel(tiled, source);
+		return tiled.TextureArray;
+	}
+
+	void FreeTiledImage(TiledImage& tiled) {
+		glDeleteTextures((int)tiled.LayerViews.size(), tiled.LayerViews.data());
+		glDeleteTextures(1, &tiled.TextureArray);
+		tiled = {};
+	}
+
+	static const PixelStore& GetLevelPixels(const TiledImage& tiled, const PixelStore& source, uint32_t level) {
+		return level == 0 ? source : tiled.MipLevels[level - 1];
+	}
+
+	// finds a layer for the tile (evicting the least recently used one) and uploads it
+	static bool MakeResident(TiledImage& tiled, const PixelStore& source, uint32_t levelIndex, uint32_t tileX, uint32_t tileY) {
+		const TiledImage::Level& level = tiled.Levels[levelIndex];
+		uint32_t tileIndex		 = level.FirstTile + tileY * level.TilesX + tileX;
+		uint32_t firstPinnedTile = tiled.Levels.back().FirstTile;
+
+		int32_t layer = -1;
+		uint64_t oldest = UINT64_MAX;
+
+		for (uint32_t i = 0; i < TiledImage::ResidentTiles; ++i) {
+			uint32_t owner = tiled.LayerOwners[i];
+
+			if (owner == NoTile) {
+				layer = i;
+				break;
+			}
+
+			// tiles drawn this frame and the coarsest level are never evicted
+			const TiledImage::Tile& ownerTile = tiled.Tiles[owner];
+			if (owner < firstPinnedTile && ownerTile.LastUsed < tiled.Frame && ownerTile.LastUsed < oldest) {
+				oldest = ownerTile.LastUsed;
+				layer  = i;
+			}
+		}
+
+		if (layer < 0)
+			return false;
+
+		if (tiled.LayerOwners[layer] != NoTile)
+			tiled.Tiles[tiled.LayerOwners[layer]].Layer = -1;
+
+		tiled.LayerOwners[layer]	 = tileIndex;
+		tiled.Tiles[tileIndex].Layer = layer;
+
+		const PixelStore& pixels = GetLevelPixels(tiled, source, levelIndex);
+		uint32_t x = tileX * TiledImage::TileSize;
+		uint32_t y = tileY * TiledImage::TileSize;
+		uint32_t width	= std::min(TiledImage::TileSize, level.Width  - x);
+		uint32_t height = std::min(TiledImage::TileSize, level.Height - y);
+
+		// the border repeats the edge texels where the tile ends at the edge of the image
+		uint32_t leftX	= x == 0 ? 0 : x - 1;
+		uint32_t rightX = std::min(x + width, level.Width - 1);
+		uint32_t bytesPerPixel = pixels.GetBytesPerPixel();
+		size_t	 rowBytes	   = static_cast<size_t>(width + 2) * bytesPerPixel;
+
+		tileScratch.resize(rowBytes * (height + 2));
+
+		for (uint32_t row = 0; row < height + 2; ++row) {
+			uint32_t sourceY = std::clamp((int64_t)y + row - 1, (int64_t)0, (int64_t)level.Height - 1);
+			uint8_t* out	 = tileScratch.data() + row * rowBytes;
+
+			memcpy(out, pixels.GetPixel(leftX, sourceY), bytesPerPixel);
+			memcpy(out + bytesPerPixel, pixels.GetPixel(x, sourceY), static_cast<size_t>(width) * bytesPerPixel);
+			memcpy(out + static_cast<size_t>(width + 1) * bytesPerPixel, pixels.GetPixel(rightX, sourceY), bytesPerPixel);
+		}
+
+		glTextureSubImage3D(tiled.TextureArray, 0, 0, 0, layer, width + 2, height + 2, 1, GL_RGBA, GetTextureFormat(pixels.GetFormat()).Type, tileScratch.data());
+		return true;
+	}
+
+	static void CollectLevel(TiledImage& tiled, const PixelStore& source, const TileView& view, uint32_t levelIndex, std::vector<ImageQuad>& outQuads, uint32_t& uploads) {
+		const TiledImage::Level& level = tiled.Levels[levelIndex];
+		glm::vec2 imageSize = view.ImageMax - view.ImageMin;
+
+		glm::vec2 visibleMin = glm::max(view.VisibleMin, view.ImageMin);
+		glm::vec2 visibleMax = glm::min(view.VisibleMax, view.ImageMax);
+		if (visibleMin.x >= visibleMax.x || visibleMin.y >= visibleMax.y)
+			return;
+
+		// visible part of the image in tiles of this level, tile rows count from the top like the pixel rows
+		glm::vec2 levelSize((float)level.Width, (float)level.Height);
+		glm::vec2 visibleFirst = (visibleMin - view.ImageMin) / imageSize;
+		glm::vec2 visibleLast  = (visibleMax - view.ImageMin) / imageSize;
+
+		glm::vec2 first = glm::vec2(visibleFirst.x, 1.0f - visibleLast.y)  * levelSize / (float)TiledImage::TileSize;
+		glm::vec2 last	= glm::vec2(visibleLast.x,  1.0f - visibleFirst.y) * levelSize / (float)TiledImage::TileSize;
+
+		uint32_t firstX = (uint32_t)first.x, firstY = (uint32_t)first.y;
+		uint32_t lastX	= std::min((uint32_t)std::ceil(last.x), level.TilesX);
+		uint32_t lastY	= std::min((uint32_t)std::ceil(last.y), level.TilesY);
+
+		for (uint32_t tileY = firstY; tileY < lastY; ++tileY) {
+			for (uint32_t tileX = firstX; tileX < lastX; ++tileX) {
+				TiledImage::Tile& tile = tiled.Tiles[level.FirstTile + tileY * level.TilesX + tileX];
+
+				if (tile.Layer < 0) {
+					// left to the coarser level below until a later frame has upload budget for it
+					if (uploads >= TiledImage::UploadsPerFrame || !MakeResident(tiled, source, levelIndex, tileX, tileY))
+						continue;
+
+					++uploads;
+				}
+
+				tile.LastUsed = tiled.Frame;
+
+				// tile extent in pixels of the level, edge tiles only fill part of their layer
+				glm::vec2 tileMin((float)(tileX * TiledImage::TileSize), (float)(tileY * TiledImage::TileSize));
+				glm::vec2 tileMax(std::min(tileMin.x + TiledImage::TileSize, levelSize.x), std::min(tileMin.y + TiledImage::TileSize, levelSize.y));
+				glm::vec2 uvMin = glm::vec2(1.0f) / (float)TiledImage::LayerSize;
+				glm::vec2 uvMax = (tileMax - tileMin + 1.0f) / (float)TiledImage::LayerSize;
+
+				// the top pixel row of the tile is layer row 1 (below the border), so v runs downwards on the quad
+				ImageQuad quad;
+				quad.TextureId = tiled.LayerViews[tile.Layer];
+				quad.Min	   = view.ImageMin + glm::vec2(tileMin.x, levelSize.y - tileMax.y) / levelSize * imageSize;
+				quad.Max	   = view.ImageMin + glm::vec2(tileMax.x, levelSize.y - tileMin.y) / levelSize * imageSize;
+				quad.UVMin	   = { uvMin.x, uvMax.y };
+				quad.UVMax	   = { uvMax.x, uvMin.y };
+				outQuads.push_back(quad);
+			}
+		}
+	}
+
+	void CollectTiles(TiledImage& tiled, const PixelStore& source, const TileView& view, std::vector<ImageQuad>& outQuads) {
+		++tiled.Frame;
+
+		// target pixels covered by one source pixel decides the level
+		float scale = (view.ImageMax.x - view.ImageMin.x) / source.GetWidth();
+		uint32_t coarsest = (uint32_t)tiled.Levels.size() - 1;
+		uint32_t level	  = scale >= 1.0f ? 0 : std::min((uint32_t)std::floor(std::log2(1.0f / scale)), coarsest);
+
+		uint32_t uploads = 0;
+
+		// the coarsest level is resident from the start and shows under the finer tiles that are still streaming
+		CollectLevel(tiled, source, view, coarsest, outQuads, uploads);
+		if (level != coarsest)
+			CollectLevel(tiled, source, view, level, outQuads, uploads);
+	}
+
+}
@@ -0,0 +1,75 @@
+
+
+#pragma once
+
+#include "PixelStore.h"
+
+#include "glm/glm.hpp"
+
+#include <vector>
+
+namespace Renderer {
+
+	// image too large for a single texture (or for vram), drawn from fixed size tiles of a mip pyramid
+	// only the tiles the current view needs are kept resident in a texture array
+	struct TiledImage {
+		static constexpr uint32_t TileSize		  = 256;
+		static constexpr uint32_t LayerSize		  = TileSize + 2;	// a tile and a one texel border of its neighbours, so linear filtering does not seam
+		static constexpr uint32_t ResidentTiles	  = 512;	// layers of the texture array, 130 MB of rgba8 (260 MB for the wider formats)
+		static constexpr uint32_t UploadsPerFrame = 32;
+
+		struct Level {
+			uint32_t Width	   = 0;
+			uint32_t Height	   = 0;
+			uint32_t TilesX	   = 0;
+			uint32_t TilesY	   = 0;
+			uint32_t FirstTile = 0;		// index of the level's first tile in Tiles
+		};
+
+		struct Tile {
+			int32_t	 Layer	  = -1;		// layer in the texture array, -1 if not resident
+			uint64_t LastUsed = 0;
+		};
+
+		// pixels of levels 1..n, level 0 is the pixel store of the image itself
+		std::vector<PixelStore> MipLevels;
+		std::vector<Level>		Levels;
+		std::vector<Tile>		Tiles;
+		std::vector<uint32_t>	LayerOwners;	// tile index held by each layer
+		std::vector<uint32_t>	LayerViews;		// 2d texture view of each layer, what the ui samples
+
+		uint32_t TextureArray = 0;
+		uint64_t Frame		  = 0;
+	};
+
+	struct ImageQuad;
+
+	// where the image sits and what part of it is visible, all in target pixels
+	struct TileView {
+		glm::vec2 ImageMin;
+		glm::vec2 ImageMax;
+		glm::vec2 VisibleMin;
+		glm::vec2 VisibleMax;
+	};
+
+	// must be called from InitRenderer, after the gl context is created
+	void InitTiledImages();
+
+	// GL_MAX_TEXTURE_SIZE, 0 before InitTiledImages
+	uint32_t GetMaxTextureSize();
+
+	// true if the image should not be uploaded as one texture
+	bool NeedsTiling(uint32_t width, uint32_t height, PixelFormat format);
+
+	// 2x2 box filtered pyramid below the source in its format, down to a level that fits in a single tile
+	std::vector<PixelStore> BuildMipLevels(const PixelStore& source);
+
+	// creates the tile texture array with a view per layer and uploads the coarsest level, returns the array id
+	uint32_t CreateTiledImage(TiledImage& tiled, const PixelStore& source);
+	void FreeTiledImage(TiledImage& tiled);
+
+	// uploads the visible tiles of the level matching the view scale and appends a quad for each of them,
+	// coarsest level first so it shows under finer tiles that are still streaming in
+	void CollectTiles(TiledImage& tiled, const PixelStore& source, const TileView& view, std::vector<ImageQuad>& outQuads);
+
+}
@@ -5,9 +5,20 @@
 #include "ImguiUi.h"
 #include "FontManager.h"
 #include "Renderer.h"
+#include "ThreadPool.h"
+#include "ImageCache.h"
+#include "DiskCache.h"
+#include "ThumbnailGrid.h"
+#include "ColorSpace.h"
+#include "ColorLibrary.h"
+#include "ColorDifference.h"
+#include "SimilarPixels.h"
 #include "FileDialog.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
 #include <filesystem>
 
 // give mouse pos relative to the current imgui window from which called
@@ -17,6 +28,393 @@ static ImVec2 GetRelativeMousePos() {
 	return {globalPos.x - windowPos.x, globalPos.y - windowPos.y};
 }
 
+// outlines source pixels once each covers several target pixels, frame rects have their origin at the bottom left
+static void DrawPixelGrid(ImDrawList* drawList, const ImVec2& targetPos, const ImVec2& targetSize, const Renderer::ImageFrame& frame) {
+	if (frame.ImageWidth == 0 || frame.ImageHeight == 0)
+		return;
+
+	float pixelsPerTexel = (frame.ImageMax.x - frame.ImageMin.x) / frame.ImageWidth;
+	if (pixelsPerTexel < 6.0f)
+		return;
+
+	// only lines on the visible part of the image
+	float minX = std::max(frame.ImageMin.x, 0.0f), maxX = std::min(frame.ImageMax.x, targetSize.x);
+	float minY = std::max(frame.ImageMin.y, 0.0f), maxY = std::min(frame.ImageMax.y, targetSize.y);
+	float top  = targetPos.y + targetSize.y;
+	const ImU32 color = IM_COL32(128, 128, 128, 153);
+
+	for (int i = (int)std::ceil((minX - frame.ImageMin.x) / pixelsPerTexel); ; ++i) {
+		float x = frame.ImageMin.x + i * pixelsPerTexel;
+		if (x > maxX)
+			break;
+
+		drawList->AddLine({ targetPos.x + x, top - maxY }, { targetPos.x + x, top - minY }, color);
+	}
+
+	for (int i = (int)std::ceil((minY - frame.ImageMin.y) / pixelsPerTexel); ; ++i) {
+		float y = frame.ImageMin.y + i * pixelsPerTexel;
+		if (y > maxY)
+			break;
+
+		drawList->AddLine({ targetPos.x + minX, top - y }, { targetPos.x + maxX, top - y }, color);
+	}
+}
+
+// thumbnails of the folder of the open image, clicking one opens it
+static void DrawFolderPanel(std::string& imagePath) {
+	ImGui::Begin("Folder");
+
+	if (ImGui::Button("Show folder of the image")) {
+		std::error_code error;
+		std::filesystem::path directory = std::filesystem::absolute(imagePath.c_str(), error).parent_path();
+		if (!error)
+			ThumbnailGrid::SetFolder(directory.string());
+	}
+
+	uint32_t count = ThumbnailGrid::GetCount();
+	ImGui::SameLine(0.0f, 15.0f);
+	ImGui::Text("%u images%s", count, ThumbnailGrid::IsScanning() ? ", scanning..." : "");
+
+	ImGui::BeginChild("##Thumbnails");
+
+	// only the rows on screen are laid out, the rest of the grid is one invisible item for the scrollbar
+	const float cellSize = ThumbnailGrid::ThumbnailSize + 8.0f;
+	ImVec2 available = ImGui::GetContentRegionAvail();
+	uint32_t columns = std::max(1u, (uint32_t)(available.x / cellSize));
+	uint32_t rows	 = (count + columns - 1) / columns;
+
+	uint32_t firstRow	 = (uint32_t)(ImGui::GetScrollY() / cellSize);
+	uint32_t visibleRows = (uint32_t)(available.y / cellSize) + 2;
+	uint32_t firstCell	 = std::min(firstRow * columns, count);
+	uint32_t lastCell	 = std::min((firstRow + visibleRows) * columns, count);
+
+	ThumbnailGrid::Update(firstCell, visibleRows * columns);
+
+	ImVec2 gridPos = ImGui::GetCursorScreenPos();
+	bool clicked = ImGui::InvisibleButton("##Grid", { std::max(1.0f, columns * cellSize), std::max(1.0f, rows * cellSize) });
+	bool hovered = ImGui::IsItemHovered();
+
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	for (uint32_t i = firstCell; i < lastCell; ++i) {
+		glm::vec2 min = { gridPos.x + (i % columns) * cellSize + 4.0f, gridPos.y + (i / columns) * cellSize + 4.0f };
+		glm::vec2 max = min + glm::vec2((float)ThumbnailGrid::ThumbnailSize);
+
+		if (!ThumbnailGrid::AddCell(i, min, max))
+			drawList->AddRectFilled({ min.x, min.y }, { max.x, max.y }, IM_COL32(60, 60, 60, 255));
+	}
+
+	ThumbnailGrid::Draw(drawList);
+
+	if (hovered) {
+		ImVec2 mousePos = ImGui::GetMousePos();
+		uint32_t column = (uint32_t)((mousePos.x - gridPos.x) / cellSize);
+		uint32_t index	= (uint32_t)((mousePos.y - gridPos.y) / cellSize) * columns + column;
+
+		if (column < columns && index < count) {
+			std::string path = ThumbnailGrid::GetPath(index);
+			ImGui::SetTooltip("%s", path.c_str());
+
+			if (clicked && path.size() < imagePath.size()) {
+				strcpy((char*)imagePath.c_str(), path.c_str());
+				Renderer::SetImagePath(path);
+			}
+		}
+	}
+
+	ImGui::EndChild();
+	ImGui::End();
+}
+
+// dominant colors of the shown image, clicking a swatch picks its color
+static void DrawPalettePanel(glm::vec4& pickedColor) {
+	static Palette::Options options;
+	static Palette::Result	palette;
+	static float extractMs = 0.0f;
+	static bool	 sampled   = false;
+
+	ImGui::Begin("Palette");
+
+	int colors = (int)options.Colors;
+	if (ImGui::SliderInt("Colors", &colors, 1, (int)Palette::MaxColors))
+		options.Colors = (uint32_t)colors;
+
+	ImGui::Checkbox("Sample", &sampled);
+	if (sampled) {
+		ImGui::SameLine(0.0f, 15.0f);
+		ImGui::SliderFloat("Max share error", &options.MaxShareError, 0.001f, 0.05f, "%.3f");
+	}
+
+	if (ImGui::Button("Extract")) {
+		Palette::Options extractOptions = options;
+		extractOptions.MaxShareError = sampled ? options.MaxShareError : 0.0f;
+
+		auto start = std::chrono::steady_clock::now();
+		if (!Renderer::ExtractPalette(extractOptions, palette))
+			palette = {};
+
+		extractMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	if (!palette.Swatches.empty()) {
+		ImGui::SameLine(0.0f, 15.0f);
+		ImGui::Text("%.1f ms, %llu pixels", extractMs, (unsigned long long)palette.CountedPixels);
+
+		if (palette.ShareError > 0.0f) {
+			ImGui::SameLine();
+			ImGui::Text("(shares +-%.1f%%)", 100.0f * palette.ShareError);
+		}
+	}
+
+	for (size_t i = 0; i < palette.Swatches.size(); ++i) {
+		const Palette::Swatch& swatch = palette.Swatches[i];
+
+		ImGui::PushID((int)i);
+		if (ImGui::ColorButton("##Swatch", { swatch.Color.x, swatch.Color.y, swatch.Color.z, swatch.Color.w }, 0, { 40.0f, 40.0f }))
+			pickedColor = swatch.Color;
+
+		ImGui::SameLine();
+		ImGui::Text("%.1f%%", 100.0f * swatch.Share);
+		ImGui::PopID();
+	}
+
+	ImGui::End();
+}
+
+// the picked color in every color space, hdr images pick linear values which are encoded first
+static void DrawColorSpacePanel(const glm::vec4& pickedColor, bool linearPicked) {
+	ImGui::Begin("Color Spaces");
+
+	glm::vec3 srgb = { pickedColor.x, pickedColor.y, pickedColor.z };
+	if (linearPicked)
+		srgb = ColorSpace::LinearToSrgb(srgb);
+
+	for (uint32_t i = 0; i < (uint32_t)ColorSpace::Space::Count; ++i) {
+		ColorSpace::Space space = (ColorSpace::Space)i;
+		glm::vec4 components = ColorSpace::FromSrgb(srgb, space);
+
+		ImGui::Text("%-10s", ColorSpace::GetName(space));
+		for (uint32_t c = 0; c < ColorSpace::GetComponentCount(space); ++c) {
+			ImGui::SameLine(0.0f, 15.0f);
+			ImGui::Text("%s %8.3f", ColorSpace::GetComponentName(space, c), components[c]);
+		}
+	}
+
+	ImGui::End();
+}
+
+// lab of the picked color, hdr images pick linear values
+static glm::vec3 PickedToLab(const glm::vec4& pickedColor, bool linearPicked) {
+	glm::vec3 linear = { pickedColor.x, pickedColor.y, pickedColor.z };
+	if (!linearPicked)
+		linear = ColorSpace::SrgbToLinear(linear);
+
+	return ColorSpace::XyzToLab(ColorSpace::LinearToXyz(linear));
+}
+
+// library colors closest to the picked one, looked up again every frame so they follow hover picking
+static void DrawNamedColorPanel(const glm::vec4& pickedColor, bool linearPicked) {
+	ImGui::Begin("Named Colors");
+
+	glm::vec3 pickedLab = PickedToLab(pickedColor, linearPicked);
+	ColorLibrary::Match matches[8];
+	auto start = std::chrono::steady_clock::now();
+	size_t matchCount = ColorLibrary::FindNearest(pickedLab, matches);
+	float lookupUs = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	ImGui::Text("%u library colors, %.1f us per lookup", ColorLibrary::GetColorCount(), lookupUs);
+
+	// the lookup ranks by the euclidean delta e, the 2000 one is what the matches are judged by
+	float l[8], a[8], b[8], deltaE2000[8];
+	for (size_t i = 0; i < matchCount; ++i) {
+		l[i] = matches[i].Lab.x;
+		a[i] = matches[i].Lab.y;
+		b[i] = matches[i].Lab.z;
+	}
+	ColorDifference::Ciede2000(pickedLab, l, a, b, deltaE2000, matchCount);
+
+	for (size_t i = 0; i < matchCount; ++i) {
+		const ColorLibrary::Match& match = matches[i];
+
+		ImGui::PushID((int)i);
+		ImGui::ColorButton("##Match", { match.Color.x, match.Color.y, match.Color.z, match.Color.w }, 0, { 24.0f, 24.0f });
+
+		ImGui::SameLine();
+		ImGui::Text("%s (%s)  dE %.2f  dE2000 %.2f", match.Name, match.Library, match.DeltaE, deltaE2000[i]);
+		ImGui::PopID();
+	}
+
+	ImGui::End();
+}
+
+// settings of the overlay marking the pixels close to the picked color, drawn over the image next frame
+// the cpu mask is resolved before the overlay is drawn, mask is what that gave back
+static void DrawSimilarPixelsPanel(const glm::vec4& pickedColor, bool linearPicked, bool& showOverlay, bool& cpuMask, SimilarPixels::Overlay& overlay, const Renderer::SimilarPixelMask& mask) {
+	ImGui::Begin("Similar Pixels");
+
+	ImGui::Checkbox("Show", &showOverlay);
+	ImGui::SameLine(0.0f, 15.0f);
+	ImGui::Checkbox("Cpu mask", &cpuMask);
+
+	ImGui::SliderFloat("Delta E", &overlay.Threshold, 0.0f, 50.0f, "%.2f");
+	ImGui::ColorEdit4("Highlight", glm::value_ptr(overlay.Highlight), ImGuiColorEditFlags_NoInputs);
+
+	overlay.TargetLab = PickedToLab(pickedColor, linearPicked);
+
+	// the gpu overlay measures the distances itself while drawing, it is shown until the first cpu mask of the image is done,
+	// tiled images and ones without a cpu pixel store always use it
+	if (showOverlay && cpuMask) {
+		if (mask.Texture != 0)
+			ImGui::Text("%llu pixels, made in %.1f ms%s", (unsigned long long)mask.PixelCount, mask.UpdateMs, mask.Pending ? ", updating" : "");
+		else if (mask.Pending)
+			ImGui::Text("Making the cpu mask, the gpu overlay is shown meanwhile");
+		else
+			ImGui::Text("No cpu pixels for this image, the gpu overlay is shown");
+	}
+
+	ImGui::End();
+}
+
+// point of the target (origin at the bottom left) in 0..1 of the drawn image, clamped to its edges
+static glm::vec2 TargetToImageUv(const Renderer::ImageFrame& frame, const glm::vec2& targetPoint) {
+	glm::vec2 size = frame.ImageMax - frame.ImageMin;
+	if (size.x <= 0.0f || size.y <= 0.0f)
+		return glm::vec2(0.0f);
+
+	return glm::clamp((targetPoint - frame.ImageMin) / size, glm::vec2(0.0f), glm::vec2(1.0f));
+}
+
+// decoded pixels touched by the region between two uv corners, kept in uvs so a refined decode keeps the same region
+static PixelKernels::PixelRect RegionToPixels(const Renderer::ImageFrame& frame, const glm::vec2& cornerA, const glm::vec2& cornerB) {
+	glm::vec2 low = glm::min(cornerA, cornerB), high = glm::max(cornerA, cornerB);
+
+	uint32_t minX = (uint32_t)(low.x * frame.ImageWidth), minY = (uint32_t)(low.y * frame.ImageHeight);
+	uint32_t maxX = std::min((uint32_t)std::ceil(high.x * frame.ImageWidth), frame.ImageWidth);
+	uint32_t maxY = std::min((uint32_t)std::ceil(high.y * frame.ImageHeight), frame.ImageHeight);
+
+	return { minX, minY, maxX > minX ? maxX - minX : 0, maxY > minY ? maxY - minY : 0 };
+}
+
+// live mean of the region dragged out on the image, read from the summed-area tables every frame
+static void DrawRegionPanel(const Renderer::ImageFrame& frame, bool hasRegion, const glm::vec2& regionStart, const glm::vec2& regionEnd, glm::vec4& pickedColor) {
+	static bool tables	= true;
+	static bool squares = true;
+
+	ImGui::Begin("Region");
+
+	bool changed = ImGui::Checkbox("Summed-area tables", &tables);
+	if (tables) {
+		ImGui::SameLine(0.0f, 15.0f);
+		changed |= ImGui::Checkbox("Variance", &squares);
+	}
+
+	if (changed)
+		Renderer::SetSummedAreaTables(tables, squares);
+
+	Renderer::SummedAreaStats tableStats = Renderer::GetSummedAreaStats();
+	float estimatedMb = tableStats.EstimatedBytes / (1024.0f * 1024.0f);
+
+	if (!tableStats.Enabled)
+		ImGui::Text("Off, each region is summed pixel by pixel");
+	else if (tableStats.Built)
+		ImGui::Text("Tables: %.1f MB, built in %.1f ms", tableStats.Bytes / (1024.0f * 1024.0f), tableStats.BuildMs);
+	else if (tableStats.Building)
+		ImGui::Text("Tables: building %.1f MB, regions are summed pixel by pixel meanwhile", estimatedMb);
+	else if (tableStats.OverBudget)
+		ImGui::Text("Tables: %.1f MB is over the %.1f MB budget, each region is summed pixel by pixel", estimatedMb, tableStats.Budget / (1024.0f * 1024.0f));
+	else if (tableStats.OutOfMemory)
+		ImGui::Text("Tables: out of memory for %.1f MB, each region is summed pixel by pixel", estimatedMb);
+	else
+		ImGui::Text("Tables: built on the first region read (%.1f MB)", estimatedMb);
+
+	ImGui::Separator();
+
+	PixelKernels::PixelRect rect = RegionToPixels(frame, regionStart, regionEnd);
+	SummedArea::RectStats stats;
+
+	auto start = std::chrono::steady_clock::now();
+	bool read  = hasRegion && Renderer::ReadRegionMean(rect, stats);
+	float readUs = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+	if (!read) {
+		ImGui::Text("Shift and drag on the image to select a region");
+		ImGui::End();
+		return;
+	}
+
+	ImGui::Text("%ux%u at (%u, %u), %llu pixels, read in %.1f us", rect.Width, rect.Height, rect.X, rect.Y, (unsigned long long)stats.PixelCount, readUs);
+
+	// the tables leave alpha out, the mean is picked as an opaque color
+	if (ImGui::ColorButton("##Mean", { stats.Mean.x, stats.Mean.y, stats.Mean.z, 1.0f }, 0, { 40.0f, 40.0f }))
+		pickedColor = glm::vec4(stats.Mean, 1.0f);
+
+	ImGui::SameLine();
+	ImGui::BeginGroup();
+	ImGui::Text("Mean     %8.4f %8.4f %8.4f", stats.Mean.x, stats.Mean.y, stats.Mean.z);
+
+	if (!tableStats.Enabled || squares)
+		ImGui::Text("Std dev  %8.4f %8.4f %8.4f", stats.StdDev.x, stats.StdDev.y, stats.StdDev.z);
+
+	ImGui::EndGroup();
+	ImGui::End();
+}
+
+// red, green, blue and luma histograms of the shown image or of the part of it in view, counted again only when those change
+static void DrawHistogramPanel() {
+	static bool visibleOnly = false;
+	static bool logScale	= false;
+	static int	backend		= (int)Renderer::HistogramBackend::Cpu;
+
+	ImGui::Begin("Histogram");
+
+	ImGui::Checkbox("Visible part", &visibleOnly);
+	ImGui::SameLine(0.0f, 15.0f);
+	ImGui::Checkbox("Log scale", &logScale);
+	ImGui::SameLine(0.0f, 15.0f);
+	ImGui::RadioButton("CPU", &backend, (int)Renderer::HistogramBackend::Cpu);
+	ImGui::SameLine();
+	ImGui::RadioButton("GPU", &backend, (int)Renderer::HistogramBackend::Gpu);
+
+	const Histogram::Counts* counts = Renderer::GetHistogram(visibleOnly, (Renderer::HistogramBackend)backend);
+
+	ImVec2 size = ImGui::GetContentRegionAvail();
+	size = { std::max(size.x, 64.0f), std::max(size.y, 64.0f) };
+	ImGui::InvisibleButton("##Histogram", size);
+
+	ImVec2 min = ImGui::GetItemRectMin();
+	ImDrawList* drawList = ImGui::GetWindowDrawList();
+	drawList->AddRectFilled(min, { min.x + size.x, min.y + size.y }, IM_COL32(30, 30, 30, 255));
+
+	if (counts != nullptr && counts->PixelCount != 0) {
+		const ImU32 colors[Histogram::ChannelCount] = { IM_COL32(230, 60, 60, 200), IM_COL32(60, 200, 60, 200), IM_COL32(70, 110, 240, 200), IM_COL32(220, 220, 220, 200) };
+
+		auto scaled = [&](uint32_t value) { return logScale ? std::log1p((float)value) : (float)value; };
+
+		float peak = 1.0f;
+		for (const auto& channel : counts->Values) {
+			for (uint32_t value : channel)
+				peak = std::max(peak, scaled(value));
+		}
+
+		float binWidth = size.x / (Histogram::Bins - 1);
+		for (uint32_t channel = 0; channel < Histogram::ChannelCount; ++channel) {
+			for (uint32_t bin = 1; bin < Histogram::Bins; ++bin) {
+				float y0 = min.y + size.y * (1.0f - scaled(counts->Values[channel][bin - 1]) / peak);
+				float y1 = min.y + size.y * (1.0f - scaled(counts->Values[channel][bin]) / peak);
+				drawList->AddLine({ min.x + (bin - 1) * binWidth, y0 }, { min.x + bin * binWidth, y1 }, colors[channel]);
+			}
+		}
+
+		if (ImGui::IsItemHovered()) {
+			uint32_t bin = (uint32_t)std::clamp((ImGui::GetMousePos().x - min.x) / binWidth + 0.5f, 0.0f, (float)(Histogram::Bins - 1));
+			ImGui::SetTooltip("%u: R %u  G %u  B %u  Luma %u (of %llu pixels)", bin,
+				counts->Values[Histogram::Red][bin], counts->Values[Histogram::Green][bin], counts->Values[Histogram::Blue][bin], counts->Values[Histogram::Luma][bin],
+				(unsigned long long)counts->PixelCount);
+		}
+	}
+
+	ImGui::End();
+}
+
 static void RunApp() {
 	if (glfwInit() == GLFW_FALSE) {
 		std::cout << "Could not Initialized GLFW!";
@@ -40,7 +438,11 @@ static void RunApp() {
 	ImguiUi::InitImgui(window);
 	FontManager::LoadFonts();
 
+	ThreadPool::Init();
+	DiskCache::Init(DiskCache::GetDefaultDirectory());
+	ColorLibrary::Init("assets/ColorLibraries");
 	Renderer::InitRenderer();
+	ThumbnailGrid::Init();
 
 	// file path of the image to load
 	std::string imagePath = "image path.......";
@@ -49,6 +451,26 @@ static void RunApp() {
 	// picked Color
 	glm::vec4 pickedColor(0.0f);
 
+	// 16 bit and hdr images show the picked color as unclamped floats, 0..255 would round their values
+	ImGuiColorEditFlags pickedColorFlags = 0;
+
+	// when on, the picked color follows the mouse instead of waiting for a click
+	bool pickUnderCursor = false;
+	uint32_t readbackLatency = 0;
+
+	// outline source pixels when zoomed in
+	bool pixelGrid = false;
+
+	// highlight of the pixels close to the picked color
+	bool showSimilarPixels = false;
+	bool similarPixelsCpuMask = false;
+	SimilarPixels::Overlay	   similarPixelsOverlay;
+	Renderer::SimilarPixelMask similarPixelsMask;
+
+	// region dragged out with shift and the left button, corners in 0..1 of the image with the origin at the bottom left
+	bool hasRegion = false, draggingRegion = false;
+	glm::vec2 regionStart(0.0f), regionEnd(0.0f);
+
 	// width and height of the image to be shown
 	int imageWidth = 0, imageHeight = 0;
 
@@ -61,7 +483,8 @@ static void RunApp() {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		ImguiUi::Begin();
-		ImGui::Begin("Main Window", nullptr, ImGuiWindowFlags_NoResize | ImGuiDockNodeFlags_HiddenTabBar);
+		// the mouse wheel zooms the image instead of scrolling the window
+		ImGui::Begin("Main Window", nullptr, ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollWithMouse | ImGuiDockNodeFlags_HiddenTabBar);
 
 		ImGui::AlignTextToFramePadding();
 		ImGui::PushFont(FontManager::GetFont(FontManager::FontWeight::SemiBold, 22));
@@ -70,7 +493,8 @@ static void RunApp() {
 
 		ImGui::SameLine(0.0f, 15.0f);
 		ImGui::PushFont(FontManager::GetFont(FontManager::FontWeight::Regular, 21));
-		ImGui::InputText("##ImagePath", (char*)imagePath.c_str(), imagePath.length());
+		if (ImGui::InputText("##ImagePath", (char*)imagePath.c_str(), imagePath.length()))
+			Renderer::SetImagePath(imagePath.c_str());
 		ImGui::PopFont();
 
 		ImGui::SameLine(0.0f, 15.0f);
@@ -80,8 +504,33 @@ static void RunApp() {
 				window
 			);
 
-			if (filePath != "" && filePath.size() <= imagePath.size())
+			if (filePath != "" && filePath.size() < imagePath.size()) {
 				strcpy((char*)imagePath.c_str(), (char*)filePath.c_str());
+				Renderer::SetImagePath(filePath);
+			}
+		}
+
+		// previous and next image of the folder, also on the arrow keys while no text field has the keyboard
+		int step = 0;
+		ImGui::SameLine(0.0f, 15.0f);
+		if (ImGui::Button("<"))
+			step = -1;
+
+		ImGui::SameLine();
+		if (ImGui::Button(">"))
+			step = 1;
+
+		if (!ImGui::GetIO().WantTextInput) {
+			if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow))
+				step = -1;
+			else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow))
+				step = 1;
+		}
+
+		if (step != 0) {
+			std::string stepPath = Renderer::StepImage(step);
+			if (!stepPath.empty() && stepPath.size() < imagePath.size())
+				strcpy((char*)imagePath.c_str(), stepPath.c_str());
 		}
 
 		ImGui::AlignTextToFramePadding();
@@ -91,46 +540,208 @@ static void RunApp() {
 
 		ImGui::SameLine(0.0f, 15.0f);
 		ImGui::PushFont(FontManager::GetFont(FontManager::FontWeight::Regular, 21));
-		ImGui::ColorEdit4("##color", glm::value_ptr(pickedColor));
+		ImGui::ColorEdit4("##color", glm::value_ptr(pickedColor), pickedColorFlags);
 		ImGui::PopFont();
 
+		ImGui::SameLine(0.0f, 15.0f);
+		ImGui::Checkbox("Pick under cursor", &pickUnderCursor);
+
+		ImGui::SameLine(0.0f, 15.0f);
+		ImGui::Checkbox("Pixel grid", &pixelGrid);
+
+		ImGui::SameLine(0.0f, 15.0f);
+		if (ImGui::Button("Fit"))
+			Renderer::ResetView();
+
+		ImGui::SameLine(0.0f, 15.0f);
+		ImGui::Text("%.1fx", Renderer::GetViewZoom());
+
 		ImVec2 imageSize = ImGui::GetContentRegionAvail();
 		if (imageSize.x > 0 || imageSize.y < 0) {
 			imageWidth = (int)imageSize.x;
 			imageHeight = (int)imageSize.y;
 		}
 
-		// rendering the image for picking color
-		int imageId = Renderer::RenderImage(imageWidth, imageHeight, imagePath);
-		if (imageId != -1) {
+		Renderer::UpdatePixelReadbacks();
+
+		// the image is drawn straight from its source textures, the button only takes the input
+		const Renderer::ImageFrame& imageFrame = Renderer::RenderImage(imageWidth, imageHeight);
+		pickedColorFlags = imageFrame.ImageFormat != Renderer::PixelFormat::RGBA8 ? ImGuiColorEditFlags_Float | ImGuiColorEditFlags_HDR : 0;
+		if (!imageFrame.Quads.empty()) {
 			ImVec2 imagePos = ImGui::GetCursorPos();
 
-			bool clickedOnImage = ImGui::ImageButton(
-				(ImTextureID)(intptr_t)imageId,
-				ImVec2((float)imageWidth, (float)imageHeight),
-				{ 0, 1 },
-				{ 1, 0 },
-				0
-			);
+			bool clickedOnImage = ImGui::InvisibleButton("##Image", ImVec2((float)imageWidth, (float)imageHeight));
+
+			ImVec2 targetPos = ImGui::GetItemRectMin();
+			ImDrawList* drawList = ImGui::GetWindowDrawList();
+			drawList->PushClipRect(targetPos, ImGui::GetItemRectMax(), true);
+
+			// quads have their origin at the bottom left, imgui at the top left
+			for (const Renderer::ImageQuad& quad : imageFrame.Quads) {
+				drawList->AddImage(
+					(ImTextureID)(intptr_t)quad.TextureId,
+					{ targetPos.x + quad.Min.x, targetPos.y + imageHeight - quad.Max.y },
+					{ targetPos.x + quad.Max.x, targetPos.y + imageHeight - quad.Min.y },
+					{ quad.UVMin.x, quad.UVMax.y },
+					{ quad.UVMax.x, quad.UVMin.y }
+				);
+			}
+
+			if (pixelGrid)
+				DrawPixelGrid(drawList, targetPos, ImVec2((float)imageWidth, (float)imageHeight), imageFrame);
+
+			// the mask texture is taken by the overlay's draw callback, so it is resolved first and not replaced later in the frame
+			if (showSimilarPixels) {
+				similarPixelsMask = similarPixelsCpuMask ? Renderer::GetSimilarPixelMask(similarPixelsOverlay.TargetLab, similarPixelsOverlay.Threshold) : Renderer::SimilarPixelMask();
+				similarPixelsOverlay.MaskTexture = similarPixelsMask.Texture;
+
+				SimilarPixels::DrawOverlay(drawList, targetPos, ImVec2((float)imageWidth, (float)imageHeight), imageFrame, similarPixelsOverlay);
+			}
+
+			drawList->PopClipRect();
 
-			if (clickedOnImage) {
-				ImVec2 mousePos = GetRelativeMousePos();
+			ImVec2 mousePos = GetRelativeMousePos();
 
-				// mouse position on the image button
-				mousePos = { mousePos.x - imagePos.x, mousePos.y - imagePos.y };
-				// inverting the y axis for mouse coords
-				mousePos.y = imageHeight - mousePos.y;
+			// mouse position on the image button
+			mousePos = { mousePos.x - imagePos.x, mousePos.y - imagePos.y };
+			// inverting the y axis for mouse coords
+			mousePos.y = imageHeight - mousePos.y;
 
+			if (ImGui::IsItemHovered()) {
+				ImGuiIO& io = ImGui::GetIO();
+
+				if (io.MouseWheel != 0.0f)
+					Renderer::ZoomView(std::pow(1.25f, io.MouseWheel), { mousePos.x, mousePos.y });
+
+				// right or middle drag pans, y is flipped like the mouse position
+				if (ImGui::IsMouseDragging(ImGuiMouseButton_Right, 0.0f) || ImGui::IsMouseDragging(ImGuiMouseButton_Middle, 0.0f))
+					Renderer::PanView({ io.MouseDelta.x, -io.MouseDelta.y });
+			}
+
+			// the release ending a region drag is not a pick
+			if (clickedOnImage && !draggingRegion) {
 				pickedColor = Renderer::ReadPixel((int)mousePos.x, (int)mousePos.y);
 			}
+			else if (pickUnderCursor && ImGui::IsItemHovered()) {
+				Renderer::RequestHoverPixel((int)mousePos.x, (int)mousePos.y);
+			}
+
+			// only while the cursor is on the image, a click or an edit of the color keeps its value once it leaves
+			if (pickUnderCursor && ImGui::IsItemHovered() && !clickedOnImage)
+				Renderer::GetHoverPixel(pickedColor, readbackLatency);
+
+			if (ImGui::IsItemHovered() && ImGui::GetIO().KeyShift && ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+				regionStart	   = TargetToImageUv(imageFrame, { mousePos.x, mousePos.y });
+				regionEnd	   = regionStart;
+				draggingRegion = true;
+				hasRegion	   = true;
+			}
+			else if (draggingRegion) {
+				regionEnd	   = TargetToImageUv(imageFrame, { mousePos.x, mousePos.y });
+				draggingRegion = ImGui::IsMouseDown(ImGuiMouseButton_Left);
+			}
+
+			// outline of the region, it moves with the image on pans and zooms
+			if (hasRegion) {
+				glm::vec2 imageSize = imageFrame.ImageMax - imageFrame.ImageMin;
+				glm::vec2 low  = imageFrame.ImageMin + glm::min(regionStart, regionEnd) * imageSize;
+				glm::vec2 high = imageFrame.ImageMin + glm::max(regionStart, regionEnd) * imageSize;
+
+				drawList->PushClipRect(targetPos, { targetPos.x + imageWidth, targetPos.y + imageHeight }, true);
+				drawList->AddRect({ targetPos.x + low.x, targetPos.y + imageHeight - high.y }, { targetPos.x + high.x, targetPos.y + imageHeight - low.y }, IM_COL32(255, 255, 0, 255));
+				drawList->PopClipRect();
+			}
+
+			// refining keeps the reduced image up, the bar would only hide it
+			Renderer::LoadProgress loadProgress = Renderer::GetLoadProgress();
+			if (loadProgress.Loading && !loadProgress.Refining) {
+				const float barWidth = 300.0f;
+				const char* stage	 = loadProgress.Decoded < 1.0f ? "Decoding..." : "Uploading...";
+
+				ImGui::SetCursorPos({ imagePos.x + (imageWidth - barWidth) * 0.5f, imagePos.y + imageHeight * 0.5f });
+				ImGui::ProgressBar((loadProgress.Decoded + loadProgress.Uploaded) * 0.5f, { barWidth, 0.0f }, stage);
+			}
 		}
 
+		ImGui::End();
+
+		DrawFolderPanel(imagePath);
+		DrawPalettePanel(pickedColor);
+		DrawColorSpacePanel(pickedColor, imageFrame.ImageFormat == Renderer::PixelFormat::RGBA32F);
+		DrawNamedColorPanel(pickedColor, imageFrame.ImageFormat == Renderer::PixelFormat::RGBA32F);
+		DrawSimilarPixelsPanel(pickedColor, imageFrame.ImageFormat == Renderer::PixelFormat::RGBA32F, showSimilarPixels, similarPixelsCpuMask, similarPixelsOverlay, similarPixelsMask);
+		DrawHistogramPanel();
+		DrawRegionPanel(imageFrame, hasRegion, regionStart, regionEnd, pickedColor);
+
+		ImGui::Begin("Stats");
+		ImGui::Text("Frame time: %.3f ms (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		ImGui::Text("Readback latency: %u frames", readbackLatency);
+
+		if (imageFrame.ImageFiltered)
+			ImGui::Text("Streamed at 1/%u scale (%ux%u), picks are averages of %ux%u file pixels", imageFrame.ImageScaleDenom, imageFrame.ImageWidth, imageFrame.ImageHeight, imageFrame.ImageScaleDenom, imageFrame.ImageScaleDenom);
+		else if (imageFrame.ImageScaleDenom > 1)
+			ImGui::Text("Shown at 1/%u scale (%ux%u)%s", imageFrame.ImageScaleDenom, imageFrame.ImageWidth, imageFrame.ImageHeight, Renderer::GetLoadProgress().Refining ? ", refining" : "");
+
+		ImGui::Separator();
+		ImageCache::Stats cacheStats = ImageCache::GetStats();
+		uint64_t cacheLookups = cacheStats.Hits + cacheStats.Misses;
+
+		ImGui::Text("Image cache: %u images, %.1f MB cpu, %.1f MB vram", cacheStats.Entries, cacheStats.CpuBytes / (1024.0f * 1024.0f), cacheStats.GpuBytes / (1024.0f * 1024.0f));
+		ImGui::Text("Hits: %llu  Misses: %llu  Evictions: %llu  (%.0f%% hit rate)",
+			(unsigned long long)cacheStats.Hits, (unsigned long long)cacheStats.Misses, (unsigned long long)cacheStats.Evictions,
+			cacheLookups != 0 ? 100.0f * cacheStats.Hits / cacheLookups : 0.0f);
+
+		size_t cpuBudget, gpuBudget;
+		ImageCache::GetBudgets(cpuBudget, gpuBudget);
+		int cpuBudgetMB = (int)(cpuBudget / (1024 * 1024)), gpuBudgetMB = (int)(gpuBudget / (1024 * 1024));
+
+		bool budgetChanged = ImGui::SliderInt("Cache cpu budget (MB)",  &cpuBudgetMB, 0, 8192);
+		budgetChanged	  |= ImGui::SliderInt("Cache vram budget (MB)", &gpuBudgetMB, 0, 4096);
+		if (budgetChanged)
+			ImageCache::SetBudgets((size_t)cpuBudgetMB * 1024 * 1024, (size_t)gpuBudgetMB * 1024 * 1024);
+
+		ImGui::Separator();
+		Renderer::NavigationStats navigationStats = Renderer::GetNavigationStats();
+
+		ImGui::Text("Folder steps: %llu, %.0f%% found ready  Prefetching: %u  Prefetched: %u (%.1f MB, %llu used)",
+			(unsigned long long)navigationStats.Steps, navigationStats.Steps != 0 ? 100.0f * navigationStats.ReadySteps / navigationStats.Steps : 0.0f,
+			navigationStats.Prefetching, cacheStats.Prefetched, cacheStats.PrefetchBytes / (1024.0f * 1024.0f), (unsigned long long)cacheStats.PrefetchHits);
+
+		int prefetchDepth	 = (int)Renderer::GetPrefetchDepth();
+		int prefetchBudgetMB = (int)(ImageCache::GetPrefetchBudget() / (1024 * 1024));
+
+		if (ImGui::SliderInt("Prefetch depth", &prefetchDepth, 0, 8))
+			Renderer::SetPrefetchDepth((uint32_t)prefetchDepth);
+
+		if (ImGui::SliderInt("Prefetch budget (MB)", &prefetchBudgetMB, 0, 4096))
+			ImageCache::SetPrefetchBudget((size_t)prefetchBudgetMB * 1024 * 1024);
+
+		ImGui::Separator();
+		DiskCache::Stats diskStats = DiskCache::GetStats();
+
+		ImGui::Text("Disk cache: %u images, %.1f MB", diskStats.Entries, diskStats.Bytes / (1024.0f * 1024.0f));
+		ImGui::Text("Hits: %llu  Misses: %llu  Writes: %llu  Evictions: %llu",
+			(unsigned long long)diskStats.Hits, (unsigned long long)diskStats.Misses, (unsigned long long)diskStats.Writes, (unsigned long long)diskStats.Evictions);
+
+		int diskBudgetMB = (int)(DiskCache::GetBudget() / (1024 * 1024));
+		if (ImGui::SliderInt("Disk cache budget (MB)", &diskBudgetMB, 0, 65536))
+			DiskCache::SetBudget((uint64_t)diskBudgetMB * 1024 * 1024);
+
+		if (ImGui::Button("Clear disk cache"))
+			DiskCache::Clear();
+
 		ImGui::End();
 		ImguiUi::End();
 
 		glfwSwapBuffers(window);
 	}
 
+	// workers may still be writing into renderer owned memory (staging ring), stopping them first
+	Renderer::CancelLoad();
+	Renderer::CancelPrefetch();
+	ThumbnailGrid::Shutdown();
+	ColorLibrary::Shutdown();
+	ThreadPool::Shutdown();
 	Renderer::TerminateRenderer();
 	ImguiUi::Terminate();
 	glfwDestroyWindow(window);
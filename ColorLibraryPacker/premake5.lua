@@ -0,0 +1,52 @@
+project "ColorLibraryPacker"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++20"
+    staticruntime "On"
+
+    targetdir ("../bin/" .. outputdir .. "/%{prj.name}")
+    objdir ("../bin-int/" .. outputdir .. "/%{prj.name}")
+
+    defines { "_CRT_SECURE_NO_WARNINGS" }
+
+    -- packing converts with the app's own color space code, so the app reads back exactly what it would compute
+    files
+    {
+        "src/**.cpp",
+        "../Color-Picker/src/ColorLibrary.h",
+        "../Color-Picker/src/ColorLibrary.cpp",
+        "../Color-Picker/src/ColorSpace.h",
+        "../Color-Picker/src/ColorSpace.cpp",
+        "../Color-Picker/src/PixelStore.h",
+        "../Color-Picker/src/PixelStore.cpp",
+        "../Color-Picker/src/ThreadPool.h",
+        "../Color-Picker/src/ThreadPool.cpp"
+    }
+
+    includedirs
+    {
+        "../Color-Picker/src",
+        "../Dependency/glm"
+    }
+
+    filter "system:windows"
+        systemversion "latest"
+        defines { "PLATFORM_WINDOWS" }
+
+    filter "system:linux"
+        links { "pthread" }
+        defines { "PLATFORM_LINUX" }
+
+    filter "configurations:Debug"
+        runtime "Debug"
+        symbols "On"
+
+    filter "configurations:Release"
+        runtime "Release"
+        symbols "On"
+        optimize "On"
+
+    filter "configurations:Dist"
+        runtime "Release"
+        symbols "Off"
+        optimize "Full"
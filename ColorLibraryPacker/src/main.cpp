@@ -0,0 +1,41 @@
+
+
+#include "ColorLibrary.h"
+
+#include <filesystem>
+#include <iostream>
+
+// packs every text library ("name,#rrggbb" lines, .csv) of a directory into the binary form the app loads,
+// run before each build of the app, libraries that are already newer than their text are left alone
+int main(int argc, char** argv) {
+	if (argc != 2) {
+		std::cout << "usage: " << argv[0] << " [directory of .csv color libraries]\n";
+		return 1;
+	}
+
+	std::error_code error;
+	if (!std::filesystem::is_directory(argv[1], error)) {
+		std::cout << argv[1] << " is not a directory\n";
+		return 1;
+	}
+
+	int result = 0;
+	for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(argv[1], error)) {
+		if (entry.path().extension() != ".csv")
+			continue;
+
+		std::filesystem::path packedPath = entry.path();
+		packedPath.replace_extension(ColorLibrary::PackedExtension);
+
+		std::error_code timeError;
+		if (std::filesystem::exists(packedPath, timeError) && std::filesystem::last_write_time(packedPath, timeError) >= entry.last_write_time(timeError))
+			continue;
+
+		if (ColorLibrary::Pack(entry.path().string(), packedPath.string()))
+			std::cout << "Packed " << entry.path().string() << "\n";
+		else
+			result = 1;
+	}
+
+	return result;
+}
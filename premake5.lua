@@ -6,6 +6,16 @@ workspace "Color-Picker"
 
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
+newoption {
+    trigger     = "with-jpeg-turbo",
+    description = "Decode jpeg files with libjpeg-turbo (its headers and library must be installed)"
+}
+
+newoption {
+    trigger     = "with-libpng",
+    description = "Decode png files with libpng, which also streams huge ones (its headers and library must be installed)"
+}
+
 group "Dependencies"
 include "Dependency/imgui"
 include "Dependency/GLFW"
@@ -47,18 +57,44 @@ project "Color-Picker"
     {
         "imgui",
         "GLFW",
-        "Glad",
-        "opengl32.lib"
+        "Glad"
     }
 
+    -- the named color libraries are packed from their text form before every build, only changed ones are redone
+    dependson { "ColorLibraryPacker" }
+    prebuildcommands { "\"%{wks.location}/bin/" .. outputdir .. "/ColorLibraryPacker/ColorLibraryPacker\" \"%{prj.location}/assets/ColorLibraries\"" }
+
     filter "system:windows"
         systemversion "latest"
+        links { "opengl32.lib" }
         defines {
             "_WINDLL",
             "GLFW_INCLUDE_NONE",
             "PLATFORM_WINDOWS"
         }
 
+    filter "system:linux"
+        links { "GL", "pthread", "dl" }
+        defines {
+            "GLFW_INCLUDE_NONE",
+            "PLATFORM_LINUX"
+        }
+
+    filter "options:with-jpeg-turbo"
+        links { "jpeg" }
+        defines { "USE_JPEG_TURBO" }
+
+    filter "options:with-libpng"
+        links { "png" }
+        defines { "USE_LIBPNG" }
+
+    -- the avx2 delta e kernel is its own file, the rest of the app stays on sse2 and picks it at run time
+    filter { "files:Color-Picker/src/ColorDifferenceAvx2.cpp", "toolset:msc*" }
+        buildoptions { "/arch:AVX2" }
+
+    filter { "files:Color-Picker/src/ColorDifferenceAvx2.cpp", "toolset:not msc*" }
+        buildoptions { "-mavx2", "-mfma" }
+
     filter "configurations:Debug"
         runtime "Debug"
         symbols "On"
@@ -73,3 +109,8 @@ project "Color-Picker"
         runtime "Release"
         symbols "Off"
         optimize "Full"
+
+group "Tools"
+include "Benchmark"
+include "ColorLibraryPacker"
+group ""